@@ -0,0 +1,152 @@
+#pragma once
+#ifndef ATLAS_HPP
+#define ATLAS_HPP
+
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "ShaderProgram.hpp"
+#include "Resources.hpp"
+
+// Shadow-atlas: the shadow-maps of many spot- and point-lights packed into one depth-texture,
+// rendered through one FBO with a viewport per shadow-map and read through one uniform-block
+namespace atlas
+{
+	// Must match MAX_LIGHTS in the atlas-shaders
+	const int MAX_LIGHTS = 8;
+
+	// Binding-point of the Lights uniform-block
+	const GLuint LIGHTS_BINDING = 0;
+
+	// Square region of the atlas (in texels)
+	struct Rect
+	{
+		int x, y, size;
+	};
+
+	// Power-of-two quadtree sub-allocation of a square atlas. Each node is free, used, or split into
+	// four children of half its size. Freeing the last used child of a node merges it back.
+	class Allocator
+	{
+	public:
+		Allocator();
+
+		// size and minSize must be powers of two
+		void Init(int size, int minSize);
+		void Clear();
+
+		// size is rounded up to a power of two (and at least minSize)
+		bool Allocate(int size, Rect& rect);
+		void Free(const Rect& rect);
+
+		int GetSize() const;
+
+	private:
+		enum State { FREE, USED, SPLIT };
+
+		struct Node
+		{
+			int   x, y, size;
+			State state;
+			int   children; // Index of the first of four, -1 until split the first time
+		};
+
+		int  allocate(int node, int size);
+		bool free(int node, const Rect& rect);
+
+		std::vector<Node> m_nodes;
+		int               m_minSize;
+	};
+
+	enum LightType { SPOT, POINT };
+
+	struct Light
+	{
+		LightType type;
+		glm::vec3 position;
+		glm::vec3 target; // Spot-lights point toward it
+		float     fovy;   // Of spot-lights (degrees)
+		float     range;  // Radius of influence, and far-plane of its shadow-maps
+		glm::vec3 color;
+	};
+
+	struct Settings
+	{
+		GLsizei size;          // Of the atlas-texture
+		int     minResolution; // Smallest shadow-map (per face of point-lights)
+		int     maxResolution; // Largest shadow-map, given to lights covering the whole screen
+	};
+
+	// Fraction of the screen's height covered by a light's sphere of influence
+	// (1 when the camera is inside it, 0 when it's behind the camera)
+	float ScreenImportance(const Light& light, const glm::mat4& view, float fovy);
+
+	// Power-of-two resolution within the settings' limits, 0 for lights not seen (importance 0)
+	int Resolution(const Settings& settings, float importance);
+
+	// One shadow-map in the atlas (a spot-light, or a face of a point-light)
+	struct Face
+	{
+		Rect      rect;
+		glm::mat4 matrix; // World to light clip-space
+	};
+
+	// The Lights-block of the atlas-shaders (std140)
+	struct LightData
+	{
+		glm::vec4 position;    // w is the LightType
+		glm::vec4 color;       // w is the range
+		glm::vec4 direction;   // Spot-lights, w is cos(fovy / 2)
+		glm::vec4 rects[6];    // Of each face, in texture-coordinates (x, y, width, height). Width 0 = unshadowed.
+		glm::mat4 matrices[6]; // Of each face, biased to texture-coordinates of its rect
+	};
+
+	struct LightBlock
+	{
+		GLint     count[4];
+		LightData lights[MAX_LIGHTS];
+	};
+
+	class ShadowAtlas
+	{
+	public:
+		ShadowAtlas();
+		~ShadowAtlas();
+
+		// Creates the depth-texture (with compare-mode, for sampler2DShadow), its FBO and the uniform-buffer
+		bool Load(const Settings& settings);
+		void Delete();
+
+		// Gives each light a resolution from its screen-space importance and packs their shadow-maps,
+		// most important first. Lights that don't fit, even at the smallest resolution, aren't shadowed.
+		void Pack(const std::vector<Light>& lights, const glm::mat4& view, float fovy);
+
+		// Shadow-maps to render (to GetFramebuffer(), with each face's rect as viewport)
+		const std::vector<Face>& GetFaces() const;
+
+		GLuint GetFramebuffer() const;
+		GLuint GetTexture() const;
+
+		// Binds the Lights-block of program to the buffer filled by Pack()
+		void SetUniforms(ShaderProgram& program) const;
+
+		// Bytes used by the atlas-texture
+		size_t MemorySize() const;
+
+	private:
+		// Noncopyable
+		ShadowAtlas(const ShadowAtlas& other);
+		ShadowAtlas& operator=(const ShadowAtlas& other);
+
+		Settings          m_settings;
+		Allocator         m_allocator;
+		std::vector<Face> m_faces;
+		LightBlock        m_block;
+
+		resource::Texture     m_tex;
+		resource::Framebuffer m_fbo;
+		resource::Buffer      m_ubo;
+	};
+}
+
+#endif // ATLAS_HPP
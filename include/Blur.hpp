@@ -0,0 +1,84 @@
+#pragma once
+#ifndef BLUR_HPP
+#define BLUR_HPP
+
+#include "OpenGL.hpp"
+#include "Common.hpp"
+#include "ShaderProgram.hpp"
+#include "RenderTargets.hpp"
+
+namespace blur
+{
+	// Must match MAX_TAPS in the blur-shaders
+	const int MAX_TAPS   = 16;
+	const int MAX_RADIUS = 2 * (MAX_TAPS - 1);
+
+	// Tap 0 is the center, the others are mirrored on both sides of it.
+	// Offsets are in texels.
+	struct Kernel
+	{
+		int   taps;
+		float offsets[MAX_TAPS];
+		float weights[MAX_TAPS];
+	};
+
+	// Gaussian (sigma = radius/2) covering 2*radius+1 texels. Neighbouring
+	// texels are merged into one bilinear fetch, so it costs about radius+1
+	// fetches. Requires GL_LINEAR filtering on the blurred texture.
+	Kernel GaussianKernel(int radius);
+
+	// Uploads TapCount/Offsets/Weights to a program using the kernel
+	void SetKernel(ShaderProgram& program, const Kernel& kernel);
+
+	enum Mode
+	{
+		GAUSSIAN,    // Cost grows with the radius
+		RUNNING_SUM, // Box-filter from prefix sums, log2(size)+1 passes per direction regardless of radius
+	};
+
+	// Separable blur of a RG-texture (i.e. VSM moments) through scratch-targets acquired from
+	// rendertarget::Scratch() while it's applied (so blurs of the same size share them)
+	class SeparableBlur
+	{
+	public:
+		SeparableBlur();
+		~SeparableBlur();
+
+		// internalformat is that of the scratch-targets; GL_RG16F halves their size, but
+		// isn't precise enough for RUNNING_SUM's prefix sums
+		bool Load(Mode mode, int radius, GLsizei width, GLsizei height, GLint internalformat = GL_RG32F);
+		void Delete();
+
+		void SetRadius(int radius);
+		int  GetRadius() const;
+
+		// Bytes of the scratch-targets acquired (one for GAUSSIAN, two for RUNNING_SUM)
+		size_t MemorySize() const;
+
+		// Blurs srcTex horizontally, then vertically into dstFBO.
+		// srcTex may be the texture attached to dstFBO.
+		void Apply(GLuint srcTex, GLuint dstFBO);
+
+	private:
+		void ApplyGaussian(GLuint srcTex, GLuint dstFBO);
+		void ApplyRunningSum(GLuint srcTex, GLuint dstFBO);
+		void DrawQuad(GLuint fbo, GLuint tex);
+
+		Mode    m_mode;
+		int     m_radius;
+		GLsizei m_width, m_height;
+
+		rendertarget::Desc m_scratch;
+
+		ShaderProgram m_gaussianProgram;
+		ShaderProgram m_prefixSumProgram;
+		ShaderProgram m_boxProgram;
+
+		// Set for every prefix-sum pass
+		ShaderProgram::Uniform m_stepUniform, m_biasUniform;
+
+		Mesh m_quad;
+	};
+}
+
+#endif // BLUR_HPP
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef CASCADES_HPP
+#define CASCADES_HPP
+
+#include "OpenGL.hpp"
+#include "ShaderProgram.hpp"
+
+// Cascaded shadow maps for a directional light
+namespace cascades
+{
+	// Must match MAX_CASCADES in the CSM-shaders
+	const int MAX_CASCADES = 4;
+
+	struct Settings
+	{
+		int     count;          // Number of cascades (<= MAX_CASCADES)
+		float   lambda;         // 0 = uniform splits, 1 = logarithmic splits
+		float   shadowDistance; // Beyond this (view-space) distance nothing is shadowed
+		float   casterMargin;   // Extra depth toward the light for casters outside a split
+		GLsizei resolution;     // Size of each cascade's shadowmap
+	};
+
+	struct Cascades
+	{
+		int       count;
+		float     splits[MAX_CASCADES];   // Far distance (view-space) of each cascade
+		glm::mat4 matrices[MAX_CASCADES]; // World to light clip-space
+	};
+
+	// Far distance of each split of [zNear, farDistance]
+	void ComputeSplits(int count, float lambda, float zNear, float farDistance, float* splits);
+
+	// Fits an orthographic light-matrix to a bounding sphere of each split of the camera-frustum.
+	// The spheres keep the size of a cascade constant as the camera turns, and their centers are
+	// snapped to whole texels, so the shadows don't shimmer as the camera moves.
+	Cascades Fit(const Settings& settings, const glm::mat4& view, float fovy, float aspect, float zNear,
+		const glm::vec3& lightDir);
+
+	// Uploads cascadeCount, cascadeSplits and cascadeMatrices
+	void SetUniforms(ShaderProgram& program, const Cascades& cascades);
+}
+
+#endif // CASCADES_HPP
@@ -3,18 +3,37 @@
 
 #include "OpenGL.hpp"
 #include <string>
+#include <vector>
 
 namespace texture
 {
-	GLuint Create2D(GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type);
+	// With DSA (see DSA.hpp) textures are immutable, in the sized format of an unsized internalformat,
+	// with MipLevels() levels if mipmaps or one otherwise. No binding is changed then.
+	GLuint Create2D(GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type, bool mipmaps = false);
 
+	// Levels of a full mipmap-chain, down to 1x1
+	GLsizei MipLevels(GLsizei width, GLsizei height);
+
+	// MIPMAP generates the mipmaps, which immutable textures have only if created with them
 	enum Filtering { NEAREST, LINEAR, MIPMAP };
 	void SetFiltering2D(GLuint texture, Filtering filtering);
 
 	enum WrapMode { ClampEdge, ClampBorder, Repeat };
 	void SetWrapMode2D(GLuint texture, WrapMode mode, GLfloat border = 0.0f);
 
+	// Depth-comparison (GL_LEQUAL) for hardware PCF, of a 2D or 2D-array texture
+	void SetDepthCompare(GLenum target, GLuint texture);
+
 	GLuint Framebuffer(int colorTex, int depthTex);
+
+	// 2D-array textures, and framebuffers rendering to one of their layers (to all of them, for
+	// layered rendering, if layer is -1)
+	GLuint Create2DArray(GLint internalformat, GLsizei width, GLsizei height, GLsizei layers, GLenum format, GLenum type);
+	GLuint FramebufferLayer(int colorTex, int depthTex, int layer);
+
+	// Bytes used by a texture of the given format and size (without mipmaps).
+	// Unsized depth-formats are counted as 32 bits, as they usually are stored.
+	size_t MemorySize(GLint internalformat, GLsizei width, GLsizei height, GLsizei layers = 1);
 };
 
 // OpenGL-error callback function 
@@ -22,16 +41,80 @@ namespace texture
 void APIENTRY DebugFunc(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
 	const GLchar* message, GLvoid* userParam);
 
+// Indexed triangle-list (see Geometry.hpp)
 struct Mesh
 {
-	GLuint vao;
-	GLuint vbo;
+	GLuint  vao;
+	GLuint  vbo;
+	GLuint  ebo;
+	GLsizei indexCount;
+	GLenum  indexType;
+
+	// Optional position-only stream (shadowVao is 0 without it), which depth- and moments-passes
+	// fetch instead: a third of the bytes per vertex, and fewer vertices
+	GLuint  shadowVao;
+	GLuint  positionVbo;
+	GLuint  shadowEbo;
+	GLsizei shadowIndexCount;
+	GLenum  shadowIndexType;
+
+	// Local-space bounding-box (for culling; see Culling.hpp)
+	glm::vec3 boundsMin, boundsMax;
 };
 
 Mesh create_quad();
 Mesh create_cube();
 void delete_mesh(Mesh m);
+// With shadowpass the position-only stream is drawn, if m has one
+void draw_mesh(const Mesh& m, bool shadowpass = false);
+
+// Appends the triangles of create_cube(), transformed by model (for work on the CPU)
+void append_cube_positions(std::vector<glm::vec3>& positions, const glm::mat4& model);
+
+// Command-line options shared by the demos
+struct Options
+{
+	Options() : headless(false), frames(0), profile(false), shaderCacheDir("shadercache"), shadowMapSize(0), samplingType(-1), vsmFormat(0), blurRadius(-1), shadowFactor(false), shadowCache(true), validateScene(false), gpuCulling(true), dsa(true) {}
+
+	bool        headless;    // --headless: renders to an FBO without a window (EGL where available)
+	int         frames;      // --frames N: quits after N frames (0 = until closed; 100 when headless)
+	std::string dumpFile;    // --dump file.ppm: writes the last frame (headless only)
+	bool        profile;     // --profile: prints per-pass timings (see Profiler.hpp)
+	std::string profileFile; // --profile-csv file.csv: also writes them to a CSV-file (implies --profile)
+	std::string shaderCacheDir; // --shader-cache dir: program-binary cache, --no-shader-cache disables it
+
+	// Overrides of the demos' settings (used by the benchmark). 0/-1 keeps the demo's own.
+	int         shadowMapSize; // --shadowmap-size N
+	int         samplingType;  // --sampling N: PCF-filter (0 manual, 1 HW PCF, 2 manual 4-tap, 3 manual NxN)
+	GLint       vsmFormat;     // --vsm-format rg16f|rg32f: format of the VSM moments
+	int         blurRadius;    // --blur-radius N: VSM-blur radius in texels
+	bool        shadowFactor;  // --shadow-factor: outputs only the shadow-factor (see src/reference)
+	bool        shadowCache;   // --no-shadow-cache: re-renders the shadow-map every frame (see ShadowCache.hpp)
+	std::string sceneFile;     // --scene file.scene: replaces the demo's geometry (see Scene.hpp; vsmcube only)
+	bool        validateScene; // --validate-scene: also checks the scene's indices against its vertices when loading it
+	bool        gpuCulling;    // --no-gpu-culling: culls casters on the CPU even where GpuCulling.hpp is supported
+	bool        dsa;           // --no-dsa: creates resources by binding them even where DSA.hpp is supported
+};
+
+Options parse_options(int argc, char* argv[]);
 
 bool init_opengl( int width, int height, GLFWwindow** ppWindow );
+bool init_opengl( int width, int height, GLFWwindow** ppWindow, const Options& options );
+void shutdown_opengl();
+
+// What the demos draw their final image to (0, or an FBO when headless)
+GLuint screen_framebuffer();
+
+// Frame-loop for both windowed and headless runs. begin_frame() returns false
+// when it's time to quit (window closed, ESC, or --frames reached). With
+// --frames or --headless each frame's CPU and GPU time is printed.
+bool begin_frame(GLFWwindow* window);
+void end_frame(GLFWwindow* window);
+
+// Prints the memory used for shadows as "Shadow memory: N bytes" (parsed by the benchmark)
+void print_shadow_memory(size_t bytes);
+
+// Seconds since start (in fixed 60Hz steps when headless, so runs are repeatable)
+double frame_time();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "OpenGL.hpp"
+
+// Frustum-culling of objects' bounding-boxes against the views of lights (a spot-light, the
+// six faces of a point-light, the shadow-maps of an atlas...). The boxes are kept as structures
+// of arrays, so each plane is tested against several boxes at once with SSE/AVX/NEON, and all
+// views are tested in one pass over the boxes.
+namespace culling
+{
+	// Bit v of a ViewMask is set if view v sees the object
+	typedef uint64_t ViewMask;
+	const int MAX_VIEWS = 64;
+
+	// Inside where dot(plane, vec4(point, 1)) >= 0 for all six planes (not normalized)
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+	};
+
+	// Frustum of a view-projection matrix (world to clip-space)
+	Frustum ExtractFrustum(const glm::mat4& viewProjection);
+
+	// Axis-aligned boxes as center and half-extents, one array per component
+	class BoundingBoxes
+	{
+	public:
+		BoundingBoxes();
+
+		// Added boxes are empty points at the origin
+		void Resize(int count);
+		int  GetCount() const;
+
+		void Set(int index, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+		// The world-space box around the local-space box [boundsMin, boundsMax] transformed by model
+		void Set(int index, const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+		// Component c (0-2 center, 3-5 extents) of all boxes, padded to a multiple of PADDING
+		const float* GetComponent(int c) const;
+
+		static const int PADDING = 8;
+
+	private:
+		std::vector<float> m_components[6];
+		int                m_count;
+	};
+
+	// Sets masks[i] to the views of frusta[0, viewCount) that box i intersects
+	void Classify(const BoundingBoxes& boxes, const Frustum* frusta, int viewCount, ViewMask* masks);
+
+	// The instruction set Classify() was compiled with ("AVX", "SSE2", "NEON" or "scalar")
+	const char* InstructionSet();
+
+	// Culls a set of objects against several views, and keeps the draw-list of each view
+	class Culler
+	{
+	public:
+		Culler();
+
+		void Resize(int objectCount);
+		int  GetObjectCount() const;
+
+		// Bounds of object, as in BoundingBoxes::Set()
+		void SetBounds(int object, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+		void SetBounds(int object, const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+		// Classifies every object against the views (world to clip-space matrices, up to MAX_VIEWS)
+		void Cull(const glm::mat4* viewProjections, int viewCount);
+
+		ViewMask GetViews(int object) const;
+
+		// The objects view sees, and those any view sees, in increasing order
+		const std::vector<int>& GetDrawList(int view) const;
+		const std::vector<int>& GetVisible() const;
+
+	private:
+		BoundingBoxes                 m_boxes;
+		std::vector<ViewMask>         m_masks;
+		std::vector<std::vector<int>> m_lists;
+		std::vector<int>              m_visible;
+	};
+}
+
+#endif // CULLING_HPP
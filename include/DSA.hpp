@@ -0,0 +1,49 @@
+#pragma once
+#ifndef DSA_HPP
+#define DSA_HPP
+
+#include "OpenGL.hpp"
+
+// GL 4.5 direct state access (newer than gl3w's headers): textures, framebuffers, buffers and
+// vertex-arrays are created and edited by name, without binding them. The resource helpers
+// (texture::, geometry::Upload()) use it where IsSupported(), and bind-to-edit otherwise (the
+// demos only ask for 3.3).
+namespace dsa
+{
+	// Loads the entry points (once), false without GL 4.5 or if disabled (see --no-dsa)
+	bool IsSupported();
+	void SetEnabled(bool enabled);
+
+	// Valid where IsSupported()
+	extern void   (APIENTRYP CreateTextures)(GLenum target, GLsizei n, GLuint* textures);
+	extern void   (APIENTRYP TextureStorage2D)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+	extern void   (APIENTRYP TextureStorage3D)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+	extern void   (APIENTRYP TextureParameteri)(GLuint texture, GLenum pname, GLint param);
+	extern void   (APIENTRYP TextureParameterfv)(GLuint texture, GLenum pname, const GLfloat* param);
+	extern void   (APIENTRYP GenerateTextureMipmap)(GLuint texture);
+
+	extern void   (APIENTRYP CreateFramebuffers)(GLsizei n, GLuint* framebuffers);
+	extern void   (APIENTRYP NamedFramebufferTexture)(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level);
+	extern void   (APIENTRYP NamedFramebufferTextureLayer)(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level, GLint layer);
+	extern void   (APIENTRYP NamedFramebufferDrawBuffer)(GLuint framebuffer, GLenum buf);
+	extern void   (APIENTRYP NamedFramebufferReadBuffer)(GLuint framebuffer, GLenum src);
+	extern GLenum (APIENTRYP CheckNamedFramebufferStatus)(GLuint framebuffer, GLenum target);
+
+	extern void   (APIENTRYP CreateBuffers)(GLsizei n, GLuint* buffers);
+	extern void   (APIENTRYP NamedBufferStorage)(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags);
+
+	extern void   (APIENTRYP CreateVertexArrays)(GLsizei n, GLuint* arrays);
+	extern void   (APIENTRYP VertexArrayVertexBuffer)(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+	extern void   (APIENTRYP VertexArrayElementBuffer)(GLuint vaobj, GLuint buffer);
+	extern void   (APIENTRYP EnableVertexArrayAttrib)(GLuint vaobj, GLuint index);
+	extern void   (APIENTRYP VertexArrayAttribFormat)(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+	extern void   (APIENTRYP VertexArrayAttribBinding)(GLuint vaobj, GLuint attribindex, GLuint bindingindex);
+
+	// Sized format for immutable storage of an unsized one (as glTexImage* would pick it from type)
+	GLenum SizedFormat(GLint internalformat, GLenum type);
+
+	// Immutable buffer with data (size may be 0)
+	GLuint CreateBuffer(GLsizeiptr size, const void* data);
+}
+
+#endif // DSA_HPP
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+#include "OpenGL.hpp"
+
+// Cache of the GL state the demos change most (framebuffers, program, textures, viewport,
+// cull-face and capabilities). Setting what is already set doesn't reach the driver, and every
+// change is counted per frame, issued or skipped (see begin_frame()/end_frame()).
+//
+// All code binds these through here. Deleting a bound object unbinds it, so objects are deleted
+// through here too; code that changes the state directly calls Invalidate() afterwards.
+namespace glstate
+{
+	enum Change
+	{
+		FRAMEBUFFER,
+		PROGRAM,
+		TEXTURE,    // Binds and active-texture switches
+		VIEWPORT,
+		CULL_FACE,
+		CAPABILITY, // Enable()/Disable()
+		CHANGE_COUNT
+	};
+
+	struct Counters
+	{
+		int issued[CHANGE_COUNT];  // Reached the driver
+		int skipped[CHANGE_COUNT]; // Already set
+
+		int Issued() const;
+		int Skipped() const;
+	};
+
+	// "framebuffer", "program"...
+	const char* ChangeName(Change change);
+
+	// GL_FRAMEBUFFER binds both GL_READ_FRAMEBUFFER and GL_DRAW_FRAMEBUFFER
+	void BindFramebuffer(GLenum target, GLuint fbo);
+	void UseProgram(GLuint program);
+
+	// Units above MAX_UNITS, and targets other than 2D, 2D-array and cube-map, aren't cached
+	const int MAX_UNITS = 16;
+	void ActiveTexture(GLenum unit); // GL_TEXTURE0 + i
+	void BindTexture(GLenum target, GLuint texture); // To the active unit
+
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	void CullFace(GLenum mode);
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+
+	// Delete, and forget the bindings GL resets (a deleted program stays in use until replaced,
+	// so it's forgotten instead)
+	void DeleteFramebuffers(GLsizei n, const GLuint* fbos);
+	void DeleteTextures(GLsizei n, const GLuint* textures);
+	void DeleteProgram(GLuint program);
+
+	// Forgets all of it: the next setting of anything is issued
+	void Invalidate();
+
+	// Changes since the last ResetCounters()
+	void ResetCounters();
+	const Counters& GetCounters();
+}
+
+#endif // GLSTATE_HPP
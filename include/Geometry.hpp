@@ -0,0 +1,101 @@
+#pragma once
+#ifndef GEOMETRY_HPP
+#define GEOMETRY_HPP
+
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "Common.hpp"
+
+// Building of meshes: triangle-lists are indexed, reordered for the GPU's vertex-cache, overdraw
+// and vertex-fetch, and uploaded with quantized attributes
+namespace geometry
+{
+	struct Vertex
+	{
+		glm::vec3 position;
+		glm::vec2 texcoord;
+		glm::vec3 normal;
+	};
+
+	// Triangle-list of shared vertices (three indices per triangle)
+	struct IndexedMesh
+	{
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+	};
+
+	// As uploaded: snorm16 position (w = 1), half-float texcoord, 2_10_10_10 normal; 16 bytes.
+	// Positions must be within [-1, 1] (see Normalize()).
+	struct PackedVertex
+	{
+		GLshort  position[4];
+		GLushort texcoord[2];
+		GLuint   normal;
+	};
+
+	// As uploaded for depth-only passes: the snorm16 position alone; 8 bytes
+	struct PackedPosition
+	{
+		GLshort position[4];
+	};
+
+	// Moves and uniformly scales the triangles' positions into [-1, 1] (their bounding-box centered,
+	// its largest side from -1 to 1), so they keep 16 bits of precision over the mesh however large
+	// its coordinates. Returns the transform back, to go before the model-matrix of its instances.
+	// Normals keep their directions.
+	glm::mat4 Normalize(std::vector<Vertex>& triangles);
+
+	// Merges the identical vertices of a non-indexed triangle-list
+	IndexedMesh Index(const std::vector<Vertex>& triangles);
+
+	// Reorders the triangles for the post-transform vertex-cache (Forsyth's linear-speed optimizer)
+	void OptimizeVertexCache(IndexedMesh& mesh);
+
+	// Splits the cache-ordered triangles into clusters where the cache starts over, and draws
+	// the clusters facing out of the mesh first, so they occlude the rest (Sander et al. 2007)
+	void OptimizeOverdraw(IndexedMesh& mesh);
+
+	// Renumbers the vertices in the order they're first used, so they're fetched sequentially
+	void OptimizeVertexFetch(IndexedMesh& mesh);
+
+	// Average cache-misses per triangle, with a FIFO-cache of cacheSize vertices (0.5 to 3; lower is better)
+	float ACMR(const IndexedMesh& mesh, int cacheSize = 16);
+
+	// All of the optimizations above, in order
+	void Optimize(IndexedMesh& mesh);
+
+	// Bounding-box of the mesh's positions
+	void Bounds(const IndexedMesh& mesh, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+	// Index() of the triangles' positions alone (for the position-only stream of Mesh)
+	IndexedMesh IndexPositions(const std::vector<Vertex>& triangles);
+
+	// The vertices and indices as uploaded. Indices are 16-bit unless the mesh has more
+	// than 65536 vertices; PackIndices() returns their type. Positions outside [-1, 1] are
+	// clamped (and assert in debug-builds).
+	std::vector<PackedVertex>   Pack(const IndexedMesh& mesh);
+	std::vector<PackedPosition> PackPositions(const IndexedMesh& mesh);
+	GLenum                      PackIndices(const IndexedMesh& mesh, std::vector<char>& bytes);
+	size_t                      IndexSize(GLenum type);
+
+	// A packed position as the GPU reads it (for checks on the CPU)
+	glm::vec3 UnpackPosition(const GLshort* packed);
+
+	// Uploads packed vertices and indices as they are (e.g. straight from a mapped file; see Scene.hpp).
+	// With DSA (see DSA.hpp) to immutable buffers, without binding anything.
+	Mesh Upload(const PackedVertex* vertices, size_t vertexCount, const void* indices, size_t indexCount, GLenum indexType);
+
+	// Uploads packed positions and indices as the position-only stream of result
+	void UploadPositions(const PackedPosition* positions, size_t positionCount, const void* indices, size_t indexCount, GLenum indexType, Mesh& result);
+
+	// Pack()s and uploads mesh, with its Bounds()
+	Mesh Upload(const IndexedMesh& mesh);
+	void UploadPositions(const IndexedMesh& mesh, Mesh& result);
+
+	// Index(), Optimize() and Upload(). With positionStream also the position-only stream,
+	// of IndexPositions() of the triangles.
+	Mesh Build(const std::vector<Vertex>& triangles, bool positionStream = true);
+}
+
+#endif // GEOMETRY_HPP
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef GPUCULLING_HPP
+#define GPUCULLING_HPP
+
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "Common.hpp"
+#include "ShaderProgram.hpp"
+#include "Instancing.hpp"
+#include "Resources.hpp"
+
+// GPU-driven culling of instanced casters (GL 4.3). A compute-shader (cullComputeShader.glsl) tests
+// every instance's bounds against all views and writes the instance-counts of indirect draw-commands,
+// so the casters of a mesh are one glMultiDrawElementsIndirect per view however many there are, and
+// the CPU never touches them. Without GL 4.3 (the demos only ask for 3.3) IsSupported() is false,
+// and culling::Culler (see Culling.hpp) does the same on the CPU.
+namespace gpuculling
+{
+	// Views culled against at once (the size of the planes-array of the compute-shader)
+	const int MAX_VIEWS = 16;
+
+	// Loads the GL 4.3 functions used here (once), false if the context doesn't have them
+	bool IsSupported();
+
+	// As read by glMultiDrawElementsIndirect
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint  baseVertex;
+		GLuint baseInstance;
+	};
+
+	// Culls the instances of an InstanceBuffer, each an object with the bounds of its mesh. Every view,
+	// and "any view", has a draw-command per object, which draws it once if the view sees it.
+	class IndirectCuller
+	{
+	public:
+		IndirectCuller();
+		~IndirectCuller();
+
+		// Objects are instances [0, maxObjects) of the buffer culled; viewCount up to MAX_VIEWS
+		bool Load(int maxObjects, int viewCount);
+		void Delete();
+
+		// Objects [first, first + count) are instances of mesh (drawn with its position-only
+		// stream, if it has one, as they're drawn in shadow-passes)
+		void SetObjects(int first, int count, const Mesh& mesh);
+
+		// Classifies the first objectCount instances (as uploaded) against the views (world to
+		// clip-space matrices). With writeFaces it also sets their faces to the views that see them.
+		void Cull(instancing::InstanceBuffer& instances, int objectCount, const glm::mat4* viewProjections, bool writeFaces);
+
+		// Draws the objects of [first, first + count), all instances of mesh, that view sees
+		// (-1: that any view sees)
+		void Draw(instancing::InstanceBuffer& instances, const Mesh& mesh, int first, int count, int view);
+
+	private:
+		// Noncopyable
+		IndirectCuller(const IndirectCuller& other);
+		IndirectCuller& operator=(const IndirectCuller& other);
+
+		// Uploads the draw-commands of objects [first, first + count) in every region
+		void upload_commands(int first, int count);
+
+		ShaderProgram            m_program;
+		std::vector<DrawCommand> m_commands; // Per object, without the instance-count (the same in every region)
+		std::vector<glm::vec4>   m_bounds;   // Local-space center and extents of each object
+		resource::Buffer         m_commandBuffer, m_boundsBuffer;
+		int                      m_maxObjects, m_viewCount;
+	};
+}
+
+#endif // GPUCULLING_HPP
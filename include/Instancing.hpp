@@ -0,0 +1,84 @@
+#pragma once
+#ifndef INSTANCING_HPP
+#define INSTANCING_HPP
+
+#include <map>
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "Common.hpp"
+#include "Resources.hpp"
+
+// Instanced drawing: the per-object data of every object sharing a mesh is in one vertex-buffer,
+// read per instance (instanceAttributes.glsl), so a whole range of objects is one draw-call
+namespace instancing
+{
+	// Vertex-attribute locations of the per-instance data (the meshes' own use 0-3)
+	const GLuint MODEL_LOCATION      = 4; // A mat4, so 4-7
+	const GLuint DO_TEXTURE_LOCATION = 8;
+	const GLuint FACES_LOCATION      = 9;
+
+	// Bits of the six faces of a cube-map
+	const unsigned ALL_FACES = 0x3f;
+
+	struct Instance
+	{
+		glm::mat4 model;
+		float     doTexture; // Nonzero textures the object with the shadow-map
+		float     faces;     // Bit f set if cube-face f sees the object (see Culling.hpp), ALL_FACES by default
+	};
+
+	// Instances of up to maxInstances objects. Set() only writes to a copy in memory, which
+	// Upload() uploads in one call; Draw() then draws any range of them.
+	class InstanceBuffer
+	{
+	public:
+		InstanceBuffer();
+		~InstanceBuffer();
+
+		bool Load(int maxInstances);
+		void Delete();
+
+		void Set(int index, const glm::mat4& model, float doTexture = 0.0f);
+		void SetFaces(int index, unsigned faces);
+		void Upload();
+		void Upload(int first, int count); // Only instances [first, first + count)
+
+		// Adds the per-instance attributes to mesh's VAOs
+		void Attach(const Mesh& mesh);
+
+		// Draws instances [first, first + count) of mesh, which must be attached.
+		// With shadowpass its position-only stream is drawn, if it has one.
+		void Draw(const Mesh& mesh, int first, int count, bool shadowpass = false);
+
+		// Draws the instances of a draw-list (increasing indices, e.g. from culling::Culler),
+		// each run of consecutive ones with one Draw()
+		void DrawList(const Mesh& mesh, const int* objects, int count, bool shadowpass = false);
+
+		// Binds the VAO Draw() would draw mesh with, its attributes pointing at instance first
+		// (indirect draws then add their base-instance). Returns whether it's the position-only stream.
+		bool Bind(const Mesh& mesh, int first, bool shadowpass = false);
+
+		int GetMaxInstances() const;
+
+		// The vertex-buffer of the instances (also written to by compute-shaders; see GpuCulling.hpp)
+		GLuint GetBuffer() const;
+
+	private:
+		// Noncopyable
+		InstanceBuffer(const InstanceBuffer& other);
+		InstanceBuffer& operator=(const InstanceBuffer& other);
+
+		// Adds the per-instance attributes to vao
+		void attach(GLuint vao);
+
+		// Points the attributes of the bound VAO at instance first
+		void pointers(int first);
+
+		std::vector<Instance> m_instances;
+		resource::Buffer      m_vbo;
+		std::map<GLuint, int> m_attached; // VAOs, and the instance their attributes point at
+	};
+}
+
+#endif // INSTANCING_HPP
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "OpenGL.hpp"
+#include <string>
+#include <cstdio>
+
+// CPU- and GPU-timers for the passes of a frame. GPU-times come from GL_TIMESTAMP
+// query-pairs (so timers may nest), which are read back FRAMES_IN_FLIGHT-1 frames
+// later so waiting for them doesn't stall the pipeline.
+//
+// Everything is a no-op until Init() is called (see --profile in parse_options()).
+namespace profiler
+{
+	const int FRAMES_IN_FLIGHT = 3;
+	const int WINDOW           = 240; // Frames the rolling statistics are computed over
+
+	// Needs a current context. With csvFile, every pass of every frame is also
+	// written as a "frame,pass,cpu_ms,gpu_ms" row.
+	bool Init(const std::string& csvFile = "");
+	void Shutdown(); // Resolves the frames still in flight and prints a final Report()
+	bool IsEnabled();
+
+	// Called by begin_frame()/end_frame(), which also time the whole frame as "frame"
+	void BeginFrame();
+	void EndFrame();
+
+	// A pass may be timed several times a frame (e.g. once per cascade); the times are summed
+	void Begin(const char* name);
+	void End();
+
+	// Average, median, 95th and 99th percentile of each pass over the last WINDOW frames
+	void Report(FILE* fp = stdout);
+
+	// Times the enclosing block
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name) { Begin(name); }
+		~Scope() { End(); }
+
+	private:
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+	};
+}
+
+#endif // PROFILER_HPP
@@ -0,0 +1,109 @@
+#pragma once
+#ifndef REFERENCE_HPP
+#define REFERENCE_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "Blur.hpp"
+
+// CPU-side reference of the shadow-techniques: a depth-only rasterizer and the lookups
+// the demos' shaders do, so their output can be checked without a GPU (see src/reference).
+// Follows the GL-conventions the demos rely on: pixel-centers at .5, window-space depth
+// in [0, 1], clockwise front-faces (glFrontFace(GL_CW)) and images stored bottom-row first.
+namespace reference
+{
+	// Float-image with one or more channels
+	struct Image
+	{
+		Image() : width(0), height(0), channels(0) {}
+		Image(int width, int height, int channels, float value = 0.0f)
+			: width(width), height(height), channels(channels), data(width * height * channels, value) {}
+
+		float*       At(int x, int y)       { return &data[(y * width + x) * channels]; }
+		const float* At(int x, int y) const { return &data[(y * width + x) * channels]; }
+
+		int width, height, channels;
+		std::vector<float> data;
+	};
+
+	enum CullMode { CULL_NONE, CULL_FRONT, CULL_BACK };
+
+	// Depth-pass of triangles (three world-space positions each) with GL_LESS. Depth is 1 where
+	// nothing is drawn, and ids (if given) gets the index of the visible triangle or -1.
+	// Tiles of the image are rasterized in parallel, four pixels at a time with SSE2.
+	void RasterizeDepth(const std::vector<glm::vec3>& triangles, const glm::mat4& viewProj, CullMode cull,
+		Image& depth, std::vector<int>* ids = NULL);
+
+	// World-space point of a triangle (its three positions) seen through the center of pixel (x, y)
+	glm::vec3 PointOnTriangle(const glm::vec3* triangle, const glm::mat4& inverseViewProj,
+		int width, int height, int x, int y);
+
+	// Runs function(0 .. count-1) spread over the hardware-threads
+	void ParallelFor(int count, const std::function<void(int)>& function);
+
+	// Texture-sampling as done by GL
+	enum Wrap { CLAMP_EDGE, CLAMP_BORDER, REPEAT };
+	float Fetch(const Image& image, int x, int y, int channel, Wrap wrap, float border = 0.0f);
+	float SampleLinear(const Image& image, glm::vec2 uv, int channel, Wrap wrap, float border = 0.0f);
+
+	// Bilinear filtered depth-comparisons (GL_LEQUAL), as with a sampler2DShadow and GL_LINEAR
+	float SampleCompare(const Image& depth, glm::vec2 uv, float ref, Wrap wrap, float border = 0.0f);
+
+	// Shadow-factor of the PCF-demo for its samplingType (0-3). sc is in biased light
+	// clip-space, and the shadow-map has GL_CLAMP_TO_BORDER with a border of 1.
+	float PCF(const Image& depth, const glm::vec4& sc, int samplingType);
+
+	// VSM-moments (depth, depth^2 + 0.25 * (dFdx^2 + dFdy^2)) as written by the shadow-shaders.
+	// Derivatives are differences within 2x2 quads, taken toward a neighbour on the same
+	// triangle (ids from RasterizeDepth()). Pixels without a triangle are cleared to 1.
+	Image Moments(const Image& depth, const std::vector<int>& ids);
+
+	// Same as chebyshevUpperBound() in the VSM-shaders
+	float ChebyshevUpperBound(glm::vec2 moments, float distance);
+
+	// Shadow-factor of the VSM-demo. sc is in (unbiased) light clip-space, the moments have GL_REPEAT.
+	float VSM(const Image& moments, const glm::vec4& sc);
+
+	// blur::SeparableBlur with a Gaussian kernel: horizontally (sampling src with wrap), then vertically
+	Image Blur(const Image& src, const blur::Kernel& kernel, Wrap wrap);
+
+	// Faces in GL-order (+X, -X, +Y, -Y, +Z, -Z)
+	struct CubeMap
+	{
+		Image faces[6];
+	};
+
+	// Face and its texture-coordinates a direction samples (GL's cube-map selection)
+	int CubeFace(const glm::vec3& dir, glm::vec2& uv);
+
+	// Linear filtering within the selected face (clamped at its edges, so it differs from
+	// GL_TEXTURE_CUBE_MAP_SEAMLESS in the outermost half texel)
+	float SampleCube(const CubeMap& cube, const glm::vec3& dir, int channel);
+
+	// Shadow-factor of the cubemapped VSM-demo, for a fragment at distance from the light
+	// in direction dir (light to fragment)
+	float CubeVSM(const CubeMap& moments, const glm::vec3& dir, float distance);
+
+	// 8-bit grayscale PGM (top row first) of a channel; negative values are written as 0
+	bool WritePGM(const std::string& file, const Image& image, int channel = 0);
+
+	// Reads the first channel of a binary PGM or PPM (e.g. a --dump of a demo)
+	bool ReadPNM(const std::string& file, Image& image);
+
+	struct Difference
+	{
+		int    pixels;     // Compared pixels
+		int    mismatches; // Pixels differing by more than the tolerance
+		double maxError;
+		double meanError;
+	};
+
+	// Compares the first channels of two equally sized images, skipping pixels that are
+	// negative in the reference (where it drew nothing)
+	Difference Compare(const Image& reference, const Image& image, float tolerance);
+}
+
+#endif // REFERENCE_HPP
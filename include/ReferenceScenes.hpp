@@ -0,0 +1,52 @@
+#pragma once
+#ifndef REFERENCESCENES_HPP
+#define REFERENCESCENES_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Reference.hpp"
+
+// The demos' scenes for the CPU-reference (see Reference.hpp), rendered as their fragment-shaders
+// output them with --shadow-factor. They must match those in the demos' main.cpp.
+// Used by the Reference tool (src/reference) and its test (src/referencetest).
+namespace reference
+{
+	struct SceneSettings
+	{
+		SceneSettings()
+			: technique("pcf"), width(1280), height(720), shadowMapSize(512), samplingType(0), blurRadius(-1), frame(0) {}
+
+		std::string technique;     // pcf, vsm or vsmcube
+		int         width, height; // Of the image (the demos' window is 1280x720)
+		int         shadowMapSize;
+		int         samplingType;  // PCF-filter (0-3)
+		int         blurRadius;    // VSM-blur radius, -1 for the demo's own (6 for vsm, 3 for vsmcube)
+		int         frame;         // Of a headless run (the light moves in vsmcube)
+	};
+
+	// A scene as in the frame: triangles (three world-space positions each) casting shadows and
+	// seen by the camera, and the light
+	struct Scene
+	{
+		std::vector<glm::vec3> casters;
+		std::vector<glm::vec3> visible;  // The casters and the light-box
+		glm::mat4              viewProj; // Of the camera
+		glm::vec3              lightPos;
+		glm::vec3              lightTarget; // Where the spot-lights look (pcf and vsm)
+	};
+
+	// False for an unknown technique
+	bool GetScene(const SceneSettings& settings, Scene& scene);
+
+	// Shadow-factor of every pixel (-1 where nothing is drawn). False for an unknown technique.
+	bool RenderScene(const SceneSettings& settings, Image& factors);
+
+	// Camera-pass of a width x height image: shadowFactor of the world-space point each pixel
+	// sees of triangles (-1 where nothing is drawn)
+	Image CameraPass(int width, int height, const std::vector<glm::vec3>& triangles, const glm::mat4& viewProj,
+		const std::function<float(const glm::vec3&)>& shadowFactor);
+}
+
+#endif // REFERENCESCENES_HPP
@@ -0,0 +1,121 @@
+#pragma once
+#ifndef RENDER_GRAPH_HPP
+#define RENDER_GRAPH_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "RenderTargets.hpp"
+
+// The passes of a frame, declared with the resources they read and write rather than called in a
+// fixed order. Compile() drops the passes nothing visible depends on, orders the others, and finds
+// the passes each transient resource lives between; Execute() acquires a transient from
+// rendertarget::Scratch() before its first pass and gives it back after its last, so transients whose
+// lifetimes don't overlap share one target (and memory follows how many are alive at once).
+//
+// A resource's writers run in the order they were added, and the passes only reading it after all
+// of them. A pass is kept if it writes an imported resource, or something a kept pass reads.
+namespace rendergraph
+{
+	typedef int Resource; // Index in its graph
+
+	class Graph;
+
+	// Given to a pass when it runs: the GL names behind its resources
+	class Context
+	{
+	public:
+		GLuint GetTexture(Resource resource) const;
+		GLuint GetDepthTexture(Resource resource) const;
+		GLuint GetFramebuffer(Resource resource) const;
+
+	private:
+		friend class Graph;
+		explicit Context(const Graph& graph);
+
+		const Graph& m_graph;
+	};
+
+	typedef std::function<void(const Context& context)> Function;
+
+	class Pass
+	{
+	public:
+		// Declared after AddPass(), as in graph.AddPass("normal", f).Read(shadowMap).RenderTo(screen)
+		Pass& Read(Resource resource);
+		Pass& Write(Resource resource);    // Through framebuffers the pass binds itself
+		Pass& RenderTo(Resource resource); // Through its framebuffer, bound with a viewport of its size before the pass
+
+	private:
+		friend class Graph;
+		Pass(const std::string& name, const Function& function);
+
+		bool reads(Resource resource) const;
+		bool writes(Resource resource) const;
+
+		std::string           m_name;
+		Function              m_function;
+		std::vector<Resource> m_reads, m_writes;
+		Resource              m_target; // -1 without
+	};
+
+	class Graph
+	{
+	public:
+		Graph();
+		~Graph();
+
+		// Kept across frames and owned elsewhere (texture, depthTexture or framebuffer may be 0).
+		// Writing one is what keeps a pass from being culled, e.g. the screen.
+		Resource Import(const std::string& name, GLuint texture, GLuint depthTexture, GLuint framebuffer, GLsizei width, GLsizei height);
+
+		// Alive from its first pass to its last, each time the graph is executed. Its contents are
+		// undefined before its first pass writes it.
+		Resource Create(const std::string& name, const rendertarget::Desc& desc);
+
+		// The pass is timed under its name (see Profiler.hpp). The reference is valid until the next AddPass().
+		Pass& AddPass(const std::string& name, const Function& function);
+
+		// False (with an error printed) if the passes depend on each other in a cycle
+		bool Compile();
+		void Execute();
+
+		// Drops the passes and resources, to declare them again
+		void Clear();
+
+		int    GetPassCount() const;   // Kept by Compile() ...
+		int    GetCulledCount() const; // ... and dropped
+		size_t TransientMemorySize() const; // Bytes of the transients, if each had its own target ...
+		size_t AliasedMemorySize() const;   // ... and at most alive at once
+
+		// The passes in order, and the transients' memory
+		void Print() const;
+
+	private:
+		friend class Context;
+
+		struct ResourceInfo
+		{
+			std::string        name;
+			bool               imported;
+			rendertarget::Desc desc;                              // Of a transient
+			GLuint             texture, depthTexture, framebuffer; // Of an imported one
+			GLsizei            width, height;
+			int                first, last;                       // Positions in m_order of its first and last pass (-1 if unused)
+		};
+
+		// Noncopyable
+		Graph(const Graph& other);
+		Graph& operator=(const Graph& other);
+
+		std::vector<ResourceInfo>        m_resources;
+		std::vector<rendertarget::Lease> m_leases; // Of the transients alive
+		std::vector<Pass>                m_passes;
+		std::vector<int>                 m_order;  // Passes kept, as executed
+		size_t                           m_aliasedMemory;
+	};
+}
+
+#endif // RENDER_GRAPH_HPP
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef RENDER_TARGETS_HPP
+#define RENDER_TARGETS_HPP
+
+#include <memory>
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "Resources.hpp"
+
+// Transient render-targets (a color-texture and/or a depth-texture, and a framebuffer rendering to
+// them) shared between passes. A pass acquires the ones it needs while it renders to and reads from
+// them, and gives them back after, so the next pass asking for the same kind gets the same ones: how
+// many are allocated follows how many are in use at once, not how many passes (or lights) there are.
+namespace rendertarget
+{
+	struct Desc
+	{
+		GLint   colorFormat; // Internal formats, 0 for none
+		GLint   depthFormat;
+		GLsizei width, height;
+		GLsizei layers;      // Above 1, 2D-array textures with every layer attached (for layered rendering)
+
+		static Desc Color(GLint format, GLsizei width, GLsizei height, GLsizei layers = 1);
+		static Desc ColorDepth(GLint colorFormat, GLint depthFormat, GLsizei width, GLsizei height, GLsizei layers = 1);
+
+		bool operator==(const Desc& other) const;
+
+		// Bytes of its textures
+		size_t MemorySize() const;
+	};
+
+	// What a Pool holds
+	struct Target
+	{
+		Desc                  desc;
+		resource::Texture     color, depth;
+		resource::Framebuffer framebuffer;
+		bool                  inUse;
+		int                   idleFrames; // Ends of frames since it was last acquired
+	};
+
+	class Pool;
+
+	// A target acquired from a Pool, given back when the lease goes (or is released)
+	class Lease
+	{
+	public:
+		Lease();
+		~Lease();
+
+		Lease(Lease&& other);
+		Lease& operator=(Lease&& other);
+
+		bool   IsValid() const;
+		GLuint GetTexture() const;      // 0 without color
+		GLuint GetDepthTexture() const; // 0 without depth
+		GLuint GetFramebuffer() const;
+
+		void Release();
+
+	private:
+		friend class Pool;
+		Lease(Pool* pool, Target* target);
+
+		// Noncopyable
+		Lease(const Lease& other);
+		Lease& operator=(const Lease& other);
+
+		Pool*   m_pool;
+		Target* m_target;
+	};
+
+	class Pool
+	{
+	public:
+		// Targets not acquired during this many frames are deleted by EndFrame()
+		static const int KEEP_FRAMES = 8;
+
+		Pool();
+		~Pool();
+
+		// A free target as described, created when there's none. Its contents are undefined, and
+		// texture-bindings may change when it's created.
+		Lease Acquire(const Desc& desc);
+
+		// Once per frame (end_frame() does it for Scratch())
+		void EndFrame();
+
+		// Deletes every target (those still acquired lose their textures and framebuffer)
+		void Delete();
+
+		int    GetCount() const;
+		int    GetPeakInUse() const;   // Most targets acquired at once
+		size_t MemorySize() const;     // Bytes of the targets allocated now ...
+		size_t PeakMemorySize() const; // ... and at most
+
+	private:
+		friend class Lease;
+		void GiveBack(Target* target);
+
+		// Noncopyable
+		Pool(const Pool& other);
+		Pool& operator=(const Pool& other);
+
+		std::vector<std::unique_ptr<Target>> m_targets;
+		int    m_inUse, m_peakInUse;
+		size_t m_memory, m_peakMemory;
+	};
+
+	// The pool shared by the demos' passes and the common code (emptied by shutdown_opengl())
+	Pool& Scratch();
+}
+
+#endif // RENDER_TARGETS_HPP
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef RESOURCES_HPP
+#define RESOURCES_HPP
+
+#include "OpenGL.hpp"
+
+// Move-only owners of GL objects, deleted when they go (or are Reset()). Textures, framebuffers
+// and programs are deleted through glstate, which forgets their bindings (see GLState.hpp).
+//
+// An owner must let go before the context does: members of the demos' static objects are Reset()
+// by their Delete(), and a demo's own ones are kept in one struct it resets before shutdown_opengl().
+namespace resource
+{
+	void DeleteTexture(GLuint name);
+	void DeleteFramebuffer(GLuint name);
+	void DeleteBuffer(GLuint name);
+	void DeleteVertexArray(GLuint name);
+	void DeleteProgram(GLuint name);
+
+	template <void (*Deleter)(GLuint)>
+	class Handle
+	{
+	public:
+		Handle() : m_name(0) {}
+		explicit Handle(GLuint name) : m_name(name) {}
+		~Handle() { Reset(); }
+
+		Handle(Handle&& other) : m_name(other.Release()) {}
+		Handle& operator=(Handle&& other)
+		{
+			if (this != &other)
+				Reset(other.Release());
+			return *this;
+		}
+
+		GLuint Get() const { return m_name; }
+
+		// Deletes the object owned, and owns name instead
+		void Reset(GLuint name = 0)
+		{
+			if (m_name != 0 && m_name != name)
+				Deleter(m_name);
+			m_name = name;
+		}
+
+		// Gives up the object without deleting it
+		GLuint Release()
+		{
+			GLuint name = m_name;
+			m_name = 0;
+			return name;
+		}
+
+	private:
+		// Noncopyable
+		Handle(const Handle& other);
+		Handle& operator=(const Handle& other);
+
+		GLuint m_name;
+	};
+
+	typedef Handle<DeleteTexture>     Texture;
+	typedef Handle<DeleteFramebuffer> Framebuffer;
+	typedef Handle<DeleteBuffer>      Buffer;
+	typedef Handle<DeleteVertexArray> VertexArray;
+	typedef Handle<DeleteProgram>     Program;
+
+	// Names from glGen* (texture::, dsa:: and glCreateProgram() create them otherwise)
+	Texture     GenTexture();
+	Framebuffer GenFramebuffer();
+	Buffer      GenBuffer();
+	VertexArray GenVertexArray();
+}
+
+#endif // RESOURCES_HPP
@@ -0,0 +1,184 @@
+#pragma once
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "Common.hpp"
+#include "Geometry.hpp"
+
+// Binary scene-files: meshes, their instances, lights and shadow-settings. The file is mapped
+// into memory, and its tables and vertex/index-blobs are used where they are: the blobs are
+// already packed as uploaded (see Geometry.hpp), so they go straight to glBufferData.
+// Written by scene::Writer, e.g. from OBJ-files by the scene-converter (src/sceneconvert).
+//
+// Each mesh is stored Normalize()d into [-1, 1] (see Geometry.hpp), and its bounds with it; the
+// transform back is part of its instances' model-matrices, so the file is drawn and culled as it is.
+//
+// Layout (little-endian, every part aligned to ALIGNMENT):
+//   FileHeader | MeshRecord[meshCount] | InstanceRecord[instanceCount] | LightRecord[lightCount] | blobs
+namespace scene
+{
+	const char     MAGIC[4]       = { 'S', 'H', 'S', 'C' };
+	const uint32_t FORMAT_VERSION = 2;
+	const uint64_t ALIGNMENT      = 16;
+
+	// Overrides of the demo's settings; 0 keeps its own
+	struct Settings
+	{
+		uint32_t shadowMapSize;
+		uint32_t blurRadius;
+	};
+
+	struct FileHeader
+	{
+		char     magic[4];
+		uint32_t version;
+		uint32_t meshCount;
+		uint32_t instanceCount;
+		uint32_t lightCount;
+		Settings settings;
+		uint32_t padding;
+	};
+
+	// Offsets are from the start of the file
+	struct MeshRecord
+	{
+		uint64_t vertexOffset;      // PackedVertex[vertexCount]
+		uint64_t indexOffset;       // indexCount indices of indexType
+		uint64_t positionOffset;    // PackedPosition[positionCount] of the position-only stream (none if 0)
+		uint64_t shadowIndexOffset; // shadowIndexCount indices of shadowIndexType
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexType;         // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		uint32_t positionCount;
+		uint32_t shadowIndexCount;
+		uint32_t shadowIndexType;
+		uint32_t firstInstance;     // Instances are sorted by mesh, so each mesh's are one range
+		uint32_t instanceCount;
+		float    boundsMin[3];
+		float    boundsMax[3];
+	};
+
+	enum InstanceFlags
+	{
+		STATIC   = 1, // Never moves (see ShadowCache.hpp)
+		TEXTURED = 2, // Textured with the shadow-map (doTexture)
+	};
+
+	struct InstanceRecord
+	{
+		uint32_t mesh;
+		uint32_t flags;
+		float    model[16]; // Column-major
+	};
+
+	enum LightType
+	{
+		POINT_LIGHT,
+		SPOT_LIGHT,
+		DIRECTIONAL_LIGHT,
+	};
+
+	struct LightRecord
+	{
+		uint32_t type;
+		float    position[3];
+		float    direction[3]; // Spot- and directional lights
+		float    color[3];
+		float    range;
+		float    angle;        // Of spot-lights' cones, in degrees
+	};
+
+	static_assert(sizeof(FileHeader) % ALIGNMENT == 0, "FileHeader must keep the tables aligned");
+	static_assert(sizeof(MeshRecord) % 8 == 0, "MeshRecord must keep its offsets aligned");
+
+	// A mapped scene-file. Everything returned points into the mapping, so it's valid until Close().
+	class File
+	{
+	public:
+		File();
+		~File();
+
+		// Maps and validates path. Its tables are always checked; checkIndices also reads every index,
+		// to check it's of a vertex of its stream (each blob is read through once, so it's optional).
+		bool Open(const std::string& path, bool checkIndices = false);
+		void Close();
+
+		bool IsOpen() const;
+
+		const Settings& GetSettings() const;
+
+		int                   GetMeshCount() const;
+		const MeshRecord&     GetMesh(int index) const;
+		int                   GetInstanceCount() const;
+		const InstanceRecord& GetInstance(int index) const;
+		glm::mat4             GetModelMatrix(int instance) const;
+		int                   GetLightCount() const;
+		const LightRecord&    GetLight(int index) const;
+
+		// Blobs of mesh index (GetPositions() is null without a position-only stream)
+		const geometry::PackedVertex*   GetVertices(int index) const;
+		const geometry::PackedPosition* GetPositions(int index) const;
+
+		// Uploads mesh index from the mapping, with its position-only stream if it has one
+		Mesh UploadMesh(int index) const;
+
+	private:
+		// Noncopyable
+		File(const File& other);
+		File& operator=(const File& other);
+
+		bool validate(const std::string& path) const;
+		bool validate_indices(const std::string& path) const;
+		bool inside(uint64_t offset, uint64_t size) const;
+
+		const char*       m_data;
+		uint64_t          m_size;
+		const FileHeader* m_header;
+#ifdef _WIN32
+		void*             m_file;
+		void*             m_mapping;
+#endif
+	};
+
+	// Builds a scene in memory and writes it
+	class Writer
+	{
+	public:
+		Writer();
+
+		// Normalizes, indexes and optimizes triangles (see Geometry.hpp). Returns the mesh's index.
+		int  AddMesh(const std::vector<geometry::Vertex>& triangles, bool positionStream = true);
+
+		// Of the triangles as given to AddMesh() (the normalization is added to it)
+		void AddInstance(int mesh, const glm::mat4& model, uint32_t flags = STATIC);
+		void AddLight(const LightRecord& light);
+		void SetSettings(const Settings& settings);
+
+		int GetMeshCount() const;
+
+		bool Save(const std::string& path) const;
+
+	private:
+		struct MeshData
+		{
+			MeshRecord                            record;
+			glm::mat4                             dequantize; // From Normalize()
+			std::vector<geometry::PackedVertex>   vertices;
+			std::vector<char>                     indices;
+			std::vector<geometry::PackedPosition> positions;
+			std::vector<char>                     shadowIndices;
+		};
+
+		std::vector<MeshData>       m_meshes;
+		std::vector<InstanceRecord> m_instances;
+		std::vector<LightRecord>    m_lights;
+		Settings                    m_settings;
+	};
+}
+
+#endif // SCENE_HPP
@@ -4,9 +4,10 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <cstdint>
 
 #include "OpenGL.hpp"
+#include "Resources.hpp"
 
 struct ShaderInfo
 {
@@ -18,6 +19,14 @@ struct ShaderInfo
 		return si;
 	}
 
+	// A compute-program (GL 4.3)
+	static ShaderInfo CS(const std::string& cs)
+	{
+		ShaderInfo si;
+		si.setComputeShaderFile(cs);
+		return si;
+	}
+
 	void setVertexShaderFile(const std::string& str)
 	{
 		vsFile = str;
@@ -33,48 +42,137 @@ struct ShaderInfo
 		gsFile = str;
 	}
 
+	void setComputeShaderFile(const std::string& str)
+	{
+		csFile = str;
+	}
+
 	size_t GetHash() const
 	{
-		std::string str = vsFile + fsFile + gsFile;
+		std::string str = vsFile + fsFile + gsFile + csFile;
 		return std::hash<std::string>()(str);
 	}
 
 	std::string vsFile{ "" };
 	std::string gsFile{ "" };
 	std::string fsFile{ "" };
+	std::string csFile{ "" };
+};
+
+// Name of a uniform or uniform-block, hashed (FNV-1a) at compile-time when it's a literal.
+// It's what the uniform-table of a program is searched by, so no strings are built or compared.
+// Names set in a loop (per shadow-map, cube-face, ...) are kept as constexpr constants, e.g.
+//   static constexpr UniformName cameraToShadowProjectorUniform("cameraToShadowProjector");
+// so they're hashed once by the compiler, whatever the optimization level.
+struct UniformName
+{
+	constexpr UniformName(const char* str)
+	: hash(Hash(str))
+	{
+	}
+
+	UniformName(const std::string& str)
+	: hash(Hash(str.c_str()))
+	{
+	}
+
+	static constexpr uint32_t Hash(const char* str, uint32_t h = 2166136261u)
+	{
+		return *str ? Hash(str + 1, (h ^ uint8_t(*str)) * 16777619u) : h;
+	}
+
+	uint32_t hash;
 };
 
 class ShaderProgram
 {
 public:
+	// Handle of a uniform, resolved once by GetUniform() and used instead of the name afterwards.
+	// Stays valid over Reload(), which resolves it again in the new program.
+	struct Uniform
+	{
+		int slot;
+	};
+
 	ShaderProgram();
 	virtual ~ShaderProgram();
 
 	bool Load(const ShaderInfo& shaderInfo, const std::string& includeDir = "");
 	void DeleteProgram();
 
+	// Starts compiling and linking without waiting for it, so the driver can work on many
+	// programs at once (on several threads with GL_KHR_parallel_shader_compile). Load()
+	// is LoadAsync() followed by Finish(). The program is linked aside, so a previous one stays in
+	// use until the new one replaces it.
+	void LoadAsync(const ShaderInfo& shaderInfo, const std::string& includeDir = "");
+
+	// Whether the program can be used; polls a pending load and finishes it once it's done
+	// (where GL_KHR_parallel_shader_compile can't tell, it's always done)
+	bool IsReady();
+	bool IsPending() const;
+
+	// Waits for a pending load and reports its errors. Returns whether it succeeded, or without
+	// one pending, whether the program is usable. A failed load keeps the previous program.
+	bool Finish();
+
+	// This program when it's ready, otherwise fallback (e.g. a simpler one, to draw with meanwhile)
+	ShaderProgram& ReadyOr(ShaderProgram& fallback);
+
 	int GetAttribLocation(const std::string &s);
 
 	static int GetUniformLocation(GLuint program, const std::string& name);
 	static bool UpdateUniform(int programId, int location, const glm::vec4& m);
 	static bool UpdateUniform(int programId, int location, const glm::vec3& m);
+	static bool UpdateUniform(int programId, int location, const glm::vec2& m);
 	static bool UpdateUniform(int programId, int location, const glm::mat4& m);
+	static bool UpdateUniform(int programId, int location, const glm::mat4* m, int count);
 	static bool UpdateUniform(int programId, int location, float f);
-
-	int GetUniformLocation(const std::string& name);
-	bool UpdateUniform(const std::string&, const glm::mat4&);
-	bool UpdateUniform(const std::string&, const glm::vec2&);
-	bool UpdateUniform(const std::string&, const glm::vec3&);
-	bool UpdateUniform(const std::string&, const glm::vec4&);
-	bool UpdateUniform(const std::string&, float);
-	bool UpdateUniformi(const std::string&, int);
+	static bool UpdateUniform(int programId, int location, const float* f, int count);
+	static bool UpdateUniformi(int programId, int location, int i);
+
+	// Looked up in the table of active uniforms, reflected after linking (-1 if not active)
+	int GetUniformLocation(UniformName name) const;
+	bool UpdateUniform(UniformName, const glm::mat4&);
+	bool UpdateUniform(UniformName, const glm::mat4*, int count);
+	bool UpdateUniform(UniformName, const glm::vec2&);
+	bool UpdateUniform(UniformName, const glm::vec3&);
+	bool UpdateUniform(UniformName, const glm::vec4&);
+	bool UpdateUniform(UniformName, float);
+	bool UpdateUniform(UniformName, const float*, int count);
+	bool UpdateUniformi(UniformName, int);
+
+	// Can be called before the program is ready, the handle is resolved once it is
+	Uniform GetUniform(UniformName name);
+	int GetUniformLocation(Uniform uniform) const;
+	bool UpdateUniform(Uniform, const glm::mat4&);
+	bool UpdateUniform(Uniform, const glm::mat4*, int count);
+	bool UpdateUniform(Uniform, const glm::vec2&);
+	bool UpdateUniform(Uniform, const glm::vec3&);
+	bool UpdateUniform(Uniform, const glm::vec4&);
+	bool UpdateUniform(Uniform, float);
+	bool UpdateUniform(Uniform, const float*, int count);
+	bool UpdateUniformi(Uniform, int);
+
+	// Index of an active uniform-block (GL_INVALID_INDEX if none), and its size in bytes (0 if none)
+	GLuint GetUniformBlockIndex(UniformName name) const;
+	GLint  GetUniformBlockSize(UniformName name) const;
+
+	// Binds a uniform-block to a binding point, also after Reload() (false if it isn't active)
+	bool BindUniformBlock(UniformName name, GLuint binding);
 
 	int  GetProgram() const;
 	void UseProgram() const;
 
+	// Hot-reload from the files: the current program draws until the new one is ready (see IsReady())
 	bool Reload();
+	bool ReloadAsync();
 	bool IsLoaded() const;
 
+	// Directory of the program-binary cache (created if missing), or "" to always compile from source.
+	// Binaries are checked against a hash of the sources (after includes) and the driver, and are
+	// replaced when they're stale or rejected by the driver.
+	static void SetBinaryCacheDir(const std::string& dir);
+
 private:
 	// Noncopyable
 	ShaderProgram(const ShaderProgram& other);
@@ -83,15 +181,58 @@ private:
 	// Disallows automatic type conversions (since 
 	// there are different glUniform*-functions for ints, floats, etc.)
 	// (Alternativly could add suffixes to methods)
-	template<typename T> void UpdateUniform(std::string, T arg);
+	template<typename T> void UpdateUniform(UniformName, T arg);
+	template<typename T> void UpdateUniform(Uniform, T arg);
 	template<typename T> void UpdateUniform(int programId, int location, T arg);
 
-	std::map<std::string, GLint> m_uniformLocations;
+	// Fills the tables below from the linked program and resolves the handles again
+	void reflect();
+
+	// Active uniforms and blocks, sorted by name-hash
+	struct UniformInfo
+	{
+		uint32_t    hash;
+		GLint       location;
+		GLenum      type;
+		GLint       size; // Array-length
+		std::string name;
+	};
+
+	struct BlockInfo
+	{
+		uint32_t    hash;
+		GLuint      index;
+		GLint       size;
+		std::string name;
+	};
+
+	struct BlockBinding
+	{
+		uint32_t hash;
+		GLuint   binding;
+	};
 
-	unsigned int m_programId;
-	ShaderInfo   m_shaderInfo;
-	std::string  m_includeDir;
-	bool         m_loadedFromFile;
+	struct Slot
+	{
+		uint32_t hash;
+		GLint    location;
+	};
+
+	std::vector<UniformInfo>  m_uniforms;
+	std::vector<BlockInfo>    m_blocks;
+	std::vector<Slot>         m_slots;         // Of the handles given out by GetUniform()
+	std::vector<BlockBinding> m_blockBindings; // Set again after linking
+
+	resource::Program m_program; // Linked, and used until a pending load replaces it
+	ShaderInfo        m_shaderInfo;
+	std::string       m_includeDir;
+	bool              m_loadedFromFile;
+
+	// Of a pending load
+	resource::Program   m_pendingProgram;
+	std::vector<GLuint> m_pendingShaders;
+	std::string         m_binaryFile; // Where to save the binary once linked ("" if not cached)
+	uint64_t            m_binaryKey;
 };
 
 #endif // SHADERPROGRAM_HPP
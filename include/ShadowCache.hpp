@@ -0,0 +1,90 @@
+#pragma once
+#ifndef SHADOWCACHE_HPP
+#define SHADOWCACHE_HPP
+
+#include <vector>
+
+#include "OpenGL.hpp"
+#include "Resources.hpp"
+
+// Caching of shadow-maps: they're re-rendered (and re-blurred) only when the light or a caster moves
+namespace shadowcache
+{
+	enum Update
+	{
+		NONE,    // Nothing changed, the shadow-map can be used as it is
+		DYNAMIC, // Only dynamic casters changed: restore the static base and draw them over it
+		ALL,     // The light, the static casters or the set of casters changed: draw everything
+	};
+
+	// Dirty-tracking of one light's shadow-map. Every frame the light's matrix and all its casters
+	// (an id and model-matrix each) are passed between Begin() and End(), which compares them
+	// with those of the last frame.
+	class Tracker
+	{
+	public:
+		Tracker();
+
+		void   Begin(const glm::mat4& lightMatrix);
+		void   AddCaster(int id, const glm::mat4& model, bool isStatic);
+		Update End();
+
+		// Makes the next End() return ALL (e.g. after the shadow-map was recreated)
+		void Invalidate();
+
+		// Whether there were dynamic casters in the last frame
+		bool HasDynamic() const;
+
+	private:
+		struct Caster
+		{
+			int       id;
+			glm::mat4 model;
+		};
+
+		struct Frame
+		{
+			glm::mat4           light;
+			std::vector<Caster> statics, dynamics;
+		};
+
+		static bool same(const std::vector<Caster>& a, const std::vector<Caster>& b);
+
+		Frame m_current, m_last;
+		bool  m_valid;
+	};
+
+	// Copy of a shadow-map with only its static casters drawn, which dynamic casters are drawn over
+	class StaticBase
+	{
+	public:
+		StaticBase();
+		~StaticBase();
+
+		// Same size and formats as the shadow-map; colorFormat 0 for depth-only shadow-maps
+		bool Load(GLsizei width, GLsizei height, GLint depthFormat, GLint colorFormat = 0);
+		void Delete();
+
+		// Copies the shadow-map (attached to fbo) into the base, and back.
+		// Both leave fbo bound, for drawing the dynamic casters.
+		void Store(GLuint fbo);
+		void Restore(GLuint fbo);
+
+		// Bytes used by the base's textures
+		size_t MemorySize() const;
+
+	private:
+		// Noncopyable
+		StaticBase(const StaticBase& other);
+		StaticBase& operator=(const StaticBase& other);
+
+		void blit(GLuint from, GLuint to);
+
+		GLsizei               m_width, m_height;
+		GLint                 m_depthFormat, m_colorFormat;
+		resource::Texture     m_depthTex, m_colorTex;
+		resource::Framebuffer m_fbo;
+	};
+}
+
+#endif // SHADOWCACHE_HPP
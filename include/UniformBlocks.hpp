@@ -0,0 +1,60 @@
+#pragma once
+#ifndef UNIFORMBLOCKS_HPP
+#define UNIFORMBLOCKS_HPP
+
+#include <cstddef>
+
+#include "OpenGL.hpp"
+#include "ShaderProgram.hpp"
+#include "Resources.hpp"
+
+// The uniform-blocks shared by all programs (declared in uniformBlocks.glsl): per-frame camera
+// and light data, uploaded once and bound once. Per-object data is per-instance (see Instancing.hpp).
+namespace blocks
+{
+	// Binding-point (atlas::LIGHTS_BINDING is 0)
+	const GLuint FRAME_BINDING = 1;
+
+	// The Frame-block (std140)
+	struct FrameData
+	{
+		glm::mat4 view;
+		glm::mat4 proj;
+		glm::mat4 shadowMatrix; // World to the light's clip-space, of demos with a single shadow-map
+		glm::vec3 lightPos;     // World-space
+		float     padding0;
+		glm::vec3 lightDir;     // World-space, pointing away from the light (directional lights)
+		float     padding1;
+	};
+
+	static_assert(offsetof(FrameData, shadowMatrix) == 128, "FrameData doesn't match the std140 Frame-block");
+	static_assert(offsetof(FrameData, lightPos) == 192, "FrameData doesn't match the std140 Frame-block");
+	static_assert(offsetof(FrameData, lightDir) == 208, "FrameData doesn't match the std140 Frame-block");
+	static_assert(sizeof(FrameData) == 224, "FrameData doesn't match the std140 Frame-block");
+
+	// Binds the Frame-block of program (if it uses it) to its binding-point.
+	// Returns false if the block is larger than FrameData (its buffer), or a member's offset differs from FrameData's.
+	bool SetBindings(ShaderProgram& program);
+
+	// Uniform-buffer of the Frame-block, bound to FRAME_BINDING
+	class FrameUniforms
+	{
+	public:
+		FrameUniforms();
+		~FrameUniforms();
+
+		bool Load();
+		void Delete();
+
+		void Update(const FrameData& data);
+
+	private:
+		// Noncopyable
+		FrameUniforms(const FrameUniforms& other);
+		FrameUniforms& operator=(const FrameUniforms& other);
+
+		resource::Buffer m_ubo;
+	};
+}
+
+#endif // UNIFORMBLOCKS_HPP
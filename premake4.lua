@@ -17,6 +17,9 @@ solution "Shadow Mapping"
 
       targetdir "bin/"
 
+      configuration "linux"
+         defines "HEADLESS_EGL"
+
       configuration "Debug"
          links {"glfw3" }
          flags { "Symbols" }
@@ -48,6 +51,9 @@ solution "Shadow Mapping"
       configuration "windows"
          defines "WIN32"
          links {"glu32", "opengl32", "gdi32", "winmm", "user32"}
+
+      configuration "linux"
+         links {"GL", "EGL"}
  
       configuration "Debug"
          links {"glfw3" }
@@ -80,6 +86,9 @@ solution "Shadow Mapping"
       configuration "windows"
          defines "WIN32"
          links {"glu32", "opengl32", "gdi32", "winmm", "user32"}
+
+      configuration "linux"
+         links {"GL", "EGL"}
  
       configuration "Debug"
          links {"glfw3" }
@@ -112,6 +121,9 @@ solution "Shadow Mapping"
       configuration "windows"
          defines "WIN32"
          links {"glu32", "opengl32", "gdi32", "winmm", "user32"}
+
+      configuration "linux"
+         links {"GL", "EGL"}
  
       configuration "Debug"
          links {"glfw3" }
@@ -123,3 +135,143 @@ solution "Shadow Mapping"
          defines { "NDEBUG" }
          flags { "Optimize" } 
 
+
+   -- Runs the demos above over a matrix of settings (see src/benchmark/main.cpp)
+   project "Benchmark"
+      kind "ConsoleApp"
+      language "C++"
+
+      files { "src/benchmark/**.hpp", "src/benchmark/**.cpp" }
+
+      targetdir "bin/"
+
+      configuration "windows"
+         defines "WIN32"
+
+      configuration "Debug"
+         defines { "DEBUG" }
+         flags { "Symbols" }
+
+      configuration "Release"
+         defines { "NDEBUG" }
+         flags { "Optimize" }
+
+   -- CPU-reference of the demos' shadows, compared against their --shadow-factor dumps (see src/reference/main.cpp)
+   project "Reference"
+      kind "ConsoleApp"
+      language "C++"
+
+      files { "src/reference/**.hpp", "src/reference/**.cpp" }
+
+      links "Common"
+      libdirs {"external/libs"}
+
+      includedirs "include"
+      includedirs { 
+               "external/glm",  
+               "external/gl3w/include", 
+               "external/glfw/include"
+      }
+
+      targetdir "bin/"
+
+      configuration "windows"
+         defines "WIN32"
+         links {"glu32", "opengl32", "gdi32", "winmm", "user32"}
+
+      configuration "linux"
+         links {"GL", "EGL", "pthread"}
+ 
+      configuration "Debug"
+         links {"glfw3" }
+         defines { "DEBUG" }
+         flags { "Symbols" }
+ 
+      configuration "Release"
+         links {"glfw3" }
+         defines { "NDEBUG" }
+         flags { "Optimize" }
+
+   -- Test of the CPU-reference against ray-traced shadows, no GPU needed (see src/referencetest/main.cpp)
+   project "ReferenceTest"
+      kind "ConsoleApp"
+      language "C++"
+
+      files { "src/referencetest/**.hpp", "src/referencetest/**.cpp" }
+
+      links "Common"
+      libdirs {"external/libs"}
+
+      includedirs "include"
+      includedirs { 
+               "external/glm",  
+               "external/gl3w/include", 
+               "external/glfw/include"
+      }
+
+      targetdir "bin/"
+
+      configuration "windows"
+         defines "WIN32"
+         links {"glu32", "opengl32", "gdi32", "winmm", "user32"}
+
+      configuration "linux"
+         links {"GL", "EGL", "pthread"}
+ 
+      configuration "Debug"
+         links {"glfw3" }
+         defines { "DEBUG" }
+         flags { "Symbols" }
+ 
+      configuration "Release"
+         links {"glfw3" }
+         defines { "NDEBUG" }
+         flags { "Optimize" }
+
+   -- Converts OBJ-files to the scene-files the demos map (see src/sceneconvert/main.cpp)
+   project "SceneConverter"
+      kind "ConsoleApp"
+      language "C++"
+
+      files { "src/sceneconvert/**.hpp", "src/sceneconvert/**.cpp" }
+
+      links "Common"
+      libdirs {"external/libs"}
+
+      includedirs "include"
+      includedirs { 
+               "external/glm",  
+               "external/gl3w/include", 
+               "external/glfw/include"
+      }
+
+      targetdir "bin/"
+
+      configuration "windows"
+         defines "WIN32"
+         links {"glu32", "opengl32", "gdi32", "winmm", "user32"}
+
+      configuration "linux"
+         links {"GL", "EGL", "pthread"}
+ 
+      configuration "Debug"
+         links {"glfw3" }
+         defines { "DEBUG" }
+         flags { "Symbols" }
+ 
+      configuration "Release"
+         links {"glfw3" }
+         defines { "NDEBUG" }
+         flags { "Optimize" }
+
+-- "premake4 test" runs the tests (after building them), failing if any of them does
+newaction {
+   trigger     = "test",
+   description = "Run ReferenceTest",
+   execute     = function ()
+      local exe = os.is("windows") and "bin\\ReferenceTest.exe" or "bin/ReferenceTest"
+      if os.execute(exe) ~= 0 then
+         os.exit(1)
+      end
+   end
+}
@@ -0,0 +1,314 @@
+// Runs the demos headlessly over a matrix of shadow-map sizes, filters, VSM-formats and
+// blur-radii, and writes a table of the results (one CSV-row per run).
+//
+// The demos are expected next to this executable (as premake4.lua puts them in bin/),
+// and are run from the current directory, so their shaders must be found from there.
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define popen  _popen
+#define pclose _pclose
+#endif
+
+struct Run
+{
+	std::string technique;
+	std::string executable;
+	int         size;
+	int         sampling;   // -1 when not PCF
+	std::string format;     // Empty when not VSM
+	int         blurRadius; // -1 when not VSM
+};
+
+struct Result
+{
+	bool   ok;
+	int    frames;
+	double cpuMs, gpuMs;
+	std::map<std::string, double> passGpuMs;
+	double memoryMB;
+};
+
+// Settings of the sweep
+static std::vector<int>         sizes;
+static std::vector<int>         samplings;
+static std::vector<std::string> formats;
+static std::vector<int>         radii;
+static std::vector<std::string> techniques;
+static int                      frames = 60;
+static int                      warmup = 10; // Frames not counted (first uploads, shader compiles, ...)
+static int                      maxCubeSize = 2048;
+static std::string              outFile = "benchmark.csv";
+static std::string              binDir;
+
+static std::vector<int> parse_ints(const std::string& list)
+{
+	std::vector<int> values;
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+		values.push_back(atoi(item.c_str()));
+	return values;
+}
+
+static std::vector<std::string> parse_strings(const std::string& list)
+{
+	std::vector<std::string> values;
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+		values.push_back(item);
+	return values;
+}
+
+static std::string quote(const std::string& s)
+{
+	return "\"" + s + "\"";
+}
+
+static std::string command_line(const Run& run, const std::string& csvFile)
+{
+	std::stringstream cmd;
+	// Without the shadow-cache, so the shadow-passes are measured every frame
+	cmd << quote(binDir + run.executable) << " --headless --frames " << frames << " --no-shadow-cache"
+		<< " --profile-csv " << quote(csvFile) << " --shadowmap-size " << run.size;
+	if (run.sampling >= 0)
+		cmd << " --sampling " << run.sampling;
+	if (!run.format.empty())
+		cmd << " --vsm-format " << run.format;
+	if (run.blurRadius >= 0)
+		cmd << " --blur-radius " << run.blurRadius;
+#ifdef _WIN32
+	// cmd.exe strips the outermost quotes
+	return quote(cmd.str());
+#else
+	return cmd.str();
+#endif
+}
+
+// Averages the GPU-time of each pass (and the frame's CPU-time) over the frames after the warmup
+static bool read_profile(const std::string& csvFile, Result& result)
+{
+	FILE* fp = fopen(csvFile.c_str(), "r");
+	if (!fp)
+		return false;
+
+	std::map<std::string, int> counts;
+	std::map<std::string, double> cpuTotals;
+	char line[256];
+
+	fgets(line, sizeof(line), fp); // Header
+	while (fgets(line, sizeof(line), fp)) {
+		int frame;
+		char pass[64];
+		double cpuMs, gpuMs;
+		if (sscanf(line, "%d,%63[^,],%lf,%lf", &frame, pass, &cpuMs, &gpuMs) != 4 || frame < warmup)
+			continue;
+
+		counts[pass]++;
+		cpuTotals[pass] += cpuMs;
+		result.passGpuMs[pass] += gpuMs;
+	}
+	fclose(fp);
+
+	for (std::map<std::string, int>::iterator it = counts.begin(); it != counts.end(); ++it)
+		result.passGpuMs[it->first] /= it->second;
+
+	result.frames = counts["frame"];
+	if (result.frames == 0)
+		return false;
+
+	result.cpuMs = cpuTotals["frame"] / result.frames;
+	result.gpuMs = result.passGpuMs["frame"];
+	return true;
+}
+
+static Result benchmark(const Run& run)
+{
+	Result result;
+	result.ok = false;
+	result.frames = 0;
+	result.cpuMs = result.gpuMs = 0.0;
+	result.memoryMB = 0.0;
+
+	const std::string csvFile = "benchmark_run.csv";
+	remove(csvFile.c_str());
+
+	std::string cmd = command_line(run, csvFile);
+	printf("%s\n", cmd.c_str());
+
+	FILE* pipe = popen(cmd.c_str(), "r");
+	if (!pipe) {
+		fprintf(stderr, "Couldn't run '%s'\n", cmd.c_str());
+		return result;
+	}
+
+	char line[512];
+	while (fgets(line, sizeof(line), pipe)) {
+		unsigned long bytes;
+		if (sscanf(line, "Shadow memory: %lu bytes", &bytes) == 1)
+			result.memoryMB = bytes / (1024.0 * 1024.0);
+	}
+
+	int status = pclose(pipe);
+	result.ok = status == 0 && read_profile(csvFile, result);
+	remove(csvFile.c_str());
+
+	return result;
+}
+
+static double pass_ms(const Result& result, const char* pass)
+{
+	std::map<std::string, double>::const_iterator it = result.passGpuMs.find(pass);
+	return it != result.passGpuMs.end() ? it->second : 0.0;
+}
+
+static void write_row(FILE* fp, const Run& run, const Result& result)
+{
+	fprintf(fp, "%s,%d,%d,%s,%d,%s,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f\n",
+		run.technique.c_str(), run.size, run.sampling, run.format.c_str(), run.blurRadius,
+		result.ok ? "ok" : "failed", result.frames, result.cpuMs, result.gpuMs,
+		pass_ms(result, "shadow"), pass_ms(result, "blur"), pass_ms(result, "normal"), result.memoryMB);
+	fflush(fp);
+}
+
+static std::vector<Run> build_runs()
+{
+	// Executable-names are the project-names in premake4.lua
+	std::vector<Run> runs;
+
+	for (size_t t = 0; t < techniques.size(); ++t) {
+		const std::string& technique = techniques[t];
+
+		for (size_t s = 0; s < sizes.size(); ++s) {
+			Run run;
+			run.technique  = technique;
+			run.size       = sizes[s];
+			run.sampling   = -1;
+			run.blurRadius = -1;
+
+			if (technique == "pcf") {
+				run.executable = "Normal with PCF";
+				for (size_t i = 0; i < samplings.size(); ++i) {
+					run.sampling = samplings[i];
+					runs.push_back(run);
+				}
+				continue;
+			}
+
+			if (technique == "vsm")
+				run.executable = "VSM";
+			else if (technique == "vsmcube") {
+				// Six faces and their blur-targets grow quickly
+				if (run.size > maxCubeSize)
+					continue;
+				run.executable = "Cubemapped VSM";
+			}
+			else {
+				fprintf(stderr, "Unknown technique '%s'\n", technique.c_str());
+				break;
+			}
+
+			for (size_t f = 0; f < formats.size(); ++f) {
+				for (size_t r = 0; r < radii.size(); ++r) {
+					run.format     = formats[f];
+					run.blurRadius = radii[r];
+					runs.push_back(run);
+				}
+			}
+		}
+	}
+
+	return runs;
+}
+
+static void usage()
+{
+	printf("Usage: benchmark [options]\n"
+		"  --techniques pcf,vsm,vsmcube\n"
+		"  --sizes 256,512,1024,2048,4096\n"
+		"  --sampling 0,1,2,3     PCF-filters (manual, HW PCF, manual 4-tap, manual NxN)\n"
+		"  --formats rg16f,rg32f  VSM-formats\n"
+		"  --radii 1,3,6,12       VSM-blur radii\n"
+		"  --frames N             frames per run (default 60)\n"
+		"  --warmup N             frames not counted (default 10)\n"
+		"  --max-cube-size N      largest size for vsmcube (default 2048)\n"
+		"  --out file.csv         results-table (default benchmark.csv)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	techniques = parse_strings("pcf,vsm,vsmcube");
+	sizes      = parse_ints("256,512,1024,2048,4096");
+	samplings  = parse_ints("0,1,2,3");
+	formats    = parse_strings("rg16f,rg32f");
+	radii      = parse_ints("1,3,6,12");
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--techniques" && hasValue)
+			techniques = parse_strings(argv[++i]);
+		else if (arg == "--sizes" && hasValue)
+			sizes = parse_ints(argv[++i]);
+		else if (arg == "--sampling" && hasValue)
+			samplings = parse_ints(argv[++i]);
+		else if (arg == "--formats" && hasValue)
+			formats = parse_strings(argv[++i]);
+		else if (arg == "--radii" && hasValue)
+			radii = parse_ints(argv[++i]);
+		else if (arg == "--frames" && hasValue)
+			frames = atoi(argv[++i]);
+		else if (arg == "--warmup" && hasValue)
+			warmup = atoi(argv[++i]);
+		else if (arg == "--max-cube-size" && hasValue)
+			maxCubeSize = atoi(argv[++i]);
+		else if (arg == "--out" && hasValue)
+			outFile = argv[++i];
+		else {
+			usage();
+			return arg == "--help" ? 0 : -1;
+		}
+	}
+
+	if (warmup >= frames) {
+		fprintf(stderr, "--frames must be larger than --warmup\n");
+		return -1;
+	}
+
+	// The demos are in the same directory as this executable
+	binDir = argv[0];
+	size_t slash = binDir.find_last_of("/\\");
+	binDir = (slash == std::string::npos) ? "./" : binDir.substr(0, slash + 1);
+
+	FILE* fp = fopen(outFile.c_str(), "w");
+	if (!fp) {
+		fprintf(stderr, "Couldn't open '%s' for writing\n", outFile.c_str());
+		return -1;
+	}
+	fprintf(fp, "technique,size,sampling,format,blur_radius,status,frames,cpu_ms,gpu_ms,shadow_gpu_ms,blur_gpu_ms,normal_gpu_ms,memory_mb\n");
+
+	std::vector<Run> runs = build_runs();
+	for (size_t i = 0; i < runs.size(); ++i) {
+		printf("[%d/%d] ", (int)i + 1, (int)runs.size());
+		Result result = benchmark(runs[i]);
+		write_row(fp, runs[i], result);
+
+		if (result.ok)
+			printf("  %.3f ms/frame (gpu %.3f ms), %.2f MB\n", result.cpuMs, result.gpuMs, result.memoryMB);
+		else
+			printf("  failed\n");
+	}
+
+	fclose(fp);
+	printf("Wrote %s\n", outFile.c_str());
+
+	return 0;
+}
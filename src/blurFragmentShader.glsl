@@ -4,17 +4,22 @@ in vec2 Texcoord;
 uniform sampler2D textureSource;
 uniform vec2 ScaleU;
 
+// Kernel from blur::GaussianKernel(): tap 0 is the center, the other
+// (bilinear) taps are mirrored on both sides
+#define MAX_TAPS 16
+uniform int TapCount;
+uniform float Offsets[MAX_TAPS];
+uniform float Weights[MAX_TAPS];
+
 out vec4 outColor;
 
 void main()
 {
-	vec4 color = vec4(0.0);
-	color += texture2D( textureSource, Texcoord.st + vec2( -3.0*ScaleU.x, -3.0*ScaleU.y ) ) * 0.015625;
-	color += texture2D( textureSource, Texcoord.st + vec2( -2.0*ScaleU.x, -2.0*ScaleU.y ) )*0.09375;
-	color += texture2D( textureSource, Texcoord.st + vec2( -1.0*ScaleU.x, -1.0*ScaleU.y ) )*0.234375;
-	color += texture2D( textureSource, Texcoord.st + vec2( 0.0 , 0.0) )*0.3125;
-	color += texture2D( textureSource, Texcoord.st + vec2( 1.0*ScaleU.x,  1.0*ScaleU.y ) )*0.234375;
-	color += texture2D( textureSource, Texcoord.st + vec2( 2.0*ScaleU.x,  2.0*ScaleU.y ) )*0.09375;
-	color += texture2D( textureSource, Texcoord.st + vec2( 3.0*ScaleU.x, -3.0*ScaleU.y ) ) * 0.015625;
+	vec4 color = texture( textureSource, Texcoord.st ) * Weights[0];
+	for (int i = 1; i < TapCount; ++i) {
+		vec2 offset = Offsets[i] * ScaleU;
+		color += texture( textureSource, Texcoord.st + offset ) * Weights[i];
+		color += texture( textureSource, Texcoord.st - offset ) * Weights[i];
+	}
 	outColor = vec4(color.xyz, 1.0);
-};
\ No newline at end of file
+};
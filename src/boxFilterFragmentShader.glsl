@@ -0,0 +1,28 @@
+#version 330
+
+// Box-filter of width 2*Radius+1 along Axis from prefix sums, so the cost
+// doesn't depend on the radius. The box is cut (and renormalized) at the edges.
+uniform sampler2D textureSource;
+uniform int Axis;
+uniform int Radius;
+uniform vec4 Bias; // Added back after averaging
+
+out vec4 outColor;
+
+void main()
+{
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	int size = textureSize( textureSource, 0 )[Axis];
+
+	ivec2 hi = p;
+	ivec2 lo = p;
+	hi[Axis] = min(p[Axis] + Radius, size - 1);
+	lo[Axis] = p[Axis] - Radius - 1;
+
+	vec4 sum = texelFetch( textureSource, hi, 0 );
+	if (lo[Axis] >= 0)
+		sum -= texelFetch( textureSource, lo, 0 );
+
+	float count = float(hi[Axis] - max(lo[Axis], -1));
+	outColor = sum / count + Bias;
+};
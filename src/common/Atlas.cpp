@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+#include "Atlas.hpp"
+#include "Common.hpp"
+#include "OpenGL.hpp"
+#include "GLState.hpp"
+
+namespace atlas
+{
+	Allocator::Allocator()
+		: m_minSize(1)
+	{
+	}
+
+	void Allocator::Init(int size, int minSize)
+	{
+		Node root = { 0, 0, size, FREE, -1 };
+		m_nodes.clear();
+		m_nodes.push_back(root);
+		m_minSize = minSize;
+	}
+
+	void Allocator::Clear()
+	{
+		if (m_nodes.empty())
+			return;
+
+		m_nodes.resize(1);
+		m_nodes[0].state = FREE;
+		m_nodes[0].children = -1;
+	}
+
+	bool Allocator::Allocate(int size, Rect& rect)
+	{
+		if (m_nodes.empty())
+			return false;
+
+		int pow2 = m_minSize;
+		while (pow2 < size)
+			pow2 *= 2;
+
+		int node = allocate(0, pow2);
+		if (node < 0)
+			return false;
+
+		rect.x = m_nodes[node].x;
+		rect.y = m_nodes[node].y;
+		rect.size = m_nodes[node].size;
+		return true;
+	}
+
+	void Allocator::Free(const Rect& rect)
+	{
+		if (!m_nodes.empty())
+			free(0, rect);
+	}
+
+	int Allocator::GetSize() const
+	{
+		return m_nodes.empty() ? 0 : m_nodes[0].size;
+	}
+
+	// Index of the node allocated within node, or -1. Indices are used rather
+	// than references, as splitting a node may grow m_nodes.
+	int Allocator::allocate(int node, int size)
+	{
+		if (m_nodes[node].size < size || m_nodes[node].state == USED)
+			return -1;
+
+		if (m_nodes[node].state == FREE) {
+			if (m_nodes[node].size == size) {
+				m_nodes[node].state = USED;
+				return node;
+			}
+
+			if (m_nodes[node].children < 0) {
+				int half = m_nodes[node].size / 2;
+				int first = (int)m_nodes.size();
+				for (int i = 0; i < 4; ++i) {
+					Node child = { m_nodes[node].x + (i & 1) * half, m_nodes[node].y + (i >> 1) * half, half, FREE, -1 };
+					m_nodes.push_back(child);
+				}
+				m_nodes[node].children = first;
+			}
+			m_nodes[node].state = SPLIT;
+		}
+
+		// Fill children that are already split before splitting free ones, to keep large regions whole
+		int children = m_nodes[node].children;
+		for (int pass = 0; pass < 2; ++pass) {
+			for (int i = 0; i < 4; ++i) {
+				if ((m_nodes[children + i].state == SPLIT) != (pass == 0))
+					continue;
+
+				int allocated = allocate(children + i, size);
+				if (allocated >= 0)
+					return allocated;
+			}
+		}
+
+		return -1;
+	}
+
+	bool Allocator::free(int node, const Rect& rect)
+	{
+		Node& n = m_nodes[node];
+
+		if (n.state == USED) {
+			if (n.x != rect.x || n.y != rect.y || n.size != rect.size)
+				return false;
+			n.state = FREE;
+			return true;
+		}
+
+		if (n.state != SPLIT)
+			return false;
+
+		int half = n.size / 2;
+		int child = n.children + (rect.x >= n.x + half ? 1 : 0) + (rect.y >= n.y + half ? 2 : 0);
+		if (!free(child, rect))
+			return false;
+
+		// Merge when all four are free (their children stay allocated in m_nodes for the next split)
+		for (int i = 0; i < 4; ++i) {
+			if (m_nodes[n.children + i].state != FREE)
+				return true;
+		}
+		n.state = FREE;
+		return true;
+	}
+
+	float ScreenImportance(const Light& light, const glm::mat4& view, float fovy)
+	{
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		float distance = glm::length(center);
+
+		if (distance <= light.range)
+			return 1.0f;
+		if (center.z > light.range)
+			return 0.0f; // Behind the camera
+
+		// Tangent of the sphere's angular radius, relative to that of half the field of view
+		float tanRadius = light.range / std::sqrt(distance * distance - light.range * light.range);
+		float tanHalfFov = std::tan(glm::radians(fovy) / 2.0f);
+		return std::min(tanRadius / tanHalfFov, 1.0f);
+	}
+
+	int Resolution(const Settings& settings, float importance)
+	{
+		if (importance <= 0.0f)
+			return 0;
+
+		float wanted = importance * settings.maxResolution;
+		int resolution = settings.minResolution;
+		while (resolution < wanted && resolution < settings.maxResolution)
+			resolution *= 2;
+		return resolution;
+	}
+
+	// Light-view of each face of a point-light (GL's cube-map order: +X, -X, +Y, -Y, +Z, -Z)
+	static glm::mat4 point_view_matrix(const glm::vec3& position, int face)
+	{
+		static const glm::vec3 dirs[6] = {
+			glm::vec3(+1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, +1, 0),
+			glm::vec3(0, -1, 0), glm::vec3(0, 0, +1), glm::vec3(0, 0, -1)
+		};
+		static const glm::vec3 ups[6] = {
+			glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, -1),
+			glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0)
+		};
+		return glm::lookAt(position, position + dirs[face], ups[face]);
+	}
+
+	static glm::mat4 spot_view_matrix(const Light& light)
+	{
+		glm::vec3 dir = glm::normalize(light.target - light.position);
+		glm::vec3 up = std::fabs(dir.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+		return glm::lookAt(light.position, light.target, up);
+	}
+
+	// Maps clip-space [-1, 1] to the rect's texture-coordinates (and depth to [0, 1])
+	static glm::mat4 rect_bias_matrix(const glm::vec4& rect)
+	{
+		glm::mat4 bias = glm::translate(glm::mat4(), glm::vec3(rect.x + rect.z / 2.0f, rect.y + rect.w / 2.0f, 0.5f));
+		return glm::scale(bias, glm::vec3(rect.z / 2.0f, rect.w / 2.0f, 0.5f));
+	}
+
+	ShadowAtlas::ShadowAtlas()
+		: m_settings(), m_block()
+	{
+	}
+
+	ShadowAtlas::~ShadowAtlas()
+	{
+	}
+
+	bool ShadowAtlas::Load(const Settings& settings)
+	{
+		m_settings = settings;
+		m_allocator.Init(settings.size, settings.minResolution);
+
+		m_tex.Reset(texture::Create2D(GL_DEPTH_COMPONENT24, settings.size, settings.size, GL_DEPTH_COMPONENT, GL_FLOAT));
+		texture::SetWrapMode2D(m_tex.Get(), texture::WrapMode::ClampEdge);
+		texture::SetDepthCompare(GL_TEXTURE_2D, m_tex.Get());
+
+		m_fbo = resource::GenFramebuffer();
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, m_fbo.Get());
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_tex.Get(), 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		GLenum result = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (GL_FRAMEBUFFER_COMPLETE != result) {
+			printf("ERROR: Shadow-atlas framebuffer not complete.\n");
+			return false;
+		}
+
+		m_ubo = resource::GenBuffer();
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo.Get());
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), &m_block, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		return true;
+	}
+
+	void ShadowAtlas::Delete()
+	{
+		m_tex.Reset();
+		m_fbo.Reset();
+		m_ubo.Reset();
+		m_faces.clear();
+	}
+
+	void ShadowAtlas::Pack(const std::vector<Light>& lights, const glm::mat4& view, float fovy)
+	{
+		m_allocator.Clear();
+		m_faces.clear();
+
+		int count = std::min((int)lights.size(), MAX_LIGHTS);
+
+		// Most important first, so the large shadow-maps are placed before the atlas is fragmented
+		std::vector<std::pair<float, int> > order;
+		for (int i = 0; i < count; ++i)
+			order.push_back(std::make_pair(-ScreenImportance(lights[i], view, fovy), i));
+		std::sort(order.begin(), order.end());
+
+		m_block.count[0] = count;
+
+		for (int i = 0; i < count; ++i) {
+			float importance = -order[i].first;
+			const Light& light = lights[order[i].second];
+			LightData& data = m_block.lights[order[i].second];
+
+			float cosCutoff = std::cos(glm::radians(light.fovy) / 2.0f);
+			data.position  = glm::vec4(light.position, (float)light.type);
+			data.color     = glm::vec4(light.color, light.range);
+			data.direction = glm::vec4(glm::normalize(light.target - light.position), cosCutoff);
+			for (int f = 0; f < 6; ++f) {
+				data.rects[f] = glm::vec4(0.0f);
+				data.matrices[f] = glm::mat4();
+			}
+
+			// Halve the resolution until all faces fit
+			int faces = light.type == POINT ? 6 : 1;
+			for (int res = Resolution(m_settings, importance); res >= m_settings.minResolution; res /= 2) {
+				Rect rects[6];
+				int allocated = 0;
+				while (allocated < faces && m_allocator.Allocate(res, rects[allocated]))
+					allocated++;
+
+				if (allocated < faces) {
+					while (allocated-- > 0)
+						m_allocator.Free(rects[allocated]);
+					continue;
+				}
+
+				float zNear = light.range / 100.0f;
+				for (int f = 0; f < faces; ++f) {
+					glm::mat4 viewProj;
+					if (light.type == POINT)
+						viewProj = glm::perspective(90.0f, 1.0f, zNear, light.range) * point_view_matrix(light.position, f);
+					else
+						viewProj = glm::perspective(light.fovy, 1.0f, zNear, light.range) * spot_view_matrix(light);
+
+					Face face;
+					face.rect = rects[f];
+					face.matrix = viewProj;
+					m_faces.push_back(face);
+
+					data.rects[f] = glm::vec4(rects[f].x, rects[f].y, rects[f].size, rects[f].size) / (float)m_settings.size;
+					data.matrices[f] = rect_bias_matrix(data.rects[f]) * viewProj;
+				}
+				break;
+			}
+		}
+
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo.Get());
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &m_block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	const std::vector<Face>& ShadowAtlas::GetFaces() const
+	{
+		return m_faces;
+	}
+
+	GLuint ShadowAtlas::GetFramebuffer() const
+	{
+		return m_fbo.Get();
+	}
+
+	GLuint ShadowAtlas::GetTexture() const
+	{
+		return m_tex.Get();
+	}
+
+	void ShadowAtlas::SetUniforms(ShaderProgram& program) const
+	{
+		if (!program.BindUniformBlock("Lights", LIGHTS_BINDING))
+			return;
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_BINDING, m_ubo.Get());
+		program.UpdateUniform("atlasTexelSize", 1.0f / m_settings.size);
+	}
+
+	size_t ShadowAtlas::MemorySize() const
+	{
+		return texture::MemorySize(GL_DEPTH_COMPONENT24, m_settings.size, m_settings.size) + sizeof(LightBlock);
+	}
+}
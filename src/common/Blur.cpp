@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Blur.hpp"
+#include "Common.hpp"
+#include "OpenGL.hpp"
+#include "GLState.hpp"
+
+namespace blur
+{
+	Kernel GaussianKernel(int radius)
+	{
+		radius = std::max(0, std::min(radius, MAX_RADIUS));
+
+		// Discrete weights of texel 0..radius (normalized over both sides)
+		float w[MAX_RADIUS + 1];
+		float sigma = std::max(radius / 2.0f, 0.5f);
+		float sum = 0.0f;
+		for (int i = 0; i <= radius; ++i) {
+			w[i] = std::exp(-(i * i) / (2.0f * sigma * sigma));
+			sum += (i == 0) ? w[i] : 2.0f * w[i];
+		}
+		for (int i = 0; i <= radius; ++i)
+			w[i] /= sum;
+
+		Kernel kernel;
+		kernel.taps = 1;
+		kernel.offsets[0] = 0.0f;
+		kernel.weights[0] = w[0];
+
+		// Merge texels i and i+1 into one fetch between them
+		for (int i = 1; i <= radius; i += 2) {
+			float a = w[i];
+			float b = (i + 1 <= radius) ? w[i + 1] : 0.0f;
+			kernel.weights[kernel.taps] = a + b;
+			kernel.offsets[kernel.taps] = (i * a + (i + 1) * b) / (a + b);
+			kernel.taps++;
+		}
+
+		return kernel;
+	}
+
+	void SetKernel(ShaderProgram& program, const Kernel& kernel)
+	{
+		program.UpdateUniformi("TapCount", kernel.taps);
+		program.UpdateUniform("Offsets", kernel.offsets, kernel.taps);
+		program.UpdateUniform("Weights", kernel.weights, kernel.taps);
+	}
+
+	SeparableBlur::SeparableBlur()
+		: m_mode(GAUSSIAN), m_radius(0), m_width(0), m_height(0)
+	{
+		m_scratch = rendertarget::Desc::Color(GL_RG32F, 0, 0);
+		m_quad = Mesh();
+	}
+
+	SeparableBlur::~SeparableBlur()
+	{
+	}
+
+	bool SeparableBlur::Load(Mode mode, int radius, GLsizei width, GLsizei height, GLint internalformat)
+	{
+		m_mode   = mode;
+		m_width  = width;
+		m_height = height;
+		m_scratch = rendertarget::Desc::Color(internalformat, width, height);
+
+		if (mode == GAUSSIAN) {
+			if (!m_gaussianProgram.Load(ShaderInfo::VSFS("blurVertexShader.glsl", "blurFragmentShader.glsl")))
+				return false;
+		}
+		else {
+			// Compiled in parallel
+			m_prefixSumProgram.LoadAsync(ShaderInfo::VSFS("blurVertexShader.glsl", "prefixSumFragmentShader.glsl"));
+			m_boxProgram.LoadAsync(ShaderInfo::VSFS("blurVertexShader.glsl", "boxFilterFragmentShader.glsl"));
+			if (!m_prefixSumProgram.Finish() || !m_boxProgram.Finish())
+				return false;
+
+			m_stepUniform = m_prefixSumProgram.GetUniform("Step");
+			m_biasUniform = m_prefixSumProgram.GetUniform("Bias");
+		}
+
+		SetRadius(radius);
+
+		m_quad = create_quad();
+
+		return true;
+	}
+
+	void SeparableBlur::Delete()
+	{
+		m_gaussianProgram.DeleteProgram();
+		m_prefixSumProgram.DeleteProgram();
+		m_boxProgram.DeleteProgram();
+
+		if (m_quad.vao != 0) {
+			delete_mesh(m_quad);
+			m_quad = Mesh();
+		}
+	}
+
+	void SeparableBlur::SetRadius(int radius)
+	{
+		m_radius = radius;
+
+		if (m_mode == GAUSSIAN)
+			SetKernel(m_gaussianProgram, GaussianKernel(radius));
+		else
+			m_boxProgram.UpdateUniformi("Radius", radius);
+	}
+
+	int SeparableBlur::GetRadius() const
+	{
+		return m_radius;
+	}
+
+	size_t SeparableBlur::MemorySize() const
+	{
+		return (m_mode == GAUSSIAN ? 1 : 2) * m_scratch.MemorySize();
+	}
+
+	void SeparableBlur::Apply(GLuint srcTex, GLuint dstFBO)
+	{
+		glstate::Disable(GL_DEPTH_TEST);
+		glstate::Viewport(0, 0, m_width, m_height);
+
+		if (m_mode == GAUSSIAN)
+			ApplyGaussian(srcTex, dstFBO);
+		else
+			ApplyRunningSum(srcTex, dstFBO);
+
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
+		glstate::BindTexture(GL_TEXTURE_2D, 0);
+		glstate::Enable(GL_DEPTH_TEST);
+	}
+
+	void SeparableBlur::DrawQuad(GLuint fbo, GLuint tex)
+	{
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glstate::BindTexture(GL_TEXTURE_2D, tex);
+		draw_mesh(m_quad);
+	}
+
+	void SeparableBlur::ApplyGaussian(GLuint srcTex, GLuint dstFBO)
+	{
+		rendertarget::Lease scratch = rendertarget::Scratch().Acquire(m_scratch);
+		m_gaussianProgram.UseProgram();
+
+		// Horizontally to scratch
+		m_gaussianProgram.UpdateUniform("ScaleU", glm::vec2(1.0 / m_width, 0));
+		DrawQuad(scratch.GetFramebuffer(), srcTex);
+
+		// Vertically to destination
+		m_gaussianProgram.UpdateUniform("ScaleU", glm::vec2(0, 1.0 / m_height));
+		DrawQuad(dstFBO, scratch.GetTexture());
+	}
+
+	void SeparableBlur::ApplyRunningSum(GLuint srcTex, GLuint dstFBO)
+	{
+		// Summed in a range centered on zero to keep float precision
+		const glm::vec4 bias(0.5f, 0.25f, 0.0f, 0.0f);
+
+		// Ping-ponged between
+		rendertarget::Lease scratch[2] = { rendertarget::Scratch().Acquire(m_scratch), rendertarget::Scratch().Acquire(m_scratch) };
+
+		GLuint src = srcTex;
+		int target = 0;
+
+		for (int axis = 0; axis < 2; ++axis) {
+			GLsizei size = (axis == 0) ? m_width : m_height;
+
+			// Inclusive prefix sums along the axis (Hillis-Steele; log2(size) passes)
+			m_prefixSumProgram.UseProgram();
+			m_prefixSumProgram.UpdateUniformi("Axis", axis);
+			for (int step = 1; step < size; step *= 2) {
+				m_prefixSumProgram.UpdateUniformi(m_stepUniform, step);
+				m_prefixSumProgram.UpdateUniform(m_biasUniform, step == 1 ? bias : glm::vec4(0.0f));
+				DrawQuad(scratch[target].GetFramebuffer(), src);
+				src = scratch[target].GetTexture();
+				target ^= 1;
+			}
+
+			// Box from two prefix sums
+			m_boxProgram.UseProgram();
+			m_boxProgram.UpdateUniformi("Axis", axis);
+			m_boxProgram.UpdateUniform("Bias", bias);
+			if (axis == 0) {
+				DrawQuad(scratch[target].GetFramebuffer(), src);
+				src = scratch[target].GetTexture();
+				target ^= 1;
+			}
+			else {
+				DrawQuad(dstFBO, src);
+			}
+		}
+	}
+}
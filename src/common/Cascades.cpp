@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Cascades.hpp"
+#include "OpenGL.hpp"
+
+namespace cascades
+{
+	void ComputeSplits(int count, float lambda, float zNear, float farDistance, float* splits)
+	{
+		for (int i = 1; i <= count; ++i) {
+			float f = (float)i / count;
+			float logSplit = zNear * std::pow(farDistance / zNear, f);
+			float uniformSplit = zNear + (farDistance - zNear) * f;
+			splits[i - 1] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+		}
+	}
+
+	Cascades Fit(const Settings& settings, const glm::mat4& view, float fovy, float aspect, float zNear,
+		const glm::vec3& lightDir)
+	{
+		Cascades cascades;
+		cascades.count = std::min(settings.count, MAX_CASCADES);
+		ComputeSplits(cascades.count, settings.lambda, zNear, settings.shadowDistance, cascades.splits);
+
+		// Rotation only, so snapping in light-space also snaps in world-space
+		glm::vec3 up = std::fabs(lightDir.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+		glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDir, up);
+
+		glm::mat4 viewInv = glm::inverse(view);
+
+		float splitNear = zNear;
+		for (int i = 0; i < cascades.count; ++i) {
+			float splitFar = cascades.splits[i];
+
+			// Corners of the split (in world-space)
+			glm::mat4 toWorld = viewInv * glm::inverse(glm::perspective(fovy, aspect, splitNear, splitFar));
+			glm::vec3 corners[8];
+			glm::vec3 center(0.0f);
+			for (int c = 0; c < 8; ++c) {
+				glm::vec4 ndc((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f, 1.0f);
+				glm::vec4 p = toWorld * ndc;
+				corners[c] = glm::vec3(p) / p.w;
+				center += corners[c] / 8.0f;
+			}
+
+			float radius = 0.0f;
+			for (int c = 0; c < 8; ++c)
+				radius = std::max(radius, glm::length(corners[c] - center));
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+
+			// Snap center to texel-increments
+			glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+			float texelSize = 2.0f * radius / settings.resolution;
+			lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+			lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+			glm::mat4 proj = glm::ortho(
+				lightCenter.x - radius, lightCenter.x + radius,
+				lightCenter.y - radius, lightCenter.y + radius,
+				-lightCenter.z - radius - settings.casterMargin, -lightCenter.z + radius);
+
+			cascades.matrices[i] = proj * lightView;
+			splitNear = splitFar;
+		}
+
+		return cascades;
+	}
+
+	void SetUniforms(ShaderProgram& program, const Cascades& cascades)
+	{
+		program.UpdateUniformi("cascadeCount", cascades.count);
+		program.UpdateUniform("cascadeSplits", cascades.splits, cascades.count);
+		program.UpdateUniform("cascadeMatrices", cascades.matrices, cascades.count);
+	}
+}
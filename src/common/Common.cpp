@@ -1,15 +1,38 @@
 #include "Common.hpp"
+#include "Geometry.hpp"
+#include "Profiler.hpp"
+#include "ShaderProgram.hpp"
 #include "OpenGL.hpp"
+#include "GLState.hpp"
+#include "DSA.hpp"
+#include "RenderTargets.hpp"
+#include <algorithm>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 namespace texture
 {
-	GLuint Create2D(GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type)
+	GLuint Create2D(GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type, bool mipmaps)
 	{
 		GLuint tex;
+		if (dsa::IsSupported()) {
+			dsa::CreateTextures(GL_TEXTURE_2D, 1, &tex);
+			dsa::TextureStorage2D(tex, mipmaps ? MipLevels(width, height) : 1, dsa::SizedFormat(internalformat, type), width, height);
+			SetFiltering2D(tex, texture::Filtering::LINEAR);
+			return tex;
+		}
+
 		glGenTextures(1, &tex);
 
-		glBindTexture(GL_TEXTURE_2D, tex);
+		glstate::BindTexture(GL_TEXTURE_2D, tex);
 		glTexImage2D(GL_TEXTURE_2D, 0, internalformat, width, height, 0, format, type, NULL);
 
 		SetFiltering2D(tex, texture::Filtering::LINEAR);
@@ -17,10 +40,16 @@ namespace texture
 		return tex;
 	}
 
-	void SetWrapMode2D(GLuint texture, WrapMode mode, GLfloat border)
+	GLsizei MipLevels(GLsizei width, GLsizei height)
 	{
-		glBindTexture(GL_TEXTURE_2D, texture);
+		GLsizei levels = 1;
+		for (GLsizei size = std::max(width, height); size > 1; size /= 2)
+			++levels;
+		return levels;
+	}
 
+	void SetWrapMode2D(GLuint texture, WrapMode mode, GLfloat border)
+	{
 		GLenum wrap = GL_REPEAT;
 
 		switch (mode)
@@ -33,14 +62,35 @@ namespace texture
 			break;
 		}
 
+		GLfloat b[] = { border, border, border, border };
+
+		if (dsa::IsSupported()) {
+			dsa::TextureParameteri(texture, GL_TEXTURE_WRAP_S, wrap);
+			dsa::TextureParameteri(texture, GL_TEXTURE_WRAP_T, wrap);
+			if (mode == ClampBorder)
+				dsa::TextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, b);
+			return;
+		}
+
+		glstate::BindTexture(GL_TEXTURE_2D, texture);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
 
 		if (mode == ClampBorder)
-		{
-			GLfloat b[] = { border, border, border, border };
 			glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, b);
+	}
+
+	void SetDepthCompare(GLenum target, GLuint texture)
+	{
+		if (dsa::IsSupported()) {
+			dsa::TextureParameteri(texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			dsa::TextureParameteri(texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+			return;
 		}
+
+		glstate::BindTexture(target, texture);
+		glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
 	}
 
 	void SetFiltering2D(GLuint texture, Filtering filtering)
@@ -59,7 +109,15 @@ namespace texture
 			break;
 		}
 
-		glBindTexture(GL_TEXTURE_2D, texture);
+		if (dsa::IsSupported()) {
+			dsa::TextureParameteri(texture, GL_TEXTURE_MAG_FILTER, magFilter);
+			dsa::TextureParameteri(texture, GL_TEXTURE_MIN_FILTER, minFilter);
+			if (filtering == MIPMAP)
+				dsa::GenerateTextureMipmap(texture);
+			return;
+		}
+
+		glstate::BindTexture(GL_TEXTURE_2D, texture);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
 
@@ -70,8 +128,20 @@ namespace texture
 	GLuint Framebuffer(int colorTex, int depthTex)
 	{
 		GLuint fbo;
+		if (dsa::IsSupported()) {
+			dsa::CreateFramebuffers(1, &fbo);
+			if (depthTex != -1)
+				dsa::NamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depthTex, 0);
+			if (colorTex != -1)
+				dsa::NamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, colorTex, 0);
+
+			if (GL_FRAMEBUFFER_COMPLETE != dsa::CheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER))
+				printf("ERROR: Framebuffer is not complete.\n");
+			return fbo;
+		}
+
 		glGenFramebuffers(1, &fbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, fbo);
 
 		if(depthTex != -1)
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTex, 0);
@@ -83,7 +153,111 @@ namespace texture
 			 printf ("ERROR: Framebuffer is not complete.\n");
 		}
 
-		glBindFramebuffer (GL_FRAMEBUFFER, 0);
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		return fbo;
+	}
+
+	GLuint Create2DArray(GLint internalformat, GLsizei width, GLsizei height, GLsizei layers, GLenum format, GLenum type)
+	{
+		GLuint tex;
+		if (dsa::IsSupported()) {
+			dsa::CreateTextures(GL_TEXTURE_2D_ARRAY, 1, &tex);
+			dsa::TextureStorage3D(tex, 1, dsa::SizedFormat(internalformat, type), width, height, layers);
+			dsa::TextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			dsa::TextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			dsa::TextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			dsa::TextureParameteri(tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			return tex;
+		}
+
+		glGenTextures(1, &tex);
+
+		glstate::BindTexture(GL_TEXTURE_2D_ARRAY, tex);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalformat, width, height, layers, 0, format, type, NULL);
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		return tex;
+	}
+
+	size_t MemorySize(GLint internalformat, GLsizei width, GLsizei height, GLsizei layers)
+	{
+		size_t texelSize;
+		switch (internalformat) {
+		case GL_R8:                 texelSize = 1;  break;
+		case GL_RG8:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:  texelSize = 2;  break;
+		case GL_RGB8:               texelSize = 3;  break;
+		case GL_RGBA8:
+		case GL_RG16F:
+		case GL_R32F:
+		case GL_DEPTH_COMPONENT:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+		case GL_DEPTH_COMPONENT32F: texelSize = 4;  break;
+		case GL_RGB16F:             texelSize = 6;  break;
+		case GL_RGBA16F:
+		case GL_RG32F:              texelSize = 8;  break;
+		case GL_RGB32F:             texelSize = 12; break;
+		case GL_RGBA32F:            texelSize = 16; break;
+		default:
+			printf("Unknown size of internal format 0x%x\n", internalformat);
+			texelSize = 4;
+		}
+
+		return texelSize * width * height * layers;
+	}
+
+	GLuint FramebufferLayer(int colorTex, int depthTex, int layer)
+	{
+		GLuint fbo;
+		if (dsa::IsSupported()) {
+			dsa::CreateFramebuffers(1, &fbo);
+			if (depthTex != -1 && layer < 0)
+				dsa::NamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depthTex, 0);
+			else if (depthTex != -1)
+				dsa::NamedFramebufferTextureLayer(fbo, GL_DEPTH_ATTACHMENT, depthTex, 0, layer);
+			if (colorTex != -1 && layer < 0)
+				dsa::NamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, colorTex, 0);
+			else if (colorTex != -1)
+				dsa::NamedFramebufferTextureLayer(fbo, GL_COLOR_ATTACHMENT0, colorTex, 0, layer);
+			else {
+				dsa::NamedFramebufferDrawBuffer(fbo, GL_NONE);
+				dsa::NamedFramebufferReadBuffer(fbo, GL_NONE);
+			}
+
+			if (GL_FRAMEBUFFER_COMPLETE != dsa::CheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER))
+				printf("ERROR: Framebuffer is not complete.\n");
+			return fbo;
+		}
+
+		glGenFramebuffers(1, &fbo);
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+		if(depthTex != -1 && layer < 0)
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTex, 0);
+		else if(depthTex != -1)
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTex, 0, layer);
+		if(colorTex != -1 && layer < 0)
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTex, 0);
+		else if(colorTex != -1)
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTex, 0, layer);
+		else {
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+		}
+
+		GLenum result = glCheckFramebufferStatus (GL_FRAMEBUFFER);
+		if (GL_FRAMEBUFFER_COMPLETE != result) {
+			 printf ("ERROR: Framebuffer is not complete.\n");
+		}
+
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		return fbo;
 	}
@@ -190,53 +364,169 @@ static float quadVertices[] = {
 	-1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, // Top-left
 };
 
-static Mesh create_mesh(float* verts, int size)
+// Floats per vertex of the arrays above
+static const int VERTEX_FLOATS = 11;
+
+// Indexes, optimizes and uploads a triangle-list of the arrays above (their color isn't used)
+static Mesh create_mesh(const float* verts, int size, bool positionStream)
 {
-	Mesh mesh;
-
-	// Create VAO
-	glGenVertexArrays(1, &mesh.vao);
-	glBindVertexArray(mesh.vao);
-
-	// Create VBO and copy the vertex data to it
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, size, verts, GL_STATIC_DRAW);
-
-	// Enable attribs
-	// Position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), 0);
-	// Color
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(3 * sizeof(float)));
-	// Texcoords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(6 * sizeof(float)));
-	// Normal
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(8 * sizeof(float)));
-
-	return mesh;
+	std::vector<geometry::Vertex> triangles(size / (VERTEX_FLOATS * sizeof(float)));
+	for (size_t i = 0; i < triangles.size(); ++i) {
+		const float* v = &verts[i * VERTEX_FLOATS];
+		triangles[i].position = glm::vec3(v[0], v[1], v[2]);
+		triangles[i].texcoord = glm::vec2(v[6], v[7]);
+		triangles[i].normal   = glm::vec3(v[8], v[9], v[10]);
+	}
+
+	return geometry::Build(triangles, positionStream);
 }
 
 void delete_mesh(Mesh m)
 {
 	glDeleteBuffers(1, &m.vbo);
+	glDeleteBuffers(1, &m.ebo);
 	glDeleteVertexArrays(1, &m.vao);
+
+	if (m.shadowVao != 0) {
+		glDeleteBuffers(1, &m.positionVbo);
+		glDeleteBuffers(1, &m.shadowEbo);
+		glDeleteVertexArrays(1, &m.shadowVao);
+	}
+}
+
+void draw_mesh(const Mesh& m, bool shadowpass)
+{
+	if (shadowpass && m.shadowVao != 0) {
+		glBindVertexArray(m.shadowVao);
+		glDrawElements(GL_TRIANGLES, m.shadowIndexCount, m.shadowIndexType, 0);
+	}
+	else {
+		glBindVertexArray(m.vao);
+		glDrawElements(GL_TRIANGLES, m.indexCount, m.indexType, 0);
+	}
+	glBindVertexArray(0);
 }
 
 Mesh create_cube()
 {
-	return create_mesh(cubeVertices, sizeof(cubeVertices));
+	return create_mesh(cubeVertices, sizeof(cubeVertices), true);
+}
+
+void append_cube_positions(std::vector<glm::vec3>& positions, const glm::mat4& model)
+{
+	for (int i = 0; i < 36; ++i) {
+		const float* v = &cubeVertices[i * VERTEX_FLOATS];
+		positions.push_back(glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f)));
+	}
 }
 
 Mesh create_quad()
 {
-	return create_mesh(quadVertices, sizeof(cubeVertices));
+	return create_mesh(quadVertices, sizeof(quadVertices), false); // Only drawn full-screen
 }
 
-bool init_opengl(int width, int height, GLFWwindow** ppWindow)
+// State of the frame-loop (see begin_frame()/end_frame())
+static Options      s_options;
+static int          s_width, s_height;
+static int          s_frame;
+static GLuint       s_screenFBO, s_screenColor, s_screenDepth;
+static GLuint       s_frameQueries[2][2]; // Start/end timestamps of the last two frames
+static double       s_cpuMs[2];
+static double       s_cpuTotal, s_gpuTotal;
+static glstate::Counters s_stateCounters[2]; // GL-state changes of the last two frames
+static glstate::Counters s_stateTotals;
+static std::chrono::high_resolution_clock::time_point s_frameStart;
+
+#ifdef HEADLESS_EGL
+static EGLDisplay   s_eglDisplay = EGL_NO_DISPLAY;
+static EGLContext   s_eglContext = EGL_NO_CONTEXT;
+static EGLSurface   s_eglSurface = EGL_NO_SURFACE;
+
+// Surfaceless (or 1x1 pbuffer) context, so no display-server is needed
+static bool create_egl_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	if (getPlatformDisplay)
+		s_eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (s_eglDisplay == EGL_NO_DISPLAY)
+		s_eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if (!eglInitialize(s_eglDisplay, NULL, NULL)) {
+		fprintf(stderr, "eglInitialize failed\n");
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		fprintf(stderr, "eglBindAPI(EGL_OPENGL_API) failed\n");
+		return false;
+	}
+
+	EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(s_eglDisplay, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+		config = (EGLConfig) 0; // EGL_NO_CONFIG_KHR
+
+	EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+		EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,
+		EGL_NONE
+	};
+	s_eglContext = eglCreateContext(s_eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+	if (s_eglContext == EGL_NO_CONTEXT) {
+		fprintf(stderr, "eglCreateContext failed\n");
+		return false;
+	}
+
+	if (!eglMakeCurrent(s_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, s_eglContext)) {
+		// No EGL_KHR_surfaceless_context
+		EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		s_eglSurface = eglCreatePbufferSurface(s_eglDisplay, config, pbufferAttribs);
+		if (!eglMakeCurrent(s_eglDisplay, s_eglSurface, s_eglSurface, s_eglContext)) {
+			fprintf(stderr, "eglMakeCurrent failed\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+#endif
+
+static bool load_opengl()
+{
+	// Load OpenGL-functions
+	if (gl3wInit()) {
+		fprintf(stderr, "Failed to initialize OpenGL\n");
+		return false;
+	}
+	if (!gl3wIsSupported(3, 3)) {
+		fprintf(stderr, "OpenGL 3.3 not supported\n");
+		return false;
+	}
+
+	// Enable debug output (no glGetError() all over the place)
+	if(GL_ARB_debug_output)
+	{
+		glstate::Enable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+		glDebugMessageCallbackARB(DebugFunc, (void*)15);
+	}
+
+	// Print info
+	printf("OpenGL %s, GLSL %s\n", glGetString(GL_VERSION),
+		glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+	return true;
+}
+
+static bool create_window(int width, int height, bool visible, GLFWwindow** ppWindow)
 {
 	// Initialize GLFW
 	if( !glfwInit() ) {
@@ -251,6 +541,7 @@ bool init_opengl(int width, int height, GLFWwindow** ppWindow)
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	glfwWindowHint(GLFW_RESIZABLE,GL_FALSE);
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GL_TRUE : GL_FALSE);
 
 	GLFWwindow* window = glfwCreateWindow(width, height, "OpenGL", NULL, NULL);
 
@@ -262,28 +553,301 @@ bool init_opengl(int width, int height, GLFWwindow** ppWindow)
 
 	glfwMakeContextCurrent(window);
 
-	// Load OpenGL-functions
-	if (gl3wInit()) {
-		fprintf(stderr, "Failed to initialize OpenGL\n");
+	*ppWindow = window;
+
+	return true;
+}
+
+bool init_opengl(int width, int height, GLFWwindow** ppWindow)
+{
+	return init_opengl(width, height, ppWindow, Options());
+}
+
+bool init_opengl(int width, int height, GLFWwindow** ppWindow, const Options& options)
+{
+	s_options = options;
+	s_width   = width;
+	s_height  = height;
+	s_frame   = 0;
+	*ppWindow = nullptr;
+
+	if (options.headless) {
+#ifdef HEADLESS_EGL
+		if (!create_egl_context())
+			return false;
+#else
+		// No EGL, so fall back to a hidden window
+		if (!create_window(width, height, false, ppWindow))
+			return false;
+#endif
+	}
+	else if (!create_window(width, height, true, ppWindow)) {
 		return false;
 	}
-	if (!gl3wIsSupported(3, 3)) {
-		fprintf(stderr, "OpenGL 3.3 not supported\n");
+
+	if (!load_opengl())
 		return false;
+
+	if (options.headless) {
+		// Stands in for the window's framebuffer
+		glGenRenderbuffers(1, &s_screenColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, s_screenColor);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &s_screenDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, s_screenDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &s_screenFBO);
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, s_screenFBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, s_screenColor);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, s_screenDepth);
+		GLenum result = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (GL_FRAMEBUFFER_COMPLETE != result) {
+			printf("ERROR: Framebuffer is not complete.\n");
+			return false;
+		}
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
-	// Enable debug output (no glGetError() all over the place)
-	if(GL_ARB_debug_output)
-	{
-		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
-		glDebugMessageCallbackARB(DebugFunc, (void*)15);
+	glGenQueries(4, &s_frameQueries[0][0]);
+
+	ShaderProgram::SetBinaryCacheDir(options.shaderCacheDir);
+	dsa::SetEnabled(options.dsa);
+
+	if (options.profile && !profiler::Init(options.profileFile))
+		return false;
+
+	return true;
+}
+
+Options parse_options(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+
+		if (arg == "--headless")
+			options.headless = true;
+		else if (arg == "--frames" && i + 1 < argc)
+			options.frames = atoi(argv[++i]);
+		else if (arg == "--dump" && i + 1 < argc)
+			options.dumpFile = argv[++i];
+		else if (arg == "--profile")
+			options.profile = true;
+		else if (arg == "--profile-csv" && i + 1 < argc) {
+			options.profile = true;
+			options.profileFile = argv[++i];
+		}
+		else if (arg == "--shadowmap-size" && i + 1 < argc)
+			options.shadowMapSize = atoi(argv[++i]);
+		else if (arg == "--sampling" && i + 1 < argc)
+			options.samplingType = atoi(argv[++i]);
+		else if (arg == "--blur-radius" && i + 1 < argc)
+			options.blurRadius = atoi(argv[++i]);
+		else if (arg == "--shadow-factor")
+			options.shadowFactor = true;
+		else if (arg == "--no-shadow-cache")
+			options.shadowCache = false;
+		else if (arg == "--no-gpu-culling")
+			options.gpuCulling = false;
+		else if (arg == "--no-dsa")
+			options.dsa = false;
+		else if (arg == "--shader-cache" && i + 1 < argc)
+			options.shaderCacheDir = argv[++i];
+		else if (arg == "--no-shader-cache")
+			options.shaderCacheDir = "";
+		else if (arg == "--scene" && i + 1 < argc)
+			options.sceneFile = argv[++i];
+		else if (arg == "--validate-scene")
+			options.validateScene = true;
+		else if (arg == "--vsm-format" && i + 1 < argc) {
+			std::string format = argv[++i];
+			if (format == "rg16f")
+				options.vsmFormat = GL_RG16F;
+			else if (format == "rg32f")
+				options.vsmFormat = GL_RG32F;
+			else
+				fprintf(stderr, "Unknown VSM-format '%s' (rg16f or rg32f)\n", format.c_str());
+		}
+		else
+			fprintf(stderr, "Ignoring unknown option '%s'\n", arg.c_str());
 	}
 
-	// Print info
-	printf("OpenGL %s, GLSL %s\n", glGetString(GL_VERSION),
-		glGetString(GL_SHADING_LANGUAGE_VERSION));
+	// Headless runs must end by themselves
+	if (options.headless && options.frames <= 0)
+		options.frames = 100;
 
-	*ppWindow = window;
+	return options;
+}
+
+GLuint screen_framebuffer()
+{
+	return s_screenFBO;
+}
+
+double frame_time()
+{
+	if (s_options.headless)
+		return s_frame / 60.0;
+	return glfwGetTime();
+}
+
+void print_shadow_memory(size_t bytes)
+{
+	printf("Shadow memory: %lu bytes (%.2f MB)\n", (unsigned long) bytes, bytes / (1024.0 * 1024.0));
+}
+
+// Writes the current screen-framebuffer to a binary PPM
+static bool dump_screen(const std::string& file)
+{
+	std::vector<unsigned char> pixels(s_width * s_height * 3);
+
+	glstate::BindFramebuffer(GL_READ_FRAMEBUFFER, s_screenFBO);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, s_width, s_height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+	glstate::BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	FILE* fp = fopen(file.c_str(), "wb");
+	if (!fp) {
+		fprintf(stderr, "Couldn't open '%s' for writing\n", file.c_str());
+		return false;
+	}
+
+	// PPM is top-to-bottom
+	fprintf(fp, "P6\n%d %d\n255\n", s_width, s_height);
+	for (int y = s_height - 1; y >= 0; --y)
+		fwrite(&pixels[y * s_width * 3], 1, s_width * 3, fp);
+	fclose(fp);
+
+	printf("Wrote %s\n", file.c_str());
+	return true;
+}
+
+bool begin_frame(GLFWwindow* window)
+{
+	if (s_options.frames > 0 && s_frame >= s_options.frames)
+		return false;
+
+	if (window) {
+		if (glfwWindowShouldClose(window) || glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+			return false;
+	}
+
+	s_frameStart = std::chrono::high_resolution_clock::now();
+	glQueryCounter(s_frameQueries[s_frame % 2][0], GL_TIMESTAMP);
+	profiler::BeginFrame();
+	glstate::ResetCounters();
 
 	return true;
-}
\ No newline at end of file
+}
+
+// GPU-time of a frame begun/ended within the last two frames (waits for it)
+static double frame_gpu_ms(int frame)
+{
+	GLuint64 start = 0, end = 0;
+	glGetQueryObjectui64v(s_frameQueries[frame % 2][0], GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(s_frameQueries[frame % 2][1], GL_QUERY_RESULT, &end);
+	return (end - start) / 1.0e6;
+}
+
+static void print_frame(int frame)
+{
+	double gpuMs = frame_gpu_ms(frame);
+	const glstate::Counters& state = s_stateCounters[frame % 2];
+	printf("frame %4d  cpu %8.3f ms  gpu %8.3f ms  state-changes %4d (%d skipped)\n", frame, s_cpuMs[frame % 2], gpuMs,
+		state.Issued(), state.Skipped());
+	s_cpuTotal += s_cpuMs[frame % 2];
+	s_gpuTotal += gpuMs;
+	for (int i = 0; i < glstate::CHANGE_COUNT; ++i) {
+		s_stateTotals.issued[i]  += state.issued[i];
+		s_stateTotals.skipped[i] += state.skipped[i];
+	}
+}
+
+// Average GL-state changes per frame, of each kind
+static void print_state_changes(int frames)
+{
+	printf("state-changes per frame, issued/skipped:");
+	for (int i = 0; i < glstate::CHANGE_COUNT; ++i) {
+		printf(" %s %.1f/%.1f", glstate::ChangeName((glstate::Change) i),
+			(double) s_stateTotals.issued[i] / frames, (double) s_stateTotals.skipped[i] / frames);
+	}
+	printf("\n");
+}
+
+static void print_scratch_targets()
+{
+	const rendertarget::Pool& pool = rendertarget::Scratch();
+	printf("scratch-targets: at most %d in use (%.2f MB), %d kept\n", pool.GetPeakInUse(),
+		pool.PeakMemorySize() / (1024.0 * 1024.0), pool.GetCount());
+}
+
+void end_frame(GLFWwindow* window)
+{
+	glQueryCounter(s_frameQueries[s_frame % 2][1], GL_TIMESTAMP);
+	profiler::EndFrame();
+	s_stateCounters[s_frame % 2] = glstate::GetCounters();
+	rendertarget::Scratch().EndFrame();
+
+	bool lastFrame = s_options.frames > 0 && s_frame + 1 >= s_options.frames;
+	bool printTimings = s_options.headless || s_options.frames > 0;
+
+	if (lastFrame && !s_options.dumpFile.empty()) {
+		if (s_screenFBO)
+			dump_screen(s_options.dumpFile);
+		else
+			fprintf(stderr, "--dump needs --headless\n");
+	}
+
+	if (window) {
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+	}
+
+	s_cpuMs[s_frame % 2] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - s_frameStart).count();
+
+	if (printTimings) {
+		// The previous frame's queries are (most likely) done by now, so this doesn't stall
+		if (s_frame > 0)
+			print_frame(s_frame - 1);
+
+		if (lastFrame) {
+			print_frame(s_frame);
+			printf("%d frames, average cpu %.3f ms, gpu %.3f ms\n", s_frame + 1,
+				s_cpuTotal / (s_frame + 1), s_gpuTotal / (s_frame + 1));
+			print_state_changes(s_frame + 1);
+			print_scratch_targets();
+		}
+	}
+
+	s_frame++;
+}
+
+void shutdown_opengl()
+{
+	rendertarget::Scratch().Delete();
+	profiler::Shutdown();
+	glDeleteQueries(4, &s_frameQueries[0][0]);
+
+	if (s_screenFBO) {
+		glstate::DeleteFramebuffers(1, &s_screenFBO);
+		glDeleteRenderbuffers(1, &s_screenColor);
+		glDeleteRenderbuffers(1, &s_screenDepth);
+		s_screenFBO = 0;
+	}
+
+#ifdef HEADLESS_EGL
+	if (s_eglDisplay != EGL_NO_DISPLAY) {
+		eglMakeCurrent(s_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (s_eglSurface != EGL_NO_SURFACE)
+			eglDestroySurface(s_eglDisplay, s_eglSurface);
+		eglDestroyContext(s_eglDisplay, s_eglContext);
+		eglTerminate(s_eglDisplay);
+		s_eglDisplay = EGL_NO_DISPLAY;
+	}
+#endif
+
+	glfwTerminate();
+}
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Culling.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace culling
+{
+	namespace
+	{
+		// Operations on a register of LANES floats; negative() returns a bit per lane less than 0
+#if defined(__AVX__)
+		typedef __m256 Lanes;
+		const int LANES = 8;
+		const char* INSTRUCTION_SET = "AVX";
+
+		inline Lanes load(const float* p) { return _mm256_loadu_ps(p); }
+		inline Lanes splat(float f) { return _mm256_set1_ps(f); }
+		inline Lanes mul_add(Lanes a, Lanes b, Lanes c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+		inline int negative(Lanes a) { return _mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ)); }
+#elif defined(CULLING_SSE2)
+		typedef __m128 Lanes;
+		const int LANES = 4;
+		const char* INSTRUCTION_SET = "SSE2";
+
+		inline Lanes load(const float* p) { return _mm_loadu_ps(p); }
+		inline Lanes splat(float f) { return _mm_set1_ps(f); }
+		inline Lanes mul_add(Lanes a, Lanes b, Lanes c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		inline int negative(Lanes a) { return _mm_movemask_ps(_mm_cmplt_ps(a, _mm_setzero_ps())); }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		typedef float32x4_t Lanes;
+		const int LANES = 4;
+		const char* INSTRUCTION_SET = "NEON";
+
+		inline Lanes load(const float* p) { return vld1q_f32(p); }
+		inline Lanes splat(float f) { return vdupq_n_f32(f); }
+		inline Lanes mul_add(Lanes a, Lanes b, Lanes c) { return vmlaq_f32(c, a, b); }
+		inline int negative(Lanes a)
+		{
+			// No movemask: each lane's compare-result keeps its own bit, and the lanes are summed
+			static const uint32_t bits[4] = { 1, 2, 4, 8 };
+			uint32x4_t lanes = vandq_u32(vcltq_f32(a, vdupq_n_f32(0.0f)), vld1q_u32(bits));
+			uint32x2_t sum   = vpadd_u32(vget_low_u32(lanes), vget_high_u32(lanes));
+			return (int) vget_lane_u32(vpadd_u32(sum, sum), 0);
+		}
+#else
+		typedef float Lanes;
+		const int LANES = 1;
+		const char* INSTRUCTION_SET = "scalar";
+
+		inline Lanes load(const float* p) { return *p; }
+		inline Lanes splat(float f) { return f; }
+		inline Lanes mul_add(Lanes a, Lanes b, Lanes c) { return a * b + c; }
+		inline int negative(Lanes a) { return a < 0.0f ? 1 : 0; }
+#endif
+
+		static_assert(BoundingBoxes::PADDING % LANES == 0, "Boxes must be padded to whole registers");
+
+		const int ALL_LANES = (1 << LANES) - 1;
+
+		// Per plane: its coefficients and its normal's absolute value
+		const int PLANE_FLOATS = 7;
+	}
+
+	Frustum ExtractFrustum(const glm::mat4& viewProjection)
+	{
+		// Rows of the matrix (glm is column-major); clip-space is inside where -w <= x, y, z <= w
+		glm::vec4 row[4];
+		for (int i = 0; i < 4; ++i)
+			row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+		Frustum frustum;
+		frustum.planes[0] = row[3] + row[0]; // Left
+		frustum.planes[1] = row[3] - row[0]; // Right
+		frustum.planes[2] = row[3] + row[1]; // Bottom
+		frustum.planes[3] = row[3] - row[1]; // Top
+		frustum.planes[4] = row[3] + row[2]; // Near
+		frustum.planes[5] = row[3] - row[2]; // Far
+		return frustum;
+	}
+
+	BoundingBoxes::BoundingBoxes()
+		: m_count(0)
+	{
+	}
+
+	void BoundingBoxes::Resize(int count)
+	{
+		int padded = (count + PADDING - 1) / PADDING * PADDING;
+		for (int c = 0; c < 6; ++c)
+			m_components[c].resize(padded, 0.0f);
+		m_count = count;
+	}
+
+	int BoundingBoxes::GetCount() const
+	{
+		return m_count;
+	}
+
+	void BoundingBoxes::Set(int index, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 center  = 0.5f * (boundsMin + boundsMax);
+		glm::vec3 extents = 0.5f * (boundsMax - boundsMin);
+		for (int k = 0; k < 3; ++k) {
+			m_components[k][index]     = center[k];
+			m_components[k + 3][index] = extents[k];
+		}
+	}
+
+	void BoundingBoxes::Set(int index, const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 center  = glm::vec3(model * glm::vec4(0.5f * (boundsMin + boundsMax), 1.0f));
+		glm::vec3 extents = 0.5f * (boundsMax - boundsMin);
+
+		// Each world-axis' extent is the sum of the local extents projected onto it (Arvo 1990)
+		for (int k = 0; k < 3; ++k) {
+			float extent = std::abs(model[0][k]) * extents.x + std::abs(model[1][k]) * extents.y + std::abs(model[2][k]) * extents.z;
+			m_components[k][index]     = center[k];
+			m_components[k + 3][index] = extent;
+		}
+	}
+
+	const float* BoundingBoxes::GetComponent(int c) const
+	{
+		return m_components[c].data();
+	}
+
+	void Classify(const BoundingBoxes& boxes, const Frustum* frusta, int viewCount, ViewMask* masks)
+	{
+		float planes[MAX_VIEWS * 6 * PLANE_FLOATS];
+		viewCount = std::min(viewCount, MAX_VIEWS);
+		for (int v = 0; v < viewCount; ++v) {
+			for (int p = 0; p < 6; ++p) {
+				const glm::vec4& plane = frusta[v].planes[p];
+				float* out = &planes[(v * 6 + p) * PLANE_FLOATS];
+				out[0] = plane.x;
+				out[1] = plane.y;
+				out[2] = plane.z;
+				out[3] = plane.w;
+				out[4] = std::abs(plane.x);
+				out[5] = std::abs(plane.y);
+				out[6] = std::abs(plane.z);
+			}
+		}
+
+		const float* cx = boxes.GetComponent(0);
+		const float* cy = boxes.GetComponent(1);
+		const float* cz = boxes.GetComponent(2);
+		const float* ex = boxes.GetComponent(3);
+		const float* ey = boxes.GetComponent(4);
+		const float* ez = boxes.GetComponent(5);
+
+		const int count = boxes.GetCount();
+		for (int i = 0; i < count; i += LANES) {
+			Lanes x  = load(cx + i), y  = load(cy + i), z  = load(cz + i);
+			Lanes ax = load(ex + i), ay = load(ey + i), az = load(ez + i);
+
+			ViewMask laneMasks[LANES] = {};
+			for (int v = 0; v < viewCount; ++v) {
+				int outside = 0;
+				for (int p = 0; p < 6 && outside != ALL_LANES; ++p) {
+					// Signed distance of the box' corner farthest along the plane's normal;
+					// negative if the whole box is outside the plane
+					const float* plane = &planes[(v * 6 + p) * PLANE_FLOATS];
+					Lanes d = mul_add(splat(plane[0]), x, splat(plane[3]));
+					d = mul_add(splat(plane[1]), y, d);
+					d = mul_add(splat(plane[2]), z, d);
+					d = mul_add(splat(plane[4]), ax, d);
+					d = mul_add(splat(plane[5]), ay, d);
+					d = mul_add(splat(plane[6]), az, d);
+					outside |= negative(d);
+				}
+
+				for (int l = 0; l < LANES; ++l) {
+					if (!(outside & (1 << l)))
+						laneMasks[l] |= ViewMask(1) << v;
+				}
+			}
+
+			int lanes = std::min(LANES, count - i);
+			for (int l = 0; l < lanes; ++l)
+				masks[i + l] = laneMasks[l];
+		}
+	}
+
+	const char* InstructionSet()
+	{
+		return INSTRUCTION_SET;
+	}
+
+	Culler::Culler()
+	{
+	}
+
+	void Culler::Resize(int objectCount)
+	{
+		m_boxes.Resize(objectCount);
+		m_masks.assign(objectCount, 0);
+	}
+
+	int Culler::GetObjectCount() const
+	{
+		return m_boxes.GetCount();
+	}
+
+	void Culler::SetBounds(int object, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		m_boxes.Set(object, boundsMin, boundsMax);
+	}
+
+	void Culler::SetBounds(int object, const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		m_boxes.Set(object, model, boundsMin, boundsMax);
+	}
+
+	void Culler::Cull(const glm::mat4* viewProjections, int viewCount)
+	{
+		viewCount = std::min(viewCount, MAX_VIEWS);
+
+		Frustum frusta[MAX_VIEWS];
+		for (int v = 0; v < viewCount; ++v)
+			frusta[v] = ExtractFrustum(viewProjections[v]);
+
+		if (!m_masks.empty())
+			Classify(m_boxes, frusta, viewCount, m_masks.data());
+
+		m_lists.resize(viewCount);
+		for (int v = 0; v < viewCount; ++v)
+			m_lists[v].clear();
+		m_visible.clear();
+
+		for (size_t i = 0; i < m_masks.size(); ++i) {
+			ViewMask mask = m_masks[i];
+			if (mask == 0)
+				continue;
+
+			m_visible.push_back((int) i);
+			for (int v = 0; v < viewCount; ++v) {
+				if (mask & (ViewMask(1) << v))
+					m_lists[v].push_back((int) i);
+			}
+		}
+	}
+
+	ViewMask Culler::GetViews(int object) const
+	{
+		return m_masks[object];
+	}
+
+	const std::vector<int>& Culler::GetDrawList(int view) const
+	{
+		return m_lists[view];
+	}
+
+	const std::vector<int>& Culler::GetVisible() const
+	{
+		return m_visible;
+	}
+}
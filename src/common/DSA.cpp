@@ -0,0 +1,101 @@
+#include "DSA.hpp"
+
+namespace dsa
+{
+	void   (APIENTRYP CreateTextures)(GLenum target, GLsizei n, GLuint* textures) = 0;
+	void   (APIENTRYP TextureStorage2D)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height) = 0;
+	void   (APIENTRYP TextureStorage3D)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth) = 0;
+	void   (APIENTRYP TextureParameteri)(GLuint texture, GLenum pname, GLint param) = 0;
+	void   (APIENTRYP TextureParameterfv)(GLuint texture, GLenum pname, const GLfloat* param) = 0;
+	void   (APIENTRYP GenerateTextureMipmap)(GLuint texture) = 0;
+
+	void   (APIENTRYP CreateFramebuffers)(GLsizei n, GLuint* framebuffers) = 0;
+	void   (APIENTRYP NamedFramebufferTexture)(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level) = 0;
+	void   (APIENTRYP NamedFramebufferTextureLayer)(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level, GLint layer) = 0;
+	void   (APIENTRYP NamedFramebufferDrawBuffer)(GLuint framebuffer, GLenum buf) = 0;
+	void   (APIENTRYP NamedFramebufferReadBuffer)(GLuint framebuffer, GLenum src) = 0;
+	GLenum (APIENTRYP CheckNamedFramebufferStatus)(GLuint framebuffer, GLenum target) = 0;
+
+	void   (APIENTRYP CreateBuffers)(GLsizei n, GLuint* buffers) = 0;
+	void   (APIENTRYP NamedBufferStorage)(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags) = 0;
+
+	void   (APIENTRYP CreateVertexArrays)(GLsizei n, GLuint* arrays) = 0;
+	void   (APIENTRYP VertexArrayVertexBuffer)(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride) = 0;
+	void   (APIENTRYP VertexArrayElementBuffer)(GLuint vaobj, GLuint buffer) = 0;
+	void   (APIENTRYP EnableVertexArrayAttrib)(GLuint vaobj, GLuint index) = 0;
+	void   (APIENTRYP VertexArrayAttribFormat)(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset) = 0;
+	void   (APIENTRYP VertexArrayAttribBinding)(GLuint vaobj, GLuint attribindex, GLuint bindingindex) = 0;
+
+	namespace
+	{
+		bool s_checked   = false;
+		bool s_supported = false;
+		bool s_enabled   = true;
+
+		template <typename Function>
+		bool load(Function& function, const char* name)
+		{
+			function = (Function) gl3wGetProcAddress(name);
+			return function != 0;
+		}
+	}
+
+	bool IsSupported()
+	{
+		if (!s_checked) {
+			s_checked = true;
+			s_supported = gl3wIsSupported(4, 5) &&
+				load(CreateTextures, "glCreateTextures") &&
+				load(TextureStorage2D, "glTextureStorage2D") &&
+				load(TextureStorage3D, "glTextureStorage3D") &&
+				load(TextureParameteri, "glTextureParameteri") &&
+				load(TextureParameterfv, "glTextureParameterfv") &&
+				load(GenerateTextureMipmap, "glGenerateTextureMipmap") &&
+				load(CreateFramebuffers, "glCreateFramebuffers") &&
+				load(NamedFramebufferTexture, "glNamedFramebufferTexture") &&
+				load(NamedFramebufferTextureLayer, "glNamedFramebufferTextureLayer") &&
+				load(NamedFramebufferDrawBuffer, "glNamedFramebufferDrawBuffer") &&
+				load(NamedFramebufferReadBuffer, "glNamedFramebufferReadBuffer") &&
+				load(CheckNamedFramebufferStatus, "glCheckNamedFramebufferStatus") &&
+				load(CreateBuffers, "glCreateBuffers") &&
+				load(NamedBufferStorage, "glNamedBufferStorage") &&
+				load(CreateVertexArrays, "glCreateVertexArrays") &&
+				load(VertexArrayVertexBuffer, "glVertexArrayVertexBuffer") &&
+				load(VertexArrayElementBuffer, "glVertexArrayElementBuffer") &&
+				load(EnableVertexArrayAttrib, "glEnableVertexArrayAttrib") &&
+				load(VertexArrayAttribFormat, "glVertexArrayAttribFormat") &&
+				load(VertexArrayAttribBinding, "glVertexArrayAttribBinding");
+		}
+
+		return s_enabled && s_supported;
+	}
+
+	void SetEnabled(bool enabled)
+	{
+		s_enabled = enabled;
+	}
+
+	GLenum SizedFormat(GLint internalformat, GLenum type)
+	{
+		bool isFloat = type == GL_FLOAT;
+		bool isHalf  = type == GL_HALF_FLOAT;
+
+		switch (internalformat) {
+		case GL_DEPTH_COMPONENT: return GL_DEPTH_COMPONENT24; // As glTexImage* picks it whatever the type
+		case GL_RED:             return isFloat ? GL_R32F    : isHalf ? GL_R16F    : GL_R8;
+		case GL_RG:              return isFloat ? GL_RG32F   : isHalf ? GL_RG16F   : GL_RG8;
+		case GL_RGB:             return isFloat ? GL_RGB32F  : isHalf ? GL_RGB16F  : GL_RGB8;
+		case GL_RGBA:            return isFloat ? GL_RGBA32F : isHalf ? GL_RGBA16F : GL_RGBA8;
+		}
+		return internalformat;
+	}
+
+	GLuint CreateBuffer(GLsizeiptr size, const void* data)
+	{
+		// Immutable storage can't be empty
+		GLuint buffer;
+		CreateBuffers(1, &buffer);
+		NamedBufferStorage(buffer, size > 0 ? size : 1, size > 0 ? data : 0, 0);
+		return buffer;
+	}
+}
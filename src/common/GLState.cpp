@@ -0,0 +1,262 @@
+#include <cstring>
+
+#include "GLState.hpp"
+
+namespace glstate
+{
+	namespace
+	{
+		// Not a name GL hands out, so nothing matches it until it's set
+		const GLuint UNKNOWN = ~0u;
+
+		// Texture-targets cached per unit
+		enum Target { TARGET_2D, TARGET_2D_ARRAY, TARGET_CUBE_MAP, TARGET_COUNT };
+
+		// Capabilities cached (the others are always issued)
+		const GLenum CAPABILITIES[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST, GL_TEXTURE_CUBE_MAP_SEAMLESS };
+		const int CAPABILITY_COUNT = sizeof(CAPABILITIES) / sizeof(CAPABILITIES[0]);
+
+		struct State
+		{
+			GLuint readFramebuffer, drawFramebuffer;
+			GLuint program;
+			GLuint activeUnit; // Index, not GL_TEXTURE0 + index
+			GLuint textures[MAX_UNITS][TARGET_COUNT];
+			bool   viewportKnown;
+			GLint  viewport[4];
+			GLenum cullFace;
+			int    capabilities[CAPABILITY_COUNT]; // 1 enabled, 0 disabled, -1 unknown
+		};
+
+		State    s_state;
+		Counters s_counters;
+		bool     s_initialized = false;
+
+		State& state()
+		{
+			if (!s_initialized) {
+				Invalidate();
+				s_state.activeUnit = 0; // A new context's, and nothing else is used without ActiveTexture()
+			}
+			return s_state;
+		}
+
+		// Whether a change is needed (counting it either way)
+		bool changes(Change change, bool needed)
+		{
+			if (needed)
+				++s_counters.issued[change];
+			else
+				++s_counters.skipped[change];
+			return needed;
+		}
+
+		int target_index(GLenum target)
+		{
+			switch (target) {
+			case GL_TEXTURE_2D:       return TARGET_2D;
+			case GL_TEXTURE_2D_ARRAY: return TARGET_2D_ARRAY;
+			case GL_TEXTURE_CUBE_MAP: return TARGET_CUBE_MAP;
+			}
+			return -1;
+		}
+
+		int capability_index(GLenum capability)
+		{
+			for (int i = 0; i < CAPABILITY_COUNT; ++i) {
+				if (CAPABILITIES[i] == capability)
+					return i;
+			}
+			return -1;
+		}
+
+		void set_capability(GLenum capability, bool enable)
+		{
+			State& s = state();
+			int index = capability_index(capability);
+			if (!changes(CAPABILITY, index < 0 || s.capabilities[index] != (enable ? 1 : 0)))
+				return;
+
+			if (enable)
+				glEnable(capability);
+			else
+				glDisable(capability);
+			if (index >= 0)
+				s.capabilities[index] = enable ? 1 : 0;
+		}
+	}
+
+	int Counters::Issued() const
+	{
+		int sum = 0;
+		for (int i = 0; i < CHANGE_COUNT; ++i)
+			sum += issued[i];
+		return sum;
+	}
+
+	int Counters::Skipped() const
+	{
+		int sum = 0;
+		for (int i = 0; i < CHANGE_COUNT; ++i)
+			sum += skipped[i];
+		return sum;
+	}
+
+	const char* ChangeName(Change change)
+	{
+		switch (change) {
+		case FRAMEBUFFER: return "framebuffer";
+		case PROGRAM:     return "program";
+		case TEXTURE:     return "texture";
+		case VIEWPORT:    return "viewport";
+		case CULL_FACE:   return "cull-face";
+		case CAPABILITY:  return "capability";
+		default:          return "?";
+		}
+	}
+
+	void BindFramebuffer(GLenum target, GLuint fbo)
+	{
+		State& s = state();
+		bool read = target != GL_DRAW_FRAMEBUFFER;
+		bool draw = target != GL_READ_FRAMEBUFFER;
+		if (!changes(FRAMEBUFFER, (read && s.readFramebuffer != fbo) || (draw && s.drawFramebuffer != fbo)))
+			return;
+
+		glBindFramebuffer(target, fbo);
+		if (read)
+			s.readFramebuffer = fbo;
+		if (draw)
+			s.drawFramebuffer = fbo;
+	}
+
+	void UseProgram(GLuint program)
+	{
+		State& s = state();
+		if (!changes(PROGRAM, s.program != program))
+			return;
+
+		glUseProgram(program);
+		s.program = program;
+	}
+
+	void ActiveTexture(GLenum unit)
+	{
+		State& s = state();
+		GLuint index = unit - GL_TEXTURE0;
+		if (!changes(TEXTURE, s.activeUnit != index))
+			return;
+
+		glActiveTexture(unit);
+		s.activeUnit = index;
+	}
+
+	void BindTexture(GLenum target, GLuint texture)
+	{
+		State& s = state();
+		int t = target_index(target);
+		bool cached = t >= 0 && s.activeUnit < (GLuint) MAX_UNITS;
+		if (!changes(TEXTURE, !cached || s.textures[s.activeUnit][t] != texture))
+			return;
+
+		glBindTexture(target, texture);
+		if (cached)
+			s.textures[s.activeUnit][t] = texture;
+	}
+
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		State& s = state();
+		GLint viewport[4] = { x, y, width, height };
+		if (!changes(VIEWPORT, !s.viewportKnown || memcmp(s.viewport, viewport, sizeof(viewport)) != 0))
+			return;
+
+		glViewport(x, y, width, height);
+		memcpy(s.viewport, viewport, sizeof(viewport));
+		s.viewportKnown = true;
+	}
+
+	void CullFace(GLenum mode)
+	{
+		State& s = state();
+		if (!changes(CULL_FACE, s.cullFace != mode))
+			return;
+
+		glCullFace(mode);
+		s.cullFace = mode;
+	}
+
+	void Enable(GLenum capability)
+	{
+		set_capability(capability, true);
+	}
+
+	void Disable(GLenum capability)
+	{
+		set_capability(capability, false);
+	}
+
+	void DeleteFramebuffers(GLsizei n, const GLuint* fbos)
+	{
+		State& s = state();
+		for (GLsizei i = 0; i < n; ++i) {
+			if (fbos[i] == 0)
+				continue;
+			if (s.readFramebuffer == fbos[i])
+				s.readFramebuffer = 0;
+			if (s.drawFramebuffer == fbos[i])
+				s.drawFramebuffer = 0;
+		}
+		glDeleteFramebuffers(n, fbos);
+	}
+
+	void DeleteTextures(GLsizei n, const GLuint* textures)
+	{
+		State& s = state();
+		for (GLsizei i = 0; i < n; ++i) {
+			if (textures[i] == 0)
+				continue;
+			for (int unit = 0; unit < MAX_UNITS; ++unit) {
+				for (int t = 0; t < TARGET_COUNT; ++t) {
+					if (s.textures[unit][t] == textures[i])
+						s.textures[unit][t] = 0;
+				}
+			}
+		}
+		glDeleteTextures(n, textures);
+	}
+
+	void DeleteProgram(GLuint program)
+	{
+		State& s = state();
+		if (program != 0 && s.program == program)
+			s.program = UNKNOWN;
+		glDeleteProgram(program);
+	}
+
+	void Invalidate()
+	{
+		s_state.readFramebuffer = s_state.drawFramebuffer = UNKNOWN;
+		s_state.program    = UNKNOWN;
+		s_state.activeUnit = UNKNOWN;
+		for (int unit = 0; unit < MAX_UNITS; ++unit) {
+			for (int t = 0; t < TARGET_COUNT; ++t)
+				s_state.textures[unit][t] = UNKNOWN;
+		}
+		s_state.viewportKnown = false;
+		s_state.cullFace = GL_NONE;
+		for (int i = 0; i < CAPABILITY_COUNT; ++i)
+			s_state.capabilities[i] = -1;
+		s_initialized = true;
+	}
+
+	void ResetCounters()
+	{
+		memset(&s_counters, 0, sizeof(s_counters));
+	}
+
+	const Counters& GetCounters()
+	{
+		return s_counters;
+	}
+}
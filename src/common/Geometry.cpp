@@ -0,0 +1,534 @@
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <map>
+
+#include <glm/gtc/half_float.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Geometry.hpp"
+#include "OpenGL.hpp"
+#include "DSA.hpp"
+
+namespace geometry
+{
+	namespace
+	{
+		struct LessVertex
+		{
+			bool operator()(const Vertex& a, const Vertex& b) const
+			{
+				return memcmp(&a, &b, sizeof(Vertex)) < 0;
+			}
+		};
+
+		// Size of the LRU-cache OptimizeVertexCache() scores for, and Forsyth's tuned weights
+		const int   CACHE_SIZE          = 32;
+		const float CACHE_DECAY_POWER   = 1.5f;
+		const float LAST_TRIANGLE_SCORE = 0.75f;
+		const float VALENCE_BOOST_SCALE = 2.0f;
+		const float VALENCE_BOOST_POWER = 0.5f;
+
+		// How much a vertex wants its triangles drawn next: more when it's recently used (its
+		// cachePos is low) and when few triangles are left to use it
+		float vertex_score(int cachePos, int remaining)
+		{
+			if (remaining == 0)
+				return -1.0f; // No triangles left
+
+			float score = 0.0f;
+			if (cachePos >= 0) {
+				if (cachePos < 3)
+					score = LAST_TRIANGLE_SCORE; // Used by the last triangle; equal, or they'd favor a strip
+				else
+					score = std::pow(1.0f - (cachePos - 3) / float(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+			}
+
+			return score + VALENCE_BOOST_SCALE * std::pow((float) remaining, -VALENCE_BOOST_POWER);
+		}
+
+		// A FIFO-cache of vertices, as in the GPU's post-transform cache
+		class Fifo
+		{
+		public:
+			Fifo(int size) : m_entries(size, ~0u), m_head(0) {}
+
+			// Returns true if v wasn't in the cache (and adds it)
+			bool Miss(GLuint v)
+			{
+				if (std::find(m_entries.begin(), m_entries.end(), v) != m_entries.end())
+					return false;
+
+				m_entries[m_head] = v;
+				m_head = (m_head + 1) % m_entries.size();
+				return true;
+			}
+
+		private:
+			std::vector<GLuint> m_entries;
+			size_t              m_head;
+		};
+
+		struct Cluster
+		{
+			size_t start, end; // Triangles
+			float  facing;     // Larger the more it faces away from the mesh's center
+		};
+
+		bool MoreFacing(const Cluster& a, const Cluster& b)
+		{
+			return a.facing > b.facing;
+		}
+
+		GLushort pack_half(float v)
+		{
+			return (GLushort) glm::detail::toFloat16(v);
+		}
+
+		GLuint pack_snorm10(float v)
+		{
+			v = std::max(-1.0f, std::min(v, 1.0f));
+			return (GLuint) (int) std::floor(v * 511.0f + 0.5f) & 0x3FF;
+		}
+
+		GLshort pack_snorm16(float v)
+		{
+			v = std::max(-1.0f, std::min(v, 1.0f));
+			return (GLshort) std::floor(v * 32767.0f + 0.5f);
+		}
+
+		// Normalize()d positions are within [-1, 1], give or take rounding
+		void pack_position(GLshort* packed, const glm::vec3& position)
+		{
+			assert(glm::all(glm::lessThanEqual(glm::abs(position), glm::vec3(1.0001f))));
+			packed[0] = pack_snorm16(position.x);
+			packed[1] = pack_snorm16(position.y);
+			packed[2] = pack_snorm16(position.z);
+			packed[3] = pack_snorm16(1.0f);
+		}
+
+		// Attribute of vertex-buffer binding 0 of vao (with DSA)
+		void set_attribute(GLuint vao, GLuint location, GLint size, GLenum type, GLboolean normalized, size_t offset)
+		{
+			dsa::EnableVertexArrayAttrib(vao, location);
+			dsa::VertexArrayAttribFormat(vao, location, size, type, normalized, (GLuint) offset);
+			dsa::VertexArrayAttribBinding(vao, location, 0);
+		}
+
+		// Uploads indices to a new element-buffer, bound to the bound VAO
+		void upload_indices(const void* indices, size_t count, GLenum type, GLuint* ebo)
+		{
+			glGenBuffers(1, ebo);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *ebo);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * IndexSize(type), indices, GL_STATIC_DRAW);
+		}
+	}
+
+	glm::mat4 Normalize(std::vector<Vertex>& triangles)
+	{
+		if (triangles.empty())
+			return glm::mat4(1.0f);
+
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		for (size_t i = 0; i < triangles.size(); ++i) {
+			boundsMin = glm::min(boundsMin, triangles[i].position);
+			boundsMax = glm::max(boundsMax, triangles[i].position);
+		}
+
+		glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+		glm::vec3 half   = 0.5f * (boundsMax - boundsMin);
+		float     scale  = std::max(half.x, std::max(half.y, half.z));
+		if (scale <= 0.0f)
+			scale = 1.0f; // A single point
+
+		for (size_t i = 0; i < triangles.size(); ++i)
+			triangles[i].position = (triangles[i].position - center) / scale;
+
+		return glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(scale));
+	}
+
+	IndexedMesh Index(const std::vector<Vertex>& triangles)
+	{
+		IndexedMesh mesh;
+		mesh.indices.reserve(triangles.size());
+
+		std::map<Vertex, GLuint, LessVertex> unique;
+		for (size_t i = 0; i < triangles.size(); ++i) {
+			std::pair<std::map<Vertex, GLuint, LessVertex>::iterator, bool> it =
+				unique.insert(std::make_pair(triangles[i], (GLuint) mesh.vertices.size()));
+			if (it.second)
+				mesh.vertices.push_back(triangles[i]);
+			mesh.indices.push_back(it.first->second);
+		}
+
+		return mesh;
+	}
+
+	void OptimizeVertexCache(IndexedMesh& mesh)
+	{
+		const std::vector<GLuint>& indices = mesh.indices;
+		const size_t triangleCount = indices.size() / 3;
+		const size_t vertexCount   = mesh.vertices.size();
+
+		// The triangles of each vertex not drawn yet: remaining[v] of them, from offsets[v]
+		std::vector<int> remaining(vertexCount, 0), offsets(vertexCount, 0);
+		for (size_t i = 0; i < indices.size(); ++i)
+			remaining[indices[i]]++;
+		for (size_t v = 1; v < vertexCount; ++v)
+			offsets[v] = offsets[v - 1] + remaining[v - 1];
+
+		std::vector<int> vertexTriangles(indices.size());
+		std::vector<int> filled(vertexCount, 0);
+		for (size_t i = 0; i < indices.size(); ++i) {
+			GLuint v = indices[i];
+			vertexTriangles[offsets[v] + filled[v]++] = (int) (i / 3);
+		}
+
+		std::vector<int>    cachePos(vertexCount, -1);
+		std::vector<bool>   added(triangleCount, false);
+		std::vector<int>    cache, newCache;
+		std::vector<GLuint> sorted;
+		sorted.reserve(indices.size());
+
+		int    best = -1;
+		size_t next = 0; // For when no triangle in the cache is left: the next one in the old order
+
+		while (sorted.size() < indices.size()) {
+			if (best < 0) {
+				while (added[next])
+					++next;
+				best = (int) next;
+			}
+
+			// Draw it, and remove it from its vertices' triangles
+			added[best] = true;
+			for (int k = 0; k < 3; ++k) {
+				GLuint v = indices[3 * best + k];
+				sorted.push_back(v);
+
+				int* tris = &vertexTriangles[offsets[v]];
+				int* last = tris + remaining[v] - 1;
+				std::swap(*std::find(tris, last + 1, best), *last);
+				remaining[v]--;
+			}
+
+			// Its vertices move to the front of the cache
+			newCache.assign(&indices[3 * best], &indices[3 * best] + 3);
+			for (size_t i = 0; i < cache.size(); ++i) {
+				if (std::find(newCache.begin(), newCache.begin() + 3, cache[i]) == newCache.begin() + 3)
+					newCache.push_back(cache[i]);
+			}
+			for (size_t i = CACHE_SIZE; i < newCache.size(); ++i)
+				cachePos[newCache[i]] = -1;
+			if (newCache.size() > (size_t) CACHE_SIZE)
+				newCache.resize(CACHE_SIZE);
+			for (size_t i = 0; i < newCache.size(); ++i)
+				cachePos[newCache[i]] = (int) i;
+			cache.swap(newCache);
+
+			// The best of the triangles using a cached vertex is drawn next
+			best = -1;
+			float bestScore = -1.0f;
+			for (size_t i = 0; i < cache.size(); ++i) {
+				int v = cache[i];
+				for (int j = 0; j < remaining[v]; ++j) {
+					int t = vertexTriangles[offsets[v] + j];
+
+					float score = 0.0f;
+					for (int k = 0; k < 3; ++k) {
+						GLuint u = indices[3 * t + k];
+						score += vertex_score(cachePos[u], remaining[u]);
+					}
+
+					if (score > bestScore) {
+						bestScore = score;
+						best      = t;
+					}
+				}
+			}
+		}
+
+		mesh.indices.swap(sorted);
+	}
+
+	void OptimizeOverdraw(IndexedMesh& mesh)
+	{
+		const std::vector<GLuint>& indices = mesh.indices;
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// A cluster starts wherever all of a triangle's vertices miss the cache, so reordering
+		// whole clusters costs almost no cache-efficiency
+		std::vector<Cluster> clusters;
+		Fifo fifo(16);
+		for (size_t t = 0; t < triangleCount; ++t) {
+			int misses = fifo.Miss(indices[3 * t]) + fifo.Miss(indices[3 * t + 1]) + fifo.Miss(indices[3 * t + 2]);
+			if (misses == 3 || t == 0) {
+				if (!clusters.empty())
+					clusters.back().end = t;
+				Cluster cluster = { t, triangleCount, 0.0f };
+				clusters.push_back(cluster);
+			}
+		}
+
+		glm::vec3 center(0.0f);
+		for (size_t v = 0; v < mesh.vertices.size(); ++v)
+			center += mesh.vertices[v].position;
+		center /= (float) mesh.vertices.size();
+
+		// Area-weighted centroid and normal of each cluster
+		for (size_t c = 0; c < clusters.size(); ++c) {
+			glm::vec3 centroid(0.0f), normal(0.0f);
+			float area = 0.0f;
+			for (size_t t = clusters[c].start; t < clusters[c].end; ++t) {
+				const glm::vec3& a = mesh.vertices[indices[3 * t]].position;
+				const glm::vec3& b = mesh.vertices[indices[3 * t + 1]].position;
+				const glm::vec3& d = mesh.vertices[indices[3 * t + 2]].position;
+				glm::vec3 n = glm::cross(b - a, d - a);
+				float     w = glm::length(n);
+				centroid += w * (a + b + d) / 3.0f;
+				normal   += n;
+				area     += w;
+			}
+
+			if (area > 0.0f && glm::length(normal) > 0.0f)
+				clusters[c].facing = glm::dot(centroid / area - center, glm::normalize(normal));
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), MoreFacing);
+
+		std::vector<GLuint> sorted;
+		sorted.reserve(indices.size());
+		for (size_t c = 0; c < clusters.size(); ++c)
+			sorted.insert(sorted.end(), indices.begin() + 3 * clusters[c].start, indices.begin() + 3 * clusters[c].end);
+
+		mesh.indices.swap(sorted);
+	}
+
+	void OptimizeVertexFetch(IndexedMesh& mesh)
+	{
+		std::vector<GLuint> remap(mesh.vertices.size(), ~0u);
+		std::vector<Vertex> vertices;
+		vertices.reserve(mesh.vertices.size());
+
+		for (size_t i = 0; i < mesh.indices.size(); ++i) {
+			GLuint& v = mesh.indices[i];
+			if (remap[v] == ~0u) {
+				remap[v] = (GLuint) vertices.size();
+				vertices.push_back(mesh.vertices[v]);
+			}
+			v = remap[v];
+		}
+
+		// Unused vertices are dropped
+		mesh.vertices.swap(vertices);
+	}
+
+	float ACMR(const IndexedMesh& mesh, int cacheSize)
+	{
+		if (mesh.indices.empty())
+			return 0.0f;
+
+		Fifo fifo(cacheSize);
+		int misses = 0;
+		for (size_t i = 0; i < mesh.indices.size(); ++i)
+			misses += fifo.Miss(mesh.indices[i]);
+
+		return misses / (mesh.indices.size() / 3.0f);
+	}
+
+	void Optimize(IndexedMesh& mesh)
+	{
+		OptimizeVertexCache(mesh);
+		OptimizeOverdraw(mesh);
+		OptimizeVertexFetch(mesh);
+	}
+
+	void Bounds(const IndexedMesh& mesh, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		boundsMin = glm::vec3(FLT_MAX);
+		boundsMax = glm::vec3(-FLT_MAX);
+		for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+			boundsMin = glm::min(boundsMin, mesh.vertices[i].position);
+			boundsMax = glm::max(boundsMax, mesh.vertices[i].position);
+		}
+	}
+
+	IndexedMesh IndexPositions(const std::vector<Vertex>& triangles)
+	{
+		// Without their other attributes, vertices at the same position are the same
+		std::vector<Vertex> positions(triangles.size(), Vertex());
+		for (size_t i = 0; i < triangles.size(); ++i)
+			positions[i].position = triangles[i].position;
+
+		return Index(positions);
+	}
+
+	std::vector<PackedVertex> Pack(const IndexedMesh& mesh)
+	{
+		std::vector<PackedVertex> packed(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+			const Vertex& v = mesh.vertices[i];
+			pack_position(packed[i].position, v.position);
+			packed[i].texcoord[0] = pack_half(v.texcoord.x);
+			packed[i].texcoord[1] = pack_half(v.texcoord.y);
+			packed[i].normal      = pack_snorm10(v.normal.x) | pack_snorm10(v.normal.y) << 10 | pack_snorm10(v.normal.z) << 20;
+		}
+
+		return packed;
+	}
+
+	std::vector<PackedPosition> PackPositions(const IndexedMesh& mesh)
+	{
+		std::vector<PackedPosition> packed(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); ++i)
+			pack_position(packed[i].position, mesh.vertices[i].position);
+
+		return packed;
+	}
+
+	GLenum PackIndices(const IndexedMesh& mesh, std::vector<char>& bytes)
+	{
+		if (mesh.vertices.size() <= 65536) {
+			bytes.resize(mesh.indices.size() * sizeof(GLushort));
+			GLushort* shorts = (GLushort*) bytes.data();
+			for (size_t i = 0; i < mesh.indices.size(); ++i)
+				shorts[i] = (GLushort) mesh.indices[i];
+			return GL_UNSIGNED_SHORT;
+		}
+
+		bytes.resize(mesh.indices.size() * sizeof(GLuint));
+		memcpy(bytes.data(), mesh.indices.data(), bytes.size());
+		return GL_UNSIGNED_INT;
+	}
+
+	size_t IndexSize(GLenum type)
+	{
+		return type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	}
+
+	glm::vec3 UnpackPosition(const GLshort* packed)
+	{
+		// As GL >= 4.2 converts snorm (-32768 is -1 as well)
+		return glm::max(glm::vec3(packed[0], packed[1], packed[2]) / 32767.0f, glm::vec3(-1.0f));
+	}
+
+	Mesh Upload(const PackedVertex* vertices, size_t vertexCount, const void* indices, size_t indexCount, GLenum indexType)
+	{
+		Mesh result = Mesh();
+		result.indexCount = (GLsizei) indexCount;
+		result.indexType  = indexType;
+
+		if (dsa::IsSupported()) {
+			result.vbo = dsa::CreateBuffer(vertexCount * sizeof(PackedVertex), vertices);
+			result.ebo = dsa::CreateBuffer(indexCount * IndexSize(indexType), indices);
+
+			dsa::CreateVertexArrays(1, &result.vao);
+			dsa::VertexArrayVertexBuffer(result.vao, 0, result.vbo, 0, sizeof(PackedVertex));
+			dsa::VertexArrayElementBuffer(result.vao, result.ebo);
+			set_attribute(result.vao, 0, 4, GL_SHORT, GL_TRUE, offsetof(PackedVertex, position));
+			set_attribute(result.vao, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, texcoord));
+			set_attribute(result.vao, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, normal));
+			return result;
+		}
+
+		glGenVertexArrays(1, &result.vao);
+		glBindVertexArray(result.vao);
+
+		glGenBuffers(1, &result.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, result.vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), vertices, GL_STATIC_DRAW);
+
+		// The element-buffer is part of the VAO
+		upload_indices(indices, indexCount, indexType, &result.ebo);
+
+		// Position
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, position));
+		// Texcoords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, texcoord));
+		// Normal
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, normal));
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+		return result;
+	}
+
+	void UploadPositions(const PackedPosition* positions, size_t positionCount, const void* indices, size_t indexCount, GLenum indexType, Mesh& result)
+	{
+		result.shadowIndexCount = (GLsizei) indexCount;
+		result.shadowIndexType  = indexType;
+
+		if (dsa::IsSupported()) {
+			result.positionVbo = dsa::CreateBuffer(positionCount * sizeof(PackedPosition), positions);
+			result.shadowEbo   = dsa::CreateBuffer(indexCount * IndexSize(indexType), indices);
+
+			dsa::CreateVertexArrays(1, &result.shadowVao);
+			dsa::VertexArrayVertexBuffer(result.shadowVao, 0, result.positionVbo, 0, sizeof(PackedPosition));
+			dsa::VertexArrayElementBuffer(result.shadowVao, result.shadowEbo);
+			set_attribute(result.shadowVao, 0, 4, GL_SHORT, GL_TRUE, 0);
+			return;
+		}
+
+		glGenVertexArrays(1, &result.shadowVao);
+		glBindVertexArray(result.shadowVao);
+
+		glGenBuffers(1, &result.positionVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, result.positionVbo);
+		glBufferData(GL_ARRAY_BUFFER, positionCount * sizeof(PackedPosition), positions, GL_STATIC_DRAW);
+
+		upload_indices(indices, indexCount, indexType, &result.shadowEbo);
+
+		// Position
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, sizeof(PackedPosition), 0);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	Mesh Upload(const IndexedMesh& mesh)
+	{
+		std::vector<PackedVertex> packed = Pack(mesh);
+		std::vector<char> indices;
+		GLenum indexType = PackIndices(mesh, indices);
+
+		Mesh result = Upload(packed.data(), packed.size(), indices.data(), mesh.indices.size(), indexType);
+		Bounds(mesh, result.boundsMin, result.boundsMax);
+		return result;
+	}
+
+	void UploadPositions(const IndexedMesh& mesh, Mesh& result)
+	{
+		std::vector<PackedPosition> packed = PackPositions(mesh);
+		std::vector<char> indices;
+		GLenum indexType = PackIndices(mesh, indices);
+
+		UploadPositions(packed.data(), packed.size(), indices.data(), mesh.indices.size(), indexType, result);
+	}
+
+	Mesh Build(const std::vector<Vertex>& triangles, bool positionStream)
+	{
+		IndexedMesh mesh = Index(triangles);
+		Optimize(mesh);
+		Mesh result = Upload(mesh);
+
+		if (positionStream) {
+			IndexedMesh positionMesh = IndexPositions(triangles);
+			Optimize(positionMesh);
+			UploadPositions(positionMesh, result);
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,195 @@
+#include <cstdio>
+
+#include "GpuCulling.hpp"
+#include "Culling.hpp"
+
+// GL 4.3 (newer than gl3w's headers)
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+namespace gpuculling
+{
+	namespace
+	{
+		typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint x, GLuint y, GLuint z);
+		typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+		PFNGLDISPATCHCOMPUTEPROC           s_dispatchCompute           = 0;
+		PFNGLMULTIDRAWELEMENTSINDIRECTPROC s_multiDrawElementsIndirect = 0;
+
+		bool s_checked   = false;
+		bool s_supported = false;
+
+		// local_size_x of the compute-shader
+		const int GROUP_SIZE = 64;
+
+		// Binding-points of its buffers
+		const GLuint INSTANCES_BINDING = 0;
+		const GLuint BOUNDS_BINDING    = 1;
+		const GLuint COMMANDS_BINDING  = 2;
+
+		constexpr UniformName planesUniform("planes");
+	}
+
+	// The compute-shader reads the instances as floats
+	static_assert(sizeof(instancing::Instance) == 18 * sizeof(float), "cullComputeShader.glsl expects 18 floats per instance");
+	static_assert(sizeof(DrawCommand) == 5 * sizeof(GLuint), "Draw-commands must be tightly packed");
+
+	bool IsSupported()
+	{
+		if (s_checked)
+			return s_supported;
+		s_checked = true;
+
+		if (!gl3wIsSupported(4, 3))
+			return false;
+
+		s_dispatchCompute           = (PFNGLDISPATCHCOMPUTEPROC) gl3wGetProcAddress("glDispatchCompute");
+		s_multiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC) gl3wGetProcAddress("glMultiDrawElementsIndirect");
+		s_supported = s_dispatchCompute && s_multiDrawElementsIndirect;
+		return s_supported;
+	}
+
+	IndirectCuller::IndirectCuller()
+		: m_maxObjects(0), m_viewCount(0)
+	{
+	}
+
+	IndirectCuller::~IndirectCuller()
+	{
+	}
+
+	bool IndirectCuller::Load(int maxObjects, int viewCount)
+	{
+		if (!IsSupported() || viewCount > MAX_VIEWS) {
+			printf("ERROR: GPU-culling isn't supported.\n");
+			return false;
+		}
+
+		if (!m_program.Load(ShaderInfo::CS("cullComputeShader.glsl")))
+			return false;
+
+		m_maxObjects = maxObjects;
+		m_viewCount  = viewCount;
+
+		DrawCommand empty = DrawCommand();
+		m_commands.assign(maxObjects, empty);
+		m_bounds.assign(2 * maxObjects, glm::vec4(0.0f));
+
+		// A region of commands per view, and one for any view
+		m_commandBuffer = resource::GenBuffer();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer.Get());
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, (viewCount + 1) * maxObjects * sizeof(DrawCommand), 0, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		upload_commands(0, maxObjects);
+
+		m_boundsBuffer = resource::GenBuffer();
+		glBindBuffer(GL_ARRAY_BUFFER, m_boundsBuffer.Get());
+		glBufferData(GL_ARRAY_BUFFER, m_bounds.size() * sizeof(glm::vec4), m_bounds.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		return true;
+	}
+
+	void IndirectCuller::Delete()
+	{
+		m_program.DeleteProgram();
+		m_commandBuffer.Reset();
+		m_boundsBuffer.Reset();
+		m_commands.clear();
+		m_bounds.clear();
+	}
+
+	void IndirectCuller::SetObjects(int first, int count, const Mesh& mesh)
+	{
+		if (count <= 0)
+			return;
+
+		bool positions = mesh.shadowVao != 0;
+		glm::vec4 center  = glm::vec4(0.5f * (mesh.boundsMin + mesh.boundsMax), 0.0f);
+		glm::vec4 extents = glm::vec4(0.5f * (mesh.boundsMax - mesh.boundsMin), 0.0f);
+
+		for (int i = first; i < first + count; ++i) {
+			DrawCommand& command = m_commands[i];
+			command.count         = positions ? mesh.shadowIndexCount : mesh.indexCount;
+			command.instanceCount = 0; // Set by Cull()
+			command.firstIndex    = 0;
+			command.baseVertex    = 0;
+			command.baseInstance  = i;
+
+			m_bounds[2 * i]     = center;
+			m_bounds[2 * i + 1] = extents;
+		}
+
+		upload_commands(first, count);
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_boundsBuffer.Get());
+		glBufferSubData(GL_ARRAY_BUFFER, 2 * first * sizeof(glm::vec4), 2 * count * sizeof(glm::vec4), &m_bounds[2 * first]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void IndirectCuller::Cull(instancing::InstanceBuffer& instances, int objectCount, const glm::mat4* viewProjections, bool writeFaces)
+	{
+		if (objectCount <= 0)
+			return;
+
+		glm::vec4 planes[MAX_VIEWS * 6];
+		for (int v = 0; v < m_viewCount; ++v) {
+			culling::Frustum frustum = culling::ExtractFrustum(viewProjections[v]);
+			for (int p = 0; p < 6; ++p)
+				planes[v * 6 + p] = frustum.planes[p];
+		}
+
+		m_program.UseProgram();
+		glProgramUniform4fv(m_program.GetProgram(), m_program.GetUniformLocation(planesUniform), m_viewCount * 6, &planes[0][0]);
+		m_program.UpdateUniformi("viewCount", m_viewCount);
+		m_program.UpdateUniformi("objectCount", objectCount);
+		m_program.UpdateUniformi("maxObjects", m_maxObjects);
+		m_program.UpdateUniformi("writeFaces", writeFaces ? 1 : 0);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, instances.GetBuffer());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, m_boundsBuffer.Get());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, m_commandBuffer.Get());
+
+		s_dispatchCompute((objectCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+		// Drawn from right after, and the instances are re-uploaded over the faces written
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, 0);
+	}
+
+	void IndirectCuller::Draw(instancing::InstanceBuffer& instances, const Mesh& mesh, int first, int count, int view)
+	{
+		if (count <= 0)
+			return;
+
+		// The base-instances are the objects' own, so the attributes point at instance 0
+		bool positions = instances.Bind(mesh, 0, true /*shadowpass*/);
+		GLenum type = positions ? mesh.shadowIndexType : mesh.indexType;
+
+		int region = view < 0 ? m_viewCount : view;
+		size_t offset = ((size_t) region * m_maxObjects + first) * sizeof(DrawCommand);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer.Get());
+		s_multiDrawElementsIndirect(GL_TRIANGLES, type, (const void*) offset, count, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+
+	void IndirectCuller::upload_commands(int first, int count)
+	{
+		if (count <= 0)
+			return;
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer.Get());
+		for (int region = 0; region <= m_viewCount; ++region) {
+			size_t offset = ((size_t) region * m_maxObjects + first) * sizeof(DrawCommand);
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offset, count * sizeof(DrawCommand), &m_commands[first]);
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
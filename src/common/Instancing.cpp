@@ -0,0 +1,158 @@
+#include <cstddef>
+
+#include "Instancing.hpp"
+#include "OpenGL.hpp"
+
+namespace instancing
+{
+	InstanceBuffer::InstanceBuffer()
+	{
+	}
+
+	InstanceBuffer::~InstanceBuffer()
+	{
+	}
+
+	bool InstanceBuffer::Load(int maxInstances)
+	{
+		Instance identity;
+		identity.model     = glm::mat4(1.0f);
+		identity.doTexture = 0.0f;
+		identity.faces     = (float) ALL_FACES;
+		m_instances.assign(maxInstances, identity);
+
+		m_vbo = resource::GenBuffer();
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo.Get());
+		glBufferData(GL_ARRAY_BUFFER, maxInstances * sizeof(Instance), &m_instances[0], GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		return true;
+	}
+
+	void InstanceBuffer::Delete()
+	{
+		m_vbo.Reset();
+		m_attached.clear();
+		m_instances.clear();
+	}
+
+	void InstanceBuffer::Set(int index, const glm::mat4& model, float doTexture)
+	{
+		m_instances[index].model     = model;
+		m_instances[index].doTexture = doTexture;
+	}
+
+	void InstanceBuffer::SetFaces(int index, unsigned faces)
+	{
+		m_instances[index].faces = (float) faces;
+	}
+
+	void InstanceBuffer::Upload()
+	{
+		Upload(0, (int)m_instances.size());
+	}
+
+	void InstanceBuffer::Upload(int first, int count)
+	{
+		if (count <= 0)
+			return;
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo.Get());
+		glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Instance), count * sizeof(Instance), &m_instances[first]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void InstanceBuffer::Attach(const Mesh& mesh)
+	{
+		attach(mesh.vao);
+		if (mesh.shadowVao != 0)
+			attach(mesh.shadowVao);
+	}
+
+	void InstanceBuffer::Draw(const Mesh& mesh, int first, int count, bool shadowpass)
+	{
+		if (count <= 0)
+			return;
+
+		// Without GL 4.2's base-instance the first instance is chosen by offsetting the attributes
+		bool positions = Bind(mesh, first, shadowpass);
+		if (positions)
+			glDrawElementsInstanced(GL_TRIANGLES, mesh.shadowIndexCount, mesh.shadowIndexType, 0, count);
+		else
+			glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0, count);
+		glBindVertexArray(0);
+	}
+
+	void InstanceBuffer::DrawList(const Mesh& mesh, const int* objects, int count, bool shadowpass)
+	{
+		for (int i = 0; i < count; ) {
+			int run = 1;
+			while (i + run < count && objects[i + run] == objects[i] + run)
+				++run;
+
+			Draw(mesh, objects[i], run, shadowpass);
+			i += run;
+		}
+	}
+
+	bool InstanceBuffer::Bind(const Mesh& mesh, int first, bool shadowpass)
+	{
+		bool positions = shadowpass && mesh.shadowVao != 0;
+		GLuint vao = positions ? mesh.shadowVao : mesh.vao;
+		glBindVertexArray(vao);
+
+		// Skipped when the VAO already points there
+		int& pointsAt = m_attached[vao];
+		if (pointsAt != first) {
+			pointers(first);
+			pointsAt = first;
+		}
+
+		return positions;
+	}
+
+	int InstanceBuffer::GetMaxInstances() const
+	{
+		return (int)m_instances.size();
+	}
+
+	GLuint InstanceBuffer::GetBuffer() const
+	{
+		return m_vbo.Get();
+	}
+
+	void InstanceBuffer::attach(GLuint vao)
+	{
+		glBindVertexArray(vao);
+
+		for (GLuint i = 0; i < 4; ++i) {
+			glEnableVertexAttribArray(MODEL_LOCATION + i);
+			glVertexAttribDivisor(MODEL_LOCATION + i, 1);
+		}
+		glEnableVertexAttribArray(DO_TEXTURE_LOCATION);
+		glVertexAttribDivisor(DO_TEXTURE_LOCATION, 1);
+		glEnableVertexAttribArray(FACES_LOCATION);
+		glVertexAttribDivisor(FACES_LOCATION, 1);
+
+		pointers(0);
+		m_attached[vao] = 0;
+
+		glBindVertexArray(0);
+	}
+
+	void InstanceBuffer::pointers(int first)
+	{
+		const size_t base = first * sizeof(Instance);
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo.Get());
+		for (GLuint i = 0; i < 4; ++i) {
+			glVertexAttribPointer(MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+				(void*)(base + offsetof(Instance, model) + i * sizeof(glm::vec4)));
+		}
+		glVertexAttribPointer(DO_TEXTURE_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			(void*)(base + offsetof(Instance, doTexture)));
+		glVertexAttribPointer(FACES_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			(void*)(base + offsetof(Instance, faces)));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
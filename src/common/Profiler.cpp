@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "Profiler.hpp"
+#include "OpenGL.hpp"
+
+namespace profiler
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// One Begin()/End()
+	struct Sample
+	{
+		int               timer;
+		int               query; // Index of the start-query in the frame's pool, end is query+1
+		Clock::time_point cpuStart;
+		double            cpuMs;
+	};
+
+	// Queries and samples of one of the frames in flight
+	struct Frame
+	{
+		int                 number;
+		bool                pending;
+		std::vector<GLuint> queries; // Grows to the most ever used in a frame
+		int                 usedQueries;
+		std::vector<Sample> samples;
+	};
+
+	struct Timer
+	{
+		std::string         name;
+		std::vector<double> cpuMs, gpuMs; // Ring-buffers of the last WINDOW frames it was used in
+		int                 frames;       // Number of frames it has been used in
+		int                 calls;        // Begin()s in the last resolved frame
+	};
+
+	static bool                s_enabled;
+	static FILE*               s_csv;
+	static Frame               s_frames[FRAMES_IN_FLIGHT];
+	static int                 s_frame;
+	static int                 s_resolved;
+	static std::vector<Timer>  s_timers;
+	static std::vector<int>    s_open; // Samples Begin()'d but not yet End()'d
+
+	static int find_timer(const char* name)
+	{
+		for (size_t i = 0; i < s_timers.size(); ++i) {
+			if (s_timers[i].name == name)
+				return (int)i;
+		}
+
+		Timer timer;
+		timer.name = name;
+		timer.cpuMs.resize(WINDOW);
+		timer.gpuMs.resize(WINDOW);
+		timer.frames = 0;
+		timer.calls = 0;
+		s_timers.push_back(timer);
+		return (int)s_timers.size() - 1;
+	}
+
+	// Waits for the queries of a frame (FRAMES_IN_FLIGHT-1 frames old, so normally already done)
+	// and adds the summed time of each pass to its timer
+	static void resolve(Frame& frame)
+	{
+		if (!frame.pending)
+			return;
+
+		std::vector<double> cpuMs(s_timers.size(), 0.0), gpuMs(s_timers.size(), 0.0);
+		std::vector<int> calls(s_timers.size(), 0);
+
+		for (size_t i = 0; i < frame.samples.size(); ++i) {
+			const Sample& sample = frame.samples[i];
+
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(frame.queries[sample.query], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(frame.queries[sample.query + 1], GL_QUERY_RESULT, &end);
+
+			cpuMs[sample.timer] += sample.cpuMs;
+			gpuMs[sample.timer] += (end - start) / 1.0e6;
+			calls[sample.timer]++;
+		}
+
+		for (size_t i = 0; i < s_timers.size(); ++i) {
+			Timer& timer = s_timers[i];
+			timer.calls = calls[i];
+			if (!calls[i])
+				continue;
+
+			timer.cpuMs[timer.frames % WINDOW] = cpuMs[i];
+			timer.gpuMs[timer.frames % WINDOW] = gpuMs[i];
+			timer.frames++;
+
+			if (s_csv)
+				fprintf(s_csv, "%d,%s,%.4f,%.4f\n", frame.number, timer.name.c_str(), cpuMs[i], gpuMs[i]);
+		}
+
+		frame.pending = false;
+		s_resolved++;
+
+		if (s_resolved % WINDOW == 0)
+			Report();
+	}
+
+	bool Init(const std::string& csvFile)
+	{
+		if (!csvFile.empty()) {
+			s_csv = fopen(csvFile.c_str(), "w");
+			if (!s_csv) {
+				fprintf(stderr, "Couldn't open '%s' for writing\n", csvFile.c_str());
+				return false;
+			}
+			fprintf(s_csv, "frame,pass,cpu_ms,gpu_ms\n");
+		}
+
+		for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+			s_frames[i].pending = false;
+			s_frames[i].usedQueries = 0;
+		}
+
+		s_frame = 0;
+		s_resolved = 0;
+		s_enabled = true;
+		return true;
+	}
+
+	void Shutdown()
+	{
+		if (!s_enabled)
+			return;
+
+		// Oldest first
+		for (int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+			resolve(s_frames[(s_frame + i) % FRAMES_IN_FLIGHT]);
+
+		if (s_resolved % WINDOW != 0)
+			Report();
+
+		for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+			Frame& frame = s_frames[i];
+			if (!frame.queries.empty())
+				glDeleteQueries((GLsizei)frame.queries.size(), &frame.queries[0]);
+			frame.queries.clear();
+			frame.samples.clear();
+		}
+
+		if (s_csv) {
+			fclose(s_csv);
+			s_csv = NULL;
+		}
+
+		s_timers.clear();
+		s_enabled = false;
+	}
+
+	bool IsEnabled()
+	{
+		return s_enabled;
+	}
+
+	void BeginFrame()
+	{
+		if (!s_enabled)
+			return;
+
+		// The slot was last used FRAMES_IN_FLIGHT frames ago
+		Frame& frame = s_frames[s_frame % FRAMES_IN_FLIGHT];
+		resolve(frame);
+
+		frame.number = s_frame;
+		frame.pending = true;
+		frame.usedQueries = 0;
+		frame.samples.clear();
+		s_open.clear();
+
+		Begin("frame");
+	}
+
+	void EndFrame()
+	{
+		if (!s_enabled)
+			return;
+
+		// Close whatever was left open, and the "frame"-timer
+		while (!s_open.empty())
+			End();
+
+		s_frame++;
+	}
+
+	void Begin(const char* name)
+	{
+		if (!s_enabled)
+			return;
+
+		Frame& frame = s_frames[s_frame % FRAMES_IN_FLIGHT];
+		if (frame.usedQueries + 2 > (int)frame.queries.size()) {
+			size_t first = frame.queries.size();
+			frame.queries.resize(first + 16);
+			glGenQueries(16, &frame.queries[first]);
+		}
+
+		Sample sample;
+		sample.timer = find_timer(name);
+		sample.query = frame.usedQueries;
+		sample.cpuMs = 0.0;
+		frame.usedQueries += 2;
+
+		s_open.push_back((int)frame.samples.size());
+		frame.samples.push_back(sample);
+
+		glQueryCounter(frame.queries[sample.query], GL_TIMESTAMP);
+		frame.samples.back().cpuStart = Clock::now();
+	}
+
+	void End()
+	{
+		if (!s_enabled || s_open.empty())
+			return;
+
+		Frame& frame = s_frames[s_frame % FRAMES_IN_FLIGHT];
+		Sample& sample = frame.samples[s_open.back()];
+		s_open.pop_back();
+
+		sample.cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - sample.cpuStart).count();
+		glQueryCounter(frame.queries[sample.query + 1], GL_TIMESTAMP);
+	}
+
+	// Nearest-rank percentile of a sorted array
+	static double percentile(const std::vector<double>& sorted, double p)
+	{
+		size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+		return sorted[std::max<size_t>(rank, 1) - 1];
+	}
+
+	static void print_stats(FILE* fp, const std::vector<double>& values, int count)
+	{
+		std::vector<double> sorted(values.begin(), values.begin() + count);
+		std::sort(sorted.begin(), sorted.end());
+
+		double sum = 0.0;
+		for (int i = 0; i < count; ++i)
+			sum += sorted[i];
+
+		fprintf(fp, " %8.3f %8.3f %8.3f %8.3f", sum / count,
+			percentile(sorted, 50), percentile(sorted, 95), percentile(sorted, 99));
+	}
+
+	void Report(FILE* fp)
+	{
+		if (s_timers.empty())
+			return;
+
+		fprintf(fp, "%-16s %6s | %8s %8s %8s %8s | %8s %8s %8s %8s  (ms, last %d frames)\n",
+			"pass", "calls", "cpu avg", "p50", "p95", "p99", "gpu avg", "p50", "p95", "p99",
+			std::min(s_resolved, WINDOW));
+
+		for (size_t i = 0; i < s_timers.size(); ++i) {
+			const Timer& timer = s_timers[i];
+			if (!timer.frames)
+				continue;
+
+			int count = std::min(timer.frames, WINDOW);
+			fprintf(fp, "%-16s %6d |", timer.name.c_str(), timer.calls);
+			print_stats(fp, timer.cpuMs, count);
+			fprintf(fp, " |");
+			print_stats(fp, timer.gpuMs, count);
+			fprintf(fp, "\n");
+		}
+	}
+}
@@ -0,0 +1,565 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define REFERENCE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include "Reference.hpp"
+
+namespace reference
+{
+	static const int TILE_SIZE = 64;
+
+	// A (clipped) triangle ready for rasterization. Edge-function i is a[i]*x + b[i]*y + c[i],
+	// positive inside; depth is za*x + zb*y + zc.
+	struct Setup
+	{
+		int   id;
+		float a[3], b[3], c[3];
+		bool  topLeft[3];
+		float za, zb, zc;
+		int   minX, minY, maxX, maxY;
+	};
+
+	// Sutherland-Hodgman against one plane (dot(plane, v) >= 0) in clip-space
+	static int clip_polygon(const glm::vec4* in, int count, const glm::vec4& plane, glm::vec4* out)
+	{
+		int outCount = 0;
+		for (int i = 0; i < count; ++i) {
+			const glm::vec4& a = in[i];
+			const glm::vec4& b = in[(i + 1) % count];
+			float da = glm::dot(plane, a);
+			float db = glm::dot(plane, b);
+
+			if (da >= 0.0f)
+				out[outCount++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+				out[outCount++] = a + (b - a) * (da / (da - db));
+		}
+		return outCount;
+	}
+
+	static void setup_triangle(const glm::vec3* v, int id, CullMode cull, int width, int height,
+		std::vector<Setup>& setups)
+	{
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+		if (area == 0.0f)
+			return;
+
+		// Front-faces are clockwise, i.e. negative area with y up
+		bool front = area < 0.0f;
+		if ((cull == CULL_FRONT && front) || (cull == CULL_BACK && !front))
+			return;
+
+		// Make it counter-clockwise, so the inside is where all edge-functions are positive
+		glm::vec3 p[3] = { v[0], front ? v[2] : v[1], front ? v[1] : v[2] };
+		area = std::fabs(area);
+
+		Setup s;
+		s.id = id;
+		s.za = s.zb = s.zc = 0.0f;
+		for (int i = 0; i < 3; ++i) {
+			const glm::vec3& from = p[(i + 1) % 3];
+			const glm::vec3& to   = p[(i + 2) % 3];
+			s.a[i] = -(to.y - from.y);
+			s.b[i] = to.x - from.x;
+			s.c[i] = -(s.a[i] * from.x + s.b[i] * from.y);
+
+			// Pixels exactly on an edge belong to it only if it's a top- or left-edge
+			float ex = to.x - from.x, ey = to.y - from.y;
+			s.topLeft[i] = (ey == 0.0f && ex < 0.0f) || ey < 0.0f;
+
+			s.za += s.a[i] * p[i].z / area;
+			s.zb += s.b[i] * p[i].z / area;
+			s.zc += s.c[i] * p[i].z / area;
+		}
+
+		// Pixels whose centers may be covered
+		float minX = std::min(p[0].x, std::min(p[1].x, p[2].x));
+		float maxX = std::max(p[0].x, std::max(p[1].x, p[2].x));
+		float minY = std::min(p[0].y, std::min(p[1].y, p[2].y));
+		float maxY = std::max(p[0].y, std::max(p[1].y, p[2].y));
+		s.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+		s.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+		s.maxX = std::min(width - 1, (int)std::floor(maxX - 0.5f));
+		s.maxY = std::min(height - 1, (int)std::floor(maxY - 0.5f));
+
+		if (s.minX <= s.maxX && s.minY <= s.maxY)
+			setups.push_back(s);
+	}
+
+	static inline bool inside(const Setup& s, float px, float py)
+	{
+		for (int i = 0; i < 3; ++i) {
+			float e = s.a[i] * px + s.b[i] * py + s.c[i];
+			if (e < 0.0f || (e == 0.0f && !s.topLeft[i]))
+				return false;
+		}
+		return true;
+	}
+
+	static void raster_span(const Setup& s, int x, int xEnd, int y, float* depth, int* ids)
+	{
+		float py = y + 0.5f;
+
+#if REFERENCE_SSE2
+		// Four pixels at a time (only within the span, as the neighbouring tiles may be rasterized concurrently)
+		const __m128 steps = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		const __m128 zero  = _mm_setzero_ps();
+		__m128 a[3], row[3];
+		bool topLeft[3];
+		for (int i = 0; i < 3; ++i) {
+			a[i]   = _mm_set1_ps(s.a[i]);
+			row[i] = _mm_set1_ps(s.b[i] * py + s.c[i]);
+			topLeft[i] = s.topLeft[i];
+		}
+		const __m128 za   = _mm_set1_ps(s.za);
+		const __m128 zRow = _mm_set1_ps(s.zb * py + s.zc);
+
+		for (; x + 3 <= xEnd; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), steps);
+
+			__m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int i = 0; i < 3; ++i) {
+				__m128 e = _mm_add_ps(_mm_mul_ps(a[i], px), row[i]);
+				mask = _mm_and_ps(mask, topLeft[i] ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero));
+			}
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(za, px), zRow);
+			__m128 d = _mm_loadu_ps(depth + x);
+			mask = _mm_and_ps(mask, _mm_cmplt_ps(z, d));
+
+			int bits = _mm_movemask_ps(mask);
+			if (!bits)
+				continue;
+
+			_mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, d)));
+			if (ids) {
+				for (int i = 0; i < 4; ++i) {
+					if (bits & (1 << i))
+						ids[x + i] = s.id;
+				}
+			}
+		}
+#endif
+
+		for (; x <= xEnd; ++x) {
+			float px = x + 0.5f;
+			if (!inside(s, px, py))
+				continue;
+
+			float z = s.za * px + s.zb * py + s.zc;
+			if (z < depth[x]) {
+				depth[x] = z;
+				if (ids)
+					ids[x] = s.id;
+			}
+		}
+	}
+
+	void RasterizeDepth(const std::vector<glm::vec3>& triangles, const glm::mat4& viewProj, CullMode cull,
+		Image& depth, std::vector<int>* ids)
+	{
+		std::fill(depth.data.begin(), depth.data.end(), 1.0f);
+		if (ids)
+			ids->assign(depth.width * depth.height, -1);
+
+		// Clip against the near and far planes, and set up what's left (in window-coordinates)
+		std::vector<Setup> setups;
+		const glm::vec4 planes[2] = { glm::vec4(0, 0, 1, 1), glm::vec4(0, 0, -1, 1) };
+
+		for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+			glm::vec4 polygon[2][5];
+			int count = 3;
+			for (int i = 0; i < 3; ++i)
+				polygon[0][i] = viewProj * glm::vec4(triangles[t + i], 1.0f);
+
+			count = clip_polygon(polygon[0], count, planes[0], polygon[1]);
+			count = clip_polygon(polygon[1], count, planes[1], polygon[0]);
+
+			glm::vec3 window[5];
+			for (int i = 0; i < count; ++i) {
+				glm::vec3 ndc = glm::vec3(polygon[0][i]) / polygon[0][i].w;
+				window[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * depth.width, (ndc.y * 0.5f + 0.5f) * depth.height,
+					ndc.z * 0.5f + 0.5f);
+			}
+
+			for (int i = 1; i + 1 < count; ++i) {
+				glm::vec3 fan[3] = { window[0], window[i], window[i + 1] };
+				setup_triangle(fan, (int)(t / 3), cull, depth.width, depth.height, setups);
+			}
+		}
+
+		int tilesX = (depth.width + TILE_SIZE - 1) / TILE_SIZE;
+		int tilesY = (depth.height + TILE_SIZE - 1) / TILE_SIZE;
+
+		ParallelFor(tilesX * tilesY, [&](int tile) {
+			int x0 = (tile % tilesX) * TILE_SIZE, x1 = std::min(x0 + TILE_SIZE, depth.width) - 1;
+			int y0 = (tile / tilesX) * TILE_SIZE, y1 = std::min(y0 + TILE_SIZE, depth.height) - 1;
+
+			// In submission-order, so equal depths resolve like on the GPU
+			for (size_t i = 0; i < setups.size(); ++i) {
+				const Setup& s = setups[i];
+				if (s.maxX < x0 || s.minX > x1 || s.maxY < y0 || s.minY > y1)
+					continue;
+
+				int xStart = std::max(x0, s.minX), xEnd = std::min(x1, s.maxX);
+				for (int y = std::max(y0, s.minY); y <= std::min(y1, s.maxY); ++y) {
+					raster_span(s, xStart, xEnd, y, &depth.data[y * depth.width],
+						ids ? &(*ids)[y * depth.width] : NULL);
+				}
+			}
+		});
+	}
+
+	glm::vec3 PointOnTriangle(const glm::vec3* triangle, const glm::mat4& inverseViewProj,
+		int width, int height, int x, int y)
+	{
+		// Ray through the pixel-center ...
+		glm::vec2 ndc((x + 0.5f) / width * 2.0f - 1.0f, (y + 0.5f) / height * 2.0f - 1.0f);
+		glm::vec4 nearPoint = inverseViewProj * glm::vec4(ndc, -1.0f, 1.0f);
+		glm::vec4 farPoint  = inverseViewProj * glm::vec4(ndc, 1.0f, 1.0f);
+		glm::dvec3 origin = glm::dvec3(glm::vec3(nearPoint) / nearPoint.w);
+		glm::dvec3 dir    = glm::dvec3(glm::vec3(farPoint) / farPoint.w) - origin;
+
+		// ... intersected with the triangle's plane
+		glm::dvec3 v0(triangle[0]);
+		glm::dvec3 normal = glm::cross(glm::dvec3(triangle[1]) - v0, glm::dvec3(triangle[2]) - v0);
+		double denom = glm::dot(normal, dir);
+		if (denom == 0.0)
+			return glm::vec3(origin);
+
+		double t = glm::dot(normal, v0 - origin) / denom;
+		return glm::vec3(origin + dir * t);
+	}
+
+	void ParallelFor(int count, const std::function<void(int)>& function)
+	{
+		int threadCount = std::min<int>(count, std::max(1u, std::thread::hardware_concurrency()));
+		std::atomic<int> next(0);
+
+		auto work = [&]() {
+			for (int i = next++; i < count; i = next++)
+				function(i);
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 1; i < threadCount; ++i)
+			threads.push_back(std::thread(work));
+		work();
+
+		for (size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	}
+
+	float Fetch(const Image& image, int x, int y, int channel, Wrap wrap, float border)
+	{
+		switch (wrap) {
+		case CLAMP_BORDER:
+			if (x < 0 || y < 0 || x >= image.width || y >= image.height)
+				return border;
+			break;
+		case REPEAT:
+			x = ((x % image.width) + image.width) % image.width;
+			y = ((y % image.height) + image.height) % image.height;
+			break;
+		default:
+			x = std::min(std::max(x, 0), image.width - 1);
+			y = std::min(std::max(y, 0), image.height - 1);
+		}
+		return image.At(x, y)[channel];
+	}
+
+	float SampleLinear(const Image& image, glm::vec2 uv, int channel, Wrap wrap, float border)
+	{
+		float u = uv.x * image.width - 0.5f, v = uv.y * image.height - 0.5f;
+		int x = (int)std::floor(u), y = (int)std::floor(v);
+		float fx = u - x, fy = v - y;
+
+		float bottom = Fetch(image, x, y, channel, wrap, border) * (1 - fx) + Fetch(image, x + 1, y, channel, wrap, border) * fx;
+		float top = Fetch(image, x, y + 1, channel, wrap, border) * (1 - fx) + Fetch(image, x + 1, y + 1, channel, wrap, border) * fx;
+		return bottom * (1 - fy) + top * fy;
+	}
+
+	float SampleCompare(const Image& depth, glm::vec2 uv, float ref, Wrap wrap, float border)
+	{
+		ref = std::min(std::max(ref, 0.0f), 1.0f);
+
+		float u = uv.x * depth.width - 0.5f, v = uv.y * depth.height - 0.5f;
+		int x = (int)std::floor(u), y = (int)std::floor(v);
+		float fx = u - x, fy = v - y;
+
+		float lit[4];
+		for (int i = 0; i < 4; ++i)
+			lit[i] = ref <= Fetch(depth, x + (i & 1), y + (i >> 1), 0, wrap, border) ? 1.0f : 0.0f;
+
+		return (lit[0] * (1 - fx) + lit[1] * fx) * (1 - fy) + (lit[2] * (1 - fx) + lit[3] * fx) * fy;
+	}
+
+	float PCF(const Image& depth, const glm::vec4& sc, int samplingType)
+	{
+		glm::vec4 scPostW = sc / sc.w;
+		if (sc.w <= 0.0f || scPostW.x < 0 || scPostW.y < 0 || scPostW.x >= 1 || scPostW.y >= 1)
+			return 1.0f;
+
+		glm::vec2 uv(scPostW);
+		glm::vec2 texel(1.0f / depth.width, 1.0f / depth.height);
+
+		switch (samplingType) {
+		case 0: {
+			float shadow = SampleLinear(depth, uv, 0, CLAMP_BORDER, 1.0f);
+			return shadow + 0.00001f < scPostW.z ? 0.0f : 1.0f;
+		}
+		case 1:
+			return SampleCompare(depth, uv, scPostW.z, CLAMP_BORDER, 1.0f);
+		case 2: {
+			const glm::vec2 offsets[4] = { glm::vec2(-1, 1), glm::vec2(1, 1), glm::vec2(-1, -1), glm::vec2(1, -1) };
+			float shadow = 0.0f;
+			for (int i = 0; i < 4; ++i)
+				shadow += SampleCompare(depth, uv + offsets[i] * texel, scPostW.z, CLAMP_BORDER, 1.0f);
+			return shadow / 4.0f;
+		}
+		default: {
+			float sum = 0.0f, count = 0.0f;
+			for (int y = -2; y <= 2; ++y) {
+				for (int x = -2; x <= 2; ++x) {
+					sum += SampleCompare(depth, uv + glm::vec2(x, y) * texel, scPostW.z, CLAMP_BORDER, 1.0f);
+					count++;
+				}
+			}
+			return sum / count;
+		}
+		}
+	}
+
+	// dFdx (horizontal) or dFdy: difference within the pixel's 2x2 quad, or toward the other neighbour
+	// when the quad-neighbour is on another triangle (where the GPU would have run a helper-pixel)
+	static float derivative(const Image& depth, const std::vector<int>& ids, int x, int y, bool horizontal)
+	{
+		int id = ids[y * depth.width + x];
+		int pos = horizontal ? x : y, size = horizontal ? depth.width : depth.height;
+		int partners[2] = { pos ^ 1, (pos & 1) ? pos + 1 : pos - 1 };
+
+		for (int i = 0; i < 2; ++i) {
+			int p = partners[i];
+			if (p < 0 || p >= size)
+				continue;
+
+			int px = horizontal ? p : x, py = horizontal ? y : p;
+			if (ids[py * depth.width + px] != id)
+				continue;
+
+			float diff = depth.At(px, py)[0] - depth.At(x, y)[0];
+			return p > pos ? diff : -diff;
+		}
+
+		return 0.0f;
+	}
+
+	Image Moments(const Image& depth, const std::vector<int>& ids)
+	{
+		Image moments(depth.width, depth.height, 2, 1.0f);
+
+		for (int y = 0; y < depth.height; ++y) {
+			for (int x = 0; x < depth.width; ++x) {
+				if (ids[y * depth.width + x] < 0)
+					continue;
+
+				float d = depth.At(x, y)[0];
+				float dx = derivative(depth, ids, x, y, true);
+				float dy = derivative(depth, ids, x, y, false);
+
+				float* m = moments.At(x, y);
+				m[0] = d;
+				m[1] = d * d + 0.25f * (dx * dx + dy * dy);
+			}
+		}
+
+		return moments;
+	}
+
+	float ChebyshevUpperBound(glm::vec2 moments, float distance)
+	{
+		// Surface is fully lit, as the current fragment is before the light occluder
+		if (distance <= moments.x)
+			return 1.0f;
+
+		float variance = moments.y - moments.x * moments.x;
+		variance = std::max(variance, 0.00002f);
+
+		float d = distance - moments.x;
+		return variance / (variance + d * d);
+	}
+
+	float VSM(const Image& moments, const glm::vec4& sc)
+	{
+		glm::vec4 scPostW = sc / sc.w * 0.5f + 0.5f;
+		if (sc.w <= 0.0f || scPostW.x < 0 || scPostW.y < 0 || scPostW.x >= 1 || scPostW.y >= 1)
+			return 1.0f;
+
+		glm::vec2 uv(scPostW);
+		glm::vec2 m(SampleLinear(moments, uv, 0, REPEAT), SampleLinear(moments, uv, 1, REPEAT));
+		return ChebyshevUpperBound(m, scPostW.z);
+	}
+
+	// One direction of blurFragmentShader.glsl
+	static Image blur_pass(const Image& src, const blur::Kernel& kernel, glm::vec2 scale, Wrap wrap)
+	{
+		Image dst(src.width, src.height, src.channels);
+
+		ParallelFor(src.height, [&](int y) {
+			for (int x = 0; x < src.width; ++x) {
+				glm::vec2 uv((x + 0.5f) / src.width, (y + 0.5f) / src.height);
+
+				for (int c = 0; c < src.channels; ++c) {
+					float sum = SampleLinear(src, uv, c, wrap) * kernel.weights[0];
+					for (int i = 1; i < kernel.taps; ++i) {
+						glm::vec2 offset = kernel.offsets[i] * scale;
+						sum += SampleLinear(src, uv + offset, c, wrap) * kernel.weights[i];
+						sum += SampleLinear(src, uv - offset, c, wrap) * kernel.weights[i];
+					}
+					dst.At(x, y)[c] = sum;
+				}
+			}
+		});
+
+		return dst;
+	}
+
+	Image Blur(const Image& src, const blur::Kernel& kernel, Wrap wrap)
+	{
+		// The scratch-texture between the passes has GL_CLAMP_TO_EDGE
+		Image horizontal = blur_pass(src, kernel, glm::vec2(1.0f / src.width, 0.0f), wrap);
+		return blur_pass(horizontal, kernel, glm::vec2(0.0f, 1.0f / src.height), CLAMP_EDGE);
+	}
+
+	int CubeFace(const glm::vec3& dir, glm::vec2& uv)
+	{
+		glm::vec3 a = glm::abs(dir);
+		int face;
+		float sc, tc, ma;
+
+		if (a.x >= a.y && a.x >= a.z) {
+			face = dir.x > 0 ? 0 : 1;
+			sc = dir.x > 0 ? -dir.z : dir.z;
+			tc = -dir.y;
+			ma = a.x;
+		}
+		else if (a.y >= a.z) {
+			face = dir.y > 0 ? 2 : 3;
+			sc = dir.x;
+			tc = dir.y > 0 ? dir.z : -dir.z;
+			ma = a.y;
+		}
+		else {
+			face = dir.z > 0 ? 4 : 5;
+			sc = dir.z > 0 ? dir.x : -dir.x;
+			tc = -dir.y;
+			ma = a.z;
+		}
+
+		uv = glm::vec2(sc / ma + 1.0f, tc / ma + 1.0f) * 0.5f;
+		return face;
+	}
+
+	float SampleCube(const CubeMap& cube, const glm::vec3& dir, int channel)
+	{
+		glm::vec2 uv;
+		int face = CubeFace(dir, uv);
+		return SampleLinear(cube.faces[face], uv, channel, CLAMP_EDGE);
+	}
+
+	float CubeVSM(const CubeMap& moments, const glm::vec3& dir, float distance)
+	{
+		glm::vec2 m(SampleCube(moments, dir, 0), SampleCube(moments, dir, 1));
+		return ChebyshevUpperBound(m, distance / 20.0f);
+	}
+
+	bool WritePGM(const std::string& file, const Image& image, int channel)
+	{
+		FILE* fp = fopen(file.c_str(), "wb");
+		if (!fp) {
+			fprintf(stderr, "Couldn't open '%s' for writing\n", file.c_str());
+			return false;
+		}
+
+		fprintf(fp, "P5\n%d %d\n255\n", image.width, image.height);
+		std::vector<unsigned char> row(image.width);
+		for (int y = image.height - 1; y >= 0; --y) {
+			for (int x = 0; x < image.width; ++x) {
+				float v = std::min(std::max(image.At(x, y)[channel], 0.0f), 1.0f);
+				row[x] = (unsigned char)(v * 255.0f + 0.5f);
+			}
+			fwrite(&row[0], 1, row.size(), fp);
+		}
+		fclose(fp);
+
+		return true;
+	}
+
+	bool ReadPNM(const std::string& file, Image& image)
+	{
+		FILE* fp = fopen(file.c_str(), "rb");
+		if (!fp) {
+			fprintf(stderr, "Couldn't open '%s'\n", file.c_str());
+			return false;
+		}
+
+		char magic[3] = { 0 };
+		int width = 0, height = 0, maxValue = 0;
+		if (fscanf(fp, "%2s %d %d %d", magic, &width, &height, &maxValue) != 4 || maxValue != 255 ||
+			(std::string(magic) != "P5" && std::string(magic) != "P6")) {
+			fprintf(stderr, "'%s' isn't a binary 8-bit PGM/PPM\n", file.c_str());
+			fclose(fp);
+			return false;
+		}
+		fgetc(fp); // Single whitespace before the pixels
+
+		int channels = magic[1] == '5' ? 1 : 3;
+		std::vector<unsigned char> row(width * channels);
+		image = Image(width, height, 1);
+
+		for (int y = height - 1; y >= 0; --y) {
+			if (fread(&row[0], 1, row.size(), fp) != row.size()) {
+				fprintf(stderr, "'%s' is truncated\n", file.c_str());
+				fclose(fp);
+				return false;
+			}
+			for (int x = 0; x < width; ++x)
+				image.At(x, y)[0] = row[x * channels] / 255.0f;
+		}
+		fclose(fp);
+
+		return true;
+	}
+
+	Difference Compare(const Image& reference, const Image& image, float tolerance)
+	{
+		Difference diff = { 0, 0, 0.0, 0.0 };
+
+		for (int y = 0; y < reference.height; ++y) {
+			for (int x = 0; x < reference.width; ++x) {
+				float expected = reference.At(x, y)[0];
+				if (expected < 0.0f)
+					continue;
+
+				double error = std::fabs(expected - image.At(x, y)[0]);
+				diff.pixels++;
+				diff.meanError += error;
+				diff.maxError = std::max(diff.maxError, error);
+				if (error > tolerance)
+					diff.mismatches++;
+			}
+		}
+
+		if (diff.pixels)
+			diff.meanError /= diff.pixels;
+
+		return diff;
+	}
+}
@@ -0,0 +1,227 @@
+#include "ReferenceScenes.hpp"
+#include "Common.hpp"
+#include "Blur.hpp"
+
+namespace reference
+{
+	namespace
+	{
+		glm::mat4 camera_proj(const SceneSettings& settings)
+		{
+			return glm::perspective(45.0f, (float)settings.width / (float)settings.height, 0.1f, 100.0f);
+		}
+
+		glm::mat4 translate_scale(const glm::vec3& pos, const glm::vec3& scale)
+		{
+			return glm::scale(glm::translate(glm::mat4(), pos), scale);
+		}
+
+		// pcf/main.cpp
+		Scene pcf_scene(const SceneSettings& settings)
+		{
+			glm::vec3 cubePos(0.0, 0.0, -5.0);
+			glm::vec3 planePos(1, -1, -6);
+			glm::vec3 planeScale(7, 1, 7);
+
+			Scene scene;
+			scene.lightPos    = glm::vec3(-2.0, 2.0, -2);
+			scene.lightTarget = cubePos;
+
+			append_cube_positions(scene.casters, glm::translate(glm::mat4(), cubePos));
+			append_cube_positions(scene.casters, translate_scale(planePos, planeScale));
+
+			scene.visible = scene.casters;
+			append_cube_positions(scene.visible, translate_scale(scene.lightPos, glm::vec3(0.1f)));
+
+			glm::mat4 view = glm::lookAt(glm::vec3(0, 5, 0), glm::vec3(0, 0, -5), glm::vec3(0, 1, 0));
+			scene.viewProj = camera_proj(settings) * view;
+			return scene;
+		}
+
+		Image render_pcf(const SceneSettings& settings)
+		{
+			Scene scene = pcf_scene(settings);
+
+			glm::mat4 light = glm::perspective(60.0f, 1.0f, 1.0f, 10.0f) * glm::lookAt(scene.lightPos, scene.lightTarget, glm::vec3(0, 1, 0));
+			glm::mat4 bias = glm::translate(glm::mat4(), glm::vec3(0.5f)) * glm::scale(glm::mat4(), glm::vec3(0.5f));
+			glm::mat4 shadowMatrix = bias * light;
+
+			Image shadowMap(settings.shadowMapSize, settings.shadowMapSize, 1);
+			RasterizeDepth(scene.casters, light, CULL_FRONT, shadowMap);
+
+			return CameraPass(settings.width, settings.height, scene.visible, scene.viewProj, [&](const glm::vec3& world) {
+				return PCF(shadowMap, shadowMatrix * glm::vec4(world, 1.0f), settings.samplingType);
+			});
+		}
+
+		// vsm/main.cpp (without cascades)
+		Scene vsm_scene(const SceneSettings& settings)
+		{
+			glm::vec3 cubePos(0.0, 0, -5.0);
+			glm::vec3 groundPos(1, -1, -6);
+			glm::vec3 groundScale(7, 1, 7);
+			glm::vec3 cameraPos(0, 4, 0);
+
+			Scene scene;
+			scene.lightPos    = glm::vec3(-2, 2.0, -2);
+			scene.lightTarget = cubePos;
+
+			append_cube_positions(scene.casters, glm::translate(glm::mat4(), cubePos));
+			append_cube_positions(scene.casters, translate_scale(groundPos, groundScale));
+
+			scene.visible = scene.casters;
+			append_cube_positions(scene.visible, translate_scale(scene.lightPos, glm::vec3(0.1f)));
+
+			glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0, 0, -5), glm::vec3(0, 1, 0));
+			scene.viewProj = camera_proj(settings) * view;
+			return scene;
+		}
+
+		Image render_vsm(const SceneSettings& settings)
+		{
+			Scene scene = vsm_scene(settings);
+
+			glm::mat4 light = glm::perspective(45.0f, 1.0f, 2.0f, 100.0f) * glm::lookAt(scene.lightPos, scene.lightTarget, glm::vec3(0, 1, 0));
+
+			Image depth(settings.shadowMapSize, settings.shadowMapSize, 1);
+			std::vector<int> ids;
+			RasterizeDepth(scene.casters, light, CULL_BACK, depth, &ids);
+
+			// The moments-texture has the default GL_REPEAT
+			int radius = settings.blurRadius < 0 ? 6 : settings.blurRadius;
+			Image moments = Blur(Moments(depth, ids), blur::GaussianKernel(radius), REPEAT);
+
+			return CameraPass(settings.width, settings.height, scene.visible, scene.viewProj, [&](const glm::vec3& world) {
+				return VSM(moments, light * glm::vec4(world, 1.0f));
+			});
+		}
+
+		// vsmcube/main.cpp
+		glm::mat4 shadow_view_matrix(const glm::vec3& lightPos, int dir)
+		{
+			switch (dir) {
+			case 0:  return glm::lookAt(lightPos, lightPos + glm::vec3(+1, +0, 0), glm::vec3(0, -1, 0));
+			case 1:  return glm::lookAt(lightPos, lightPos + glm::vec3(-1, +0, 0), glm::vec3(0, -1, 0));
+			case 2:  return glm::lookAt(lightPos, lightPos + glm::vec3(0, +1, 0), glm::vec3(0, 0, -1));
+			case 3:  return glm::lookAt(lightPos, lightPos + glm::vec3(0, -1, 0), glm::vec3(0, 0, -1));
+			case 4:  return glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, +1), glm::vec3(0, -1, 0));
+			default: return glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, -1), glm::vec3(0, -1, 0));
+			}
+		}
+
+		Scene vsmcube_scene(const SceneSettings& settings)
+		{
+			glm::vec3 cubePos(-0.0, 0, -5.0);
+			glm::vec3 cubePos2(+3.0, -0.5, -5.0);
+			glm::vec3 cubePos3(0.0, 0, -8.0);
+			glm::vec3 groundPos(1, -1, -6);
+			glm::vec3 cameraPos(0, 4, 0);
+			glm::vec3 groundScale(17, 1, 17);
+
+			// Where the light is in the frame (headless runs step time by 1/60s)
+			glm::mat4 mat = glm::translate(glm::mat4(1.0f), glm::vec3(0, 2, -5));
+			mat *= glm::rotate(glm::mat4(), (float)(settings.frame / 60.0) * 50.0f, glm::vec3(0, 1, 0));
+
+			Scene scene;
+			scene.lightPos    = glm::vec3(mat * glm::vec4(glm::vec3(2, 0, 0), 1.0));
+			scene.lightTarget = scene.lightPos;
+
+			append_cube_positions(scene.casters, glm::translate(glm::mat4(), cubePos));
+			append_cube_positions(scene.casters, glm::translate(glm::mat4(), cubePos2));
+			append_cube_positions(scene.casters, glm::translate(glm::mat4(), cubePos3));
+			append_cube_positions(scene.casters, translate_scale(groundPos, groundScale));
+
+			scene.visible = scene.casters;
+			append_cube_positions(scene.visible, translate_scale(scene.lightPos, glm::vec3(0.1f)));
+
+			glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0, 0, -5), glm::vec3(0, 1, 0));
+			scene.viewProj = camera_proj(settings) * view;
+			return scene;
+		}
+
+		Image render_vsmcube(const SceneSettings& settings)
+		{
+			Scene scene = vsmcube_scene(settings);
+			const glm::vec3& lightPos = scene.lightPos;
+
+			// Each face: distance to the light (/20) as moments, blurred within the face
+			CubeMap moments;
+			blur::Kernel kernel = blur::GaussianKernel(settings.blurRadius < 0 ? 3 : settings.blurRadius);
+			for (int face = 0; face < 6; ++face) {
+				glm::mat4 faceMatrix = glm::perspective(90.0f, 1.0f, 0.5f, 100.0f) * shadow_view_matrix(lightPos, face);
+				glm::mat4 inverseFaceMatrix = glm::inverse(faceMatrix);
+
+				Image depth(settings.shadowMapSize, settings.shadowMapSize, 1);
+				std::vector<int> ids;
+				RasterizeDepth(scene.casters, faceMatrix, CULL_BACK, depth, &ids);
+
+				ParallelFor(depth.height, [&](int y) {
+					for (int x = 0; x < depth.width; ++x) {
+						int id = ids[y * depth.width + x];
+						if (id >= 0) {
+							glm::vec3 world = PointOnTriangle(&scene.casters[id * 3], inverseFaceMatrix, depth.width, depth.height, x, y);
+							depth.At(x, y)[0] = glm::length(world - lightPos) / 20.0f;
+						}
+					}
+				});
+
+				moments.faces[face] = Blur(Moments(depth, ids), kernel, CLAMP_EDGE);
+			}
+
+			return CameraPass(settings.width, settings.height, scene.visible, scene.viewProj, [&](const glm::vec3& world) {
+				glm::vec3 lightToFragment = world - lightPos;
+				return CubeVSM(moments, glm::normalize(lightToFragment), glm::length(lightToFragment));
+			});
+		}
+	}
+
+	bool GetScene(const SceneSettings& settings, Scene& scene)
+	{
+		if (settings.technique == "pcf")
+			scene = pcf_scene(settings);
+		else if (settings.technique == "vsm")
+			scene = vsm_scene(settings);
+		else if (settings.technique == "vsmcube")
+			scene = vsmcube_scene(settings);
+		else
+			return false;
+		return true;
+	}
+
+	bool RenderScene(const SceneSettings& settings, Image& factors)
+	{
+		if (settings.technique == "pcf")
+			factors = render_pcf(settings);
+		else if (settings.technique == "vsm")
+			factors = render_vsm(settings);
+		else if (settings.technique == "vsmcube")
+			factors = render_vsmcube(settings);
+		else
+			return false;
+		return true;
+	}
+
+	Image CameraPass(int width, int height, const std::vector<glm::vec3>& triangles, const glm::mat4& viewProj,
+		const std::function<float(const glm::vec3&)>& shadowFactor)
+	{
+		Image depth(width, height, 1);
+		std::vector<int> ids;
+		RasterizeDepth(triangles, viewProj, CULL_BACK, depth, &ids);
+
+		Image factors(width, height, 1, -1.0f);
+		glm::mat4 inverseViewProj = glm::inverse(viewProj);
+
+		ParallelFor(height, [&](int y) {
+			for (int x = 0; x < width; ++x) {
+				int id = ids[y * width + x];
+				if (id < 0)
+					continue;
+
+				glm::vec3 world = PointOnTriangle(&triangles[id * 3], inverseViewProj, width, height, x, y);
+				factors.At(x, y)[0] = shadowFactor(world);
+			}
+		});
+
+		return factors;
+	}
+}
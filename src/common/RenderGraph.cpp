@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <queue>
+
+#include "RenderGraph.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+
+namespace rendergraph
+{
+	Context::Context(const Graph& graph)
+		: m_graph(graph)
+	{
+	}
+
+	GLuint Context::GetTexture(Resource resource) const
+	{
+		const Graph::ResourceInfo& info = m_graph.m_resources[resource];
+		return info.imported ? info.texture : m_graph.m_leases[resource].GetTexture();
+	}
+
+	GLuint Context::GetDepthTexture(Resource resource) const
+	{
+		const Graph::ResourceInfo& info = m_graph.m_resources[resource];
+		return info.imported ? info.depthTexture : m_graph.m_leases[resource].GetDepthTexture();
+	}
+
+	GLuint Context::GetFramebuffer(Resource resource) const
+	{
+		const Graph::ResourceInfo& info = m_graph.m_resources[resource];
+		return info.imported ? info.framebuffer : m_graph.m_leases[resource].GetFramebuffer();
+	}
+
+	Pass::Pass(const std::string& name, const Function& function)
+		: m_name(name), m_function(function), m_target(-1)
+	{
+	}
+
+	Pass& Pass::Read(Resource resource)
+	{
+		m_reads.push_back(resource);
+		return *this;
+	}
+
+	Pass& Pass::Write(Resource resource)
+	{
+		m_writes.push_back(resource);
+		return *this;
+	}
+
+	Pass& Pass::RenderTo(Resource resource)
+	{
+		m_target = resource;
+		return Write(resource);
+	}
+
+	bool Pass::reads(Resource resource) const
+	{
+		return std::find(m_reads.begin(), m_reads.end(), resource) != m_reads.end();
+	}
+
+	bool Pass::writes(Resource resource) const
+	{
+		return std::find(m_writes.begin(), m_writes.end(), resource) != m_writes.end();
+	}
+
+	Graph::Graph()
+		: m_aliasedMemory(0)
+	{
+	}
+
+	Graph::~Graph()
+	{
+	}
+
+	Resource Graph::Import(const std::string& name, GLuint texture, GLuint depthTexture, GLuint framebuffer, GLsizei width, GLsizei height)
+	{
+		ResourceInfo info;
+		info.name         = name;
+		info.imported     = true;
+		info.desc         = rendertarget::Desc::Color(0, width, height);
+		info.texture      = texture;
+		info.depthTexture = depthTexture;
+		info.framebuffer  = framebuffer;
+		info.width        = width;
+		info.height       = height;
+		info.first = info.last = -1;
+		m_resources.push_back(info);
+		m_leases.resize(m_resources.size());
+		return (Resource) m_resources.size() - 1;
+	}
+
+	Resource Graph::Create(const std::string& name, const rendertarget::Desc& desc)
+	{
+		ResourceInfo info;
+		info.name     = name;
+		info.imported = false;
+		info.desc     = desc;
+		info.texture  = info.depthTexture = info.framebuffer = 0;
+		info.width    = desc.width;
+		info.height   = desc.height;
+		info.first = info.last = -1;
+		m_resources.push_back(info);
+		m_leases.resize(m_resources.size());
+		return (Resource) m_resources.size() - 1;
+	}
+
+	Pass& Graph::AddPass(const std::string& name, const Function& function)
+	{
+		m_passes.push_back(Pass(name, function));
+		return m_passes.back();
+	}
+
+	bool Graph::Compile()
+	{
+		int passCount     = (int) m_passes.size();
+		int resourceCount = (int) m_resources.size();
+
+		// Kept: the passes writing an imported resource, and (transitively) the writers of what they read
+		std::vector<bool> kept(passCount, false);
+		std::vector<int> pending;
+		for (int p = 0; p < passCount; ++p) {
+			for (size_t w = 0; w < m_passes[p].m_writes.size() && !kept[p]; ++w)
+				kept[p] = m_resources[m_passes[p].m_writes[w]].imported;
+			if (kept[p])
+				pending.push_back(p);
+		}
+		while (!pending.empty()) {
+			const Pass& pass = m_passes[pending.back()];
+			pending.pop_back();
+			for (size_t r = 0; r < pass.m_reads.size(); ++r) {
+				for (int p = 0; p < passCount; ++p) {
+					if (!kept[p] && m_passes[p].writes(pass.m_reads[r])) {
+						kept[p] = true;
+						pending.push_back(p);
+					}
+				}
+			}
+		}
+
+		// Dependencies between the kept passes: a resource's writers in the order they were added,
+		// then the passes only reading it
+		std::vector<std::vector<int> > next(passCount);
+		std::vector<int> incoming(passCount, 0);
+		for (Resource r = 0; r < resourceCount; ++r) {
+			int lastWriter = -1;
+			for (int p = 0; p < passCount; ++p) {
+				if (!kept[p] || !m_passes[p].writes(r))
+					continue;
+				if (lastWriter >= 0) {
+					next[lastWriter].push_back(p);
+					++incoming[p];
+				}
+				lastWriter = p;
+			}
+			for (int p = 0; p < passCount && lastWriter >= 0; ++p) {
+				if (kept[p] && m_passes[p].reads(r) && !m_passes[p].writes(r)) {
+					next[lastWriter].push_back(p);
+					++incoming[p];
+				}
+			}
+		}
+
+		// Ordered with the earliest added of the passes ready first
+		std::priority_queue<int, std::vector<int>, std::greater<int> > ready;
+		int keptCount = 0;
+		for (int p = 0; p < passCount; ++p) {
+			if (kept[p]) {
+				++keptCount;
+				if (incoming[p] == 0)
+					ready.push(p);
+			}
+		}
+		m_order.clear();
+		while (!ready.empty()) {
+			int p = ready.top();
+			ready.pop();
+			m_order.push_back(p);
+			for (size_t n = 0; n < next[p].size(); ++n) {
+				if (--incoming[next[p][n]] == 0)
+					ready.push(next[p][n]);
+			}
+		}
+		if ((int) m_order.size() != keptCount) {
+			for (int p = 0; p < passCount; ++p) {
+				if (kept[p] && incoming[p] > 0) {
+					printf("ERROR: Render-graph passes depend on each other in a cycle (through '%s')\n", m_passes[p].m_name.c_str());
+					break;
+				}
+			}
+			m_order.clear();
+			return false;
+		}
+
+		// Lifetimes
+		for (Resource r = 0; r < resourceCount; ++r)
+			m_resources[r].first = m_resources[r].last = -1;
+		for (int i = 0; i < (int) m_order.size(); ++i) {
+			const Pass& pass = m_passes[m_order[i]];
+			for (int list = 0; list < 2; ++list) {
+				const std::vector<Resource>& used = list == 0 ? pass.m_reads : pass.m_writes;
+				for (size_t u = 0; u < used.size(); ++u) {
+					ResourceInfo& info = m_resources[used[u]];
+					if (info.first < 0)
+						info.first = i;
+					info.last = i;
+				}
+			}
+		}
+
+		// What the pool will hold at most: of each kind of target, as many as are alive at once
+		m_aliasedMemory = 0;
+		std::vector<bool> counted(resourceCount, false);
+		for (Resource r = 0; r < resourceCount; ++r) {
+			const ResourceInfo& info = m_resources[r];
+			if (info.imported || info.first < 0 || counted[r])
+				continue;
+
+			int mostAlive = 0;
+			for (int i = 0; i < (int) m_order.size(); ++i) {
+				int alive = 0;
+				for (Resource s = r; s < resourceCount; ++s) {
+					const ResourceInfo& other = m_resources[s];
+					if (!other.imported && other.first >= 0 && other.desc == info.desc) {
+						counted[s] = true;
+						if (other.first <= i && i <= other.last)
+							++alive;
+					}
+				}
+				mostAlive = std::max(mostAlive, alive);
+			}
+			m_aliasedMemory += mostAlive * info.desc.MemorySize();
+		}
+
+		return true;
+	}
+
+	void Graph::Execute()
+	{
+		Context context(*this);
+
+		for (int i = 0; i < (int) m_order.size(); ++i) {
+			const Pass& pass = m_passes[m_order[i]];
+			profiler::Scope scope(pass.m_name.c_str());
+
+			for (Resource r = 0; r < (Resource) m_resources.size(); ++r) {
+				if (!m_resources[r].imported && m_resources[r].first == i)
+					m_leases[r] = rendertarget::Scratch().Acquire(m_resources[r].desc);
+			}
+
+			// Consecutive passes rendering to the same target bind it once (glstate filters the repeats)
+			if (pass.m_target >= 0) {
+				const ResourceInfo& info = m_resources[pass.m_target];
+				glstate::BindFramebuffer(GL_FRAMEBUFFER, context.GetFramebuffer(pass.m_target));
+				glstate::Viewport(0, 0, info.width, info.height);
+			}
+
+			pass.m_function(context);
+
+			for (Resource r = 0; r < (Resource) m_resources.size(); ++r) {
+				if (!m_resources[r].imported && m_resources[r].last == i)
+					m_leases[r].Release();
+			}
+		}
+	}
+
+	void Graph::Clear()
+	{
+		m_resources.clear();
+		m_leases.clear();
+		m_passes.clear();
+		m_order.clear();
+		m_aliasedMemory = 0;
+	}
+
+	int Graph::GetPassCount() const
+	{
+		return (int) m_order.size();
+	}
+
+	int Graph::GetCulledCount() const
+	{
+		return (int) (m_passes.size() - m_order.size());
+	}
+
+	size_t Graph::TransientMemorySize() const
+	{
+		size_t bytes = 0;
+		for (size_t r = 0; r < m_resources.size(); ++r) {
+			if (!m_resources[r].imported && m_resources[r].first >= 0)
+				bytes += m_resources[r].desc.MemorySize();
+		}
+		return bytes;
+	}
+
+	size_t Graph::AliasedMemorySize() const
+	{
+		return m_aliasedMemory;
+	}
+
+	void Graph::Print() const
+	{
+		printf("Render-graph:");
+		for (size_t i = 0; i < m_order.size(); ++i)
+			printf("%s %s", i > 0 ? " ->" : "", m_passes[m_order[i]].m_name.c_str());
+		printf(" (%d culled)\n", GetCulledCount());
+
+		if (TransientMemorySize() > 0) {
+			printf("Render-graph transients: %.2f MB, aliased into %.2f MB\n",
+				TransientMemorySize() / (1024.0 * 1024.0), AliasedMemorySize() / (1024.0 * 1024.0));
+		}
+	}
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "RenderTargets.hpp"
+#include "Common.hpp"
+
+namespace rendertarget
+{
+	namespace
+	{
+		// Format of the pixels given for an internal format (none are, but glTexImage* needs one)
+		GLenum pixel_format(GLint internalformat)
+		{
+			switch (internalformat) {
+			case GL_DEPTH_COMPONENT:
+			case GL_DEPTH_COMPONENT16:
+			case GL_DEPTH_COMPONENT24:
+			case GL_DEPTH_COMPONENT32:
+			case GL_DEPTH_COMPONENT32F: return GL_DEPTH_COMPONENT;
+			case GL_RED:
+			case GL_R8:
+			case GL_R16F:
+			case GL_R32F:               return GL_RED;
+			case GL_RG:
+			case GL_RG8:
+			case GL_RG16F:
+			case GL_RG32F:              return GL_RG;
+			case GL_RGB:
+			case GL_RGB8:
+			case GL_RGB16F:
+			case GL_RGB32F:             return GL_RGB;
+			}
+			return GL_RGBA;
+		}
+
+		GLuint create_texture(GLint internalformat, const Desc& desc)
+		{
+			if (internalformat == 0)
+				return 0;
+
+			GLenum format = pixel_format(internalformat);
+			if (desc.layers > 1)
+				return texture::Create2DArray(internalformat, desc.width, desc.height, desc.layers, format, GL_FLOAT);
+
+			GLuint tex = texture::Create2D(internalformat, desc.width, desc.height, format, GL_FLOAT);
+			texture::SetWrapMode2D(tex, texture::WrapMode::ClampEdge);
+			return tex;
+		}
+
+		GLuint create_framebuffer(const Target& target)
+		{
+			int color = target.color.Get() ? (int) target.color.Get() : -1;
+			int depth = target.depth.Get() ? (int) target.depth.Get() : -1;
+			if (target.desc.layers > 1)
+				return texture::FramebufferLayer(color, depth, -1);
+			return texture::Framebuffer(color, depth);
+		}
+	}
+
+	Desc Desc::Color(GLint format, GLsizei width, GLsizei height, GLsizei layers)
+	{
+		return ColorDepth(format, 0, width, height, layers);
+	}
+
+	Desc Desc::ColorDepth(GLint colorFormat, GLint depthFormat, GLsizei width, GLsizei height, GLsizei layers)
+	{
+		Desc desc = { colorFormat, depthFormat, width, height, layers };
+		return desc;
+	}
+
+	bool Desc::operator==(const Desc& other) const
+	{
+		return colorFormat == other.colorFormat && depthFormat == other.depthFormat &&
+			width == other.width && height == other.height && layers == other.layers;
+	}
+
+	size_t Desc::MemorySize() const
+	{
+		size_t bytes = 0;
+		if (colorFormat != 0)
+			bytes += texture::MemorySize(colorFormat, width, height, layers);
+		if (depthFormat != 0)
+			bytes += texture::MemorySize(depthFormat, width, height, layers);
+		return bytes;
+	}
+
+	Lease::Lease()
+		: m_pool(0), m_target(0)
+	{
+	}
+
+	Lease::Lease(Pool* pool, Target* target)
+		: m_pool(pool), m_target(target)
+	{
+	}
+
+	Lease::~Lease()
+	{
+		Release();
+	}
+
+	Lease::Lease(Lease&& other)
+		: m_pool(other.m_pool), m_target(other.m_target)
+	{
+		other.m_pool   = 0;
+		other.m_target = 0;
+	}
+
+	Lease& Lease::operator=(Lease&& other)
+	{
+		if (this != &other) {
+			Release();
+			m_pool   = other.m_pool;
+			m_target = other.m_target;
+			other.m_pool   = 0;
+			other.m_target = 0;
+		}
+		return *this;
+	}
+
+	bool Lease::IsValid() const
+	{
+		return m_target != 0;
+	}
+
+	GLuint Lease::GetTexture() const
+	{
+		return m_target ? m_target->color.Get() : 0;
+	}
+
+	GLuint Lease::GetDepthTexture() const
+	{
+		return m_target ? m_target->depth.Get() : 0;
+	}
+
+	GLuint Lease::GetFramebuffer() const
+	{
+		return m_target ? m_target->framebuffer.Get() : 0;
+	}
+
+	void Lease::Release()
+	{
+		if (m_target)
+			m_pool->GiveBack(m_target);
+		m_pool   = 0;
+		m_target = 0;
+	}
+
+	Pool::Pool()
+		: m_inUse(0), m_peakInUse(0), m_memory(0), m_peakMemory(0)
+	{
+	}
+
+	Pool::~Pool()
+	{
+	}
+
+	Lease Pool::Acquire(const Desc& desc)
+	{
+		Target* target = 0;
+		for (size_t i = 0; i < m_targets.size() && !target; ++i) {
+			if (!m_targets[i]->inUse && m_targets[i]->desc == desc)
+				target = m_targets[i].get();
+		}
+
+		if (!target) {
+			m_targets.push_back(std::unique_ptr<Target>(new Target()));
+			target = m_targets.back().get();
+			target->desc = desc;
+			target->color.Reset(create_texture(desc.colorFormat, desc));
+			target->depth.Reset(create_texture(desc.depthFormat, desc));
+			target->framebuffer.Reset(create_framebuffer(*target));
+
+			m_memory += desc.MemorySize();
+			m_peakMemory = std::max(m_peakMemory, m_memory);
+		}
+
+		target->inUse = true;
+		target->idleFrames = 0;
+		m_peakInUse = std::max(m_peakInUse, ++m_inUse);
+
+		return Lease(this, target);
+	}
+
+	void Pool::GiveBack(Target* target)
+	{
+		target->inUse = false;
+		--m_inUse;
+	}
+
+	void Pool::EndFrame()
+	{
+		for (size_t i = 0; i < m_targets.size(); ) {
+			Target& target = *m_targets[i];
+			if (!target.inUse && ++target.idleFrames > KEEP_FRAMES) {
+				m_memory -= target.desc.MemorySize();
+				m_targets.erase(m_targets.begin() + i);
+			}
+			else
+				++i;
+		}
+	}
+
+	void Pool::Delete()
+	{
+		// Those acquired stay until their leases give them back
+		for (size_t i = 0; i < m_targets.size(); ) {
+			Target& target = *m_targets[i];
+			if (target.inUse) {
+				printf("ERROR: Render-target still acquired when deleting its pool\n");
+				target.framebuffer.Reset();
+				target.color.Reset();
+				target.depth.Reset();
+				++i;
+			}
+			else
+				m_targets.erase(m_targets.begin() + i);
+		}
+		m_memory = 0;
+	}
+
+	int Pool::GetCount() const
+	{
+		return (int) m_targets.size();
+	}
+
+	int Pool::GetPeakInUse() const
+	{
+		return m_peakInUse;
+	}
+
+	size_t Pool::MemorySize() const
+	{
+		return m_memory;
+	}
+
+	size_t Pool::PeakMemorySize() const
+	{
+		return m_peakMemory;
+	}
+
+	Pool& Scratch()
+	{
+		static Pool pool;
+		return pool;
+	}
+}
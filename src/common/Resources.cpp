@@ -0,0 +1,58 @@
+#include "Resources.hpp"
+#include "GLState.hpp"
+
+namespace resource
+{
+	void DeleteTexture(GLuint name)
+	{
+		glstate::DeleteTextures(1, &name);
+	}
+
+	void DeleteFramebuffer(GLuint name)
+	{
+		glstate::DeleteFramebuffers(1, &name);
+	}
+
+	void DeleteBuffer(GLuint name)
+	{
+		glDeleteBuffers(1, &name);
+	}
+
+	void DeleteVertexArray(GLuint name)
+	{
+		glDeleteVertexArrays(1, &name);
+	}
+
+	void DeleteProgram(GLuint name)
+	{
+		glstate::DeleteProgram(name);
+	}
+
+	Texture GenTexture()
+	{
+		GLuint name;
+		glGenTextures(1, &name);
+		return Texture(name);
+	}
+
+	Framebuffer GenFramebuffer()
+	{
+		GLuint name;
+		glGenFramebuffers(1, &name);
+		return Framebuffer(name);
+	}
+
+	Buffer GenBuffer()
+	{
+		GLuint name;
+		glGenBuffers(1, &name);
+		return Buffer(name);
+	}
+
+	VertexArray GenVertexArray()
+	{
+		GLuint name;
+		glGenVertexArrays(1, &name);
+		return VertexArray(name);
+	}
+}
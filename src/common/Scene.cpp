@@ -0,0 +1,444 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Scene.hpp"
+#include "OpenGL.hpp"
+
+namespace scene
+{
+	namespace
+	{
+		uint64_t align(uint64_t offset)
+		{
+			return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		}
+
+		// Offsets of the tables, which follow the header
+		uint64_t mesh_table()
+		{
+			return align(sizeof(FileHeader));
+		}
+
+		uint64_t instance_table(const FileHeader& header)
+		{
+			return align(mesh_table() + header.meshCount * sizeof(MeshRecord));
+		}
+
+		uint64_t light_table(const FileHeader& header)
+		{
+			return align(instance_table(header) + header.instanceCount * sizeof(InstanceRecord));
+		}
+
+		uint64_t blobs(const FileHeader& header)
+		{
+			return align(light_table(header) + header.lightCount * sizeof(LightRecord));
+		}
+
+		// Returns the position of the first of count indices that isn't below vertexCount, or count
+		uint32_t find_invalid_index(const char* indices, uint32_t count, uint32_t type, uint32_t vertexCount)
+		{
+			for (uint32_t i = 0; i < count; ++i) {
+				uint32_t index = type == GL_UNSIGNED_SHORT ? ((const uint16_t*) indices)[i] : ((const uint32_t*) indices)[i];
+				if (index >= vertexCount)
+					return i;
+			}
+			return count;
+		}
+
+		bool LessMesh(const InstanceRecord& a, const InstanceRecord& b)
+		{
+			return a.mesh < b.mesh;
+		}
+	}
+
+	File::File()
+		: m_data(nullptr), m_size(0), m_header(nullptr)
+#ifdef _WIN32
+		, m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+	{
+	}
+
+	File::~File()
+	{
+		Close();
+	}
+
+	bool File::Open(const std::string& path, bool checkIndices)
+	{
+		Close();
+
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		LARGE_INTEGER size;
+		if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size)) {
+			printf("ERROR: Couldn't open scene '%s'\n", path.c_str());
+			Close();
+			return false;
+		}
+		m_size = size.QuadPart;
+
+		m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_mapping)
+			m_data = (const char*) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			printf("ERROR: Couldn't open scene '%s'\n", path.c_str());
+			if (fd >= 0)
+				close(fd);
+			return false;
+		}
+		m_size = st.st_size;
+
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // The mapping keeps the file
+		if (data != MAP_FAILED) {
+			m_data = (const char*) data;
+			// It's read front to back, mostly by the driver's copies of the blobs
+			madvise(data, m_size, MADV_SEQUENTIAL);
+			madvise(data, m_size, MADV_WILLNEED);
+		}
+#endif
+
+		if (!m_data) {
+			printf("ERROR: Couldn't map scene '%s'\n", path.c_str());
+			Close();
+			return false;
+		}
+
+		m_header = (const FileHeader*) m_data;
+		if (!validate(path) || (checkIndices && !validate_indices(path))) {
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void File::Close()
+	{
+#ifdef _WIN32
+		if (m_data)
+			UnmapViewOfFile(m_data);
+		if (m_mapping)
+			CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+		m_file    = INVALID_HANDLE_VALUE;
+		m_mapping = nullptr;
+#else
+		if (m_data)
+			munmap((void*) m_data, m_size);
+#endif
+		m_data   = nullptr;
+		m_size   = 0;
+		m_header = nullptr;
+	}
+
+	bool File::IsOpen() const
+	{
+		return m_header != nullptr;
+	}
+
+	const Settings& File::GetSettings() const
+	{
+		return m_header->settings;
+	}
+
+	int File::GetMeshCount() const
+	{
+		return (int) m_header->meshCount;
+	}
+
+	const MeshRecord& File::GetMesh(int index) const
+	{
+		return ((const MeshRecord*) (m_data + mesh_table()))[index];
+	}
+
+	int File::GetInstanceCount() const
+	{
+		return (int) m_header->instanceCount;
+	}
+
+	const InstanceRecord& File::GetInstance(int index) const
+	{
+		return ((const InstanceRecord*) (m_data + instance_table(*m_header)))[index];
+	}
+
+	glm::mat4 File::GetModelMatrix(int instance) const
+	{
+		return glm::make_mat4(GetInstance(instance).model);
+	}
+
+	int File::GetLightCount() const
+	{
+		return (int) m_header->lightCount;
+	}
+
+	const LightRecord& File::GetLight(int index) const
+	{
+		return ((const LightRecord*) (m_data + light_table(*m_header)))[index];
+	}
+
+	const geometry::PackedVertex* File::GetVertices(int index) const
+	{
+		return (const geometry::PackedVertex*) (m_data + GetMesh(index).vertexOffset);
+	}
+
+	const geometry::PackedPosition* File::GetPositions(int index) const
+	{
+		const MeshRecord& record = GetMesh(index);
+		return record.positionCount > 0 ? (const geometry::PackedPosition*) (m_data + record.positionOffset) : nullptr;
+	}
+
+	Mesh File::UploadMesh(int index) const
+	{
+		const MeshRecord& record = GetMesh(index);
+
+		Mesh mesh = geometry::Upload(GetVertices(index), record.vertexCount,
+			m_data + record.indexOffset, record.indexCount, record.indexType);
+
+		if (record.positionCount > 0) {
+			geometry::UploadPositions(GetPositions(index), record.positionCount,
+				m_data + record.shadowIndexOffset, record.shadowIndexCount, record.shadowIndexType, mesh);
+		}
+
+		mesh.boundsMin = glm::make_vec3(record.boundsMin);
+		mesh.boundsMax = glm::make_vec3(record.boundsMax);
+
+		return mesh;
+	}
+
+	bool File::inside(uint64_t offset, uint64_t size) const
+	{
+		return offset <= m_size && size <= m_size - offset;
+	}
+
+	bool File::validate(const std::string& path) const
+	{
+		const FileHeader& header = *m_header;
+
+		if (m_size < sizeof(FileHeader) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+			printf("ERROR: '%s' isn't a scene-file\n", path.c_str());
+			return false;
+		}
+		if (header.version != FORMAT_VERSION) {
+			printf("ERROR: Scene '%s' is version %u, not %u (convert it again)\n", path.c_str(), header.version, FORMAT_VERSION);
+			return false;
+		}
+		if (!inside(0, blobs(header))) {
+			printf("ERROR: Scene '%s' is truncated\n", path.c_str());
+			return false;
+		}
+
+		for (uint32_t i = 0; i < header.meshCount; ++i) {
+			const MeshRecord& mesh = GetMesh(i);
+			bool valid = (mesh.indexType == GL_UNSIGNED_SHORT || mesh.indexType == GL_UNSIGNED_INT)
+				&& inside(mesh.vertexOffset, (uint64_t) mesh.vertexCount * sizeof(geometry::PackedVertex))
+				&& inside(mesh.indexOffset, (uint64_t) mesh.indexCount * geometry::IndexSize(mesh.indexType))
+				&& (uint64_t) mesh.firstInstance + mesh.instanceCount <= header.instanceCount;
+			if (mesh.positionCount > 0) {
+				valid = valid && (mesh.shadowIndexType == GL_UNSIGNED_SHORT || mesh.shadowIndexType == GL_UNSIGNED_INT)
+					&& inside(mesh.positionOffset, (uint64_t) mesh.positionCount * sizeof(geometry::PackedPosition))
+					&& inside(mesh.shadowIndexOffset, (uint64_t) mesh.shadowIndexCount * geometry::IndexSize(mesh.shadowIndexType));
+			}
+
+			if (!valid) {
+				printf("ERROR: Mesh %u of scene '%s' is corrupt\n", i, path.c_str());
+				return false;
+			}
+		}
+
+		for (uint32_t i = 0; i < header.instanceCount; ++i) {
+			if (GetInstance(i).mesh >= header.meshCount) {
+				printf("ERROR: Instance %u of scene '%s' has no mesh\n", i, path.c_str());
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool File::validate_indices(const std::string& path) const
+	{
+		for (int i = 0; i < GetMeshCount(); ++i) {
+			const MeshRecord& mesh = GetMesh(i);
+
+			uint32_t bad = find_invalid_index(m_data + mesh.indexOffset, mesh.indexCount, mesh.indexType, mesh.vertexCount);
+			if (bad < mesh.indexCount) {
+				printf("ERROR: Index %u of mesh %d of scene '%s' is past its %u vertices\n", bad, i, path.c_str(), mesh.vertexCount);
+				return false;
+			}
+
+			if (mesh.positionCount == 0)
+				continue;
+			bad = find_invalid_index(m_data + mesh.shadowIndexOffset, mesh.shadowIndexCount, mesh.shadowIndexType, mesh.positionCount);
+			if (bad < mesh.shadowIndexCount) {
+				printf("ERROR: Shadow-index %u of mesh %d of scene '%s' is past its %u positions\n", bad, i, path.c_str(), mesh.positionCount);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	Writer::Writer()
+	{
+		m_settings.shadowMapSize = 0;
+		m_settings.blurRadius    = 0;
+	}
+
+	int Writer::AddMesh(const std::vector<geometry::Vertex>& meshTriangles, bool positionStream)
+	{
+		MeshData data;
+		memset(&data.record, 0, sizeof(MeshRecord));
+
+		// Packed in [-1, 1], and put back where it was by its instances
+		std::vector<geometry::Vertex> triangles = meshTriangles;
+		data.dequantize = geometry::Normalize(triangles);
+
+		geometry::IndexedMesh mesh = geometry::Index(triangles);
+		geometry::Optimize(mesh);
+		data.vertices = geometry::Pack(mesh);
+		data.record.vertexCount = (uint32_t) mesh.vertices.size();
+		data.record.indexCount  = (uint32_t) mesh.indices.size();
+		data.record.indexType   = geometry::PackIndices(mesh, data.indices);
+
+		if (positionStream) {
+			geometry::IndexedMesh positions = geometry::IndexPositions(triangles);
+			geometry::Optimize(positions);
+			data.positions = geometry::PackPositions(positions);
+			data.record.positionCount    = (uint32_t) positions.vertices.size();
+			data.record.shadowIndexCount = (uint32_t) positions.indices.size();
+			data.record.shadowIndexType  = geometry::PackIndices(positions, data.shadowIndices);
+		}
+
+		glm::vec3 lo, hi;
+		geometry::Bounds(mesh, lo, hi);
+		for (int k = 0; k < 3; ++k) {
+			data.record.boundsMin[k] = lo[k];
+			data.record.boundsMax[k] = hi[k];
+		}
+
+		m_meshes.push_back(data);
+		return (int) m_meshes.size() - 1;
+	}
+
+	void Writer::AddInstance(int mesh, const glm::mat4& model, uint32_t flags)
+	{
+		InstanceRecord instance;
+		instance.mesh  = (uint32_t) mesh;
+		instance.flags = flags;
+		glm::mat4 meshToWorld = model * m_meshes[mesh].dequantize;
+		memcpy(instance.model, glm::value_ptr(meshToWorld), sizeof(instance.model));
+		m_instances.push_back(instance);
+	}
+
+	void Writer::AddLight(const LightRecord& light)
+	{
+		m_lights.push_back(light);
+	}
+
+	void Writer::SetSettings(const Settings& settings)
+	{
+		m_settings = settings;
+	}
+
+	int Writer::GetMeshCount() const
+	{
+		return (int) m_meshes.size();
+	}
+
+	bool Writer::Save(const std::string& path) const
+	{
+		FileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version       = FORMAT_VERSION;
+		header.meshCount     = (uint32_t) m_meshes.size();
+		header.instanceCount = (uint32_t) m_instances.size();
+		header.lightCount    = (uint32_t) m_lights.size();
+		header.settings      = m_settings;
+
+		std::vector<InstanceRecord> instances(m_instances);
+		std::stable_sort(instances.begin(), instances.end(), LessMesh);
+
+		// Lay out the blobs after the tables
+		std::vector<MeshRecord> records(m_meshes.size());
+		uint64_t offset = blobs(header);
+		for (size_t i = 0; i < m_meshes.size(); ++i) {
+			const MeshData& data = m_meshes[i];
+			MeshRecord& record = records[i];
+			record = data.record;
+
+			record.vertexOffset = offset;
+			offset = align(offset + data.vertices.size() * sizeof(geometry::PackedVertex));
+			record.indexOffset = offset;
+			offset = align(offset + data.indices.size());
+			if (!data.positions.empty()) {
+				record.positionOffset = offset;
+				offset = align(offset + data.positions.size() * sizeof(geometry::PackedPosition));
+				record.shadowIndexOffset = offset;
+				offset = align(offset + data.shadowIndices.size());
+			}
+		}
+
+		// Each mesh's range of the sorted instances
+		for (size_t i = 0; i < instances.size(); ++i) {
+			if (instances[i].mesh >= records.size()) {
+				printf("ERROR: Instance %u has no mesh\n", (unsigned) i);
+				return false;
+			}
+
+			MeshRecord& record = records[instances[i].mesh];
+			if (record.instanceCount++ == 0)
+				record.firstInstance = (uint32_t) i;
+		}
+
+		// Written in order, padded up to each part's offset
+		std::vector<char> file(offset, 0);
+		memcpy(&file[0], &header, sizeof(header));
+		if (!records.empty())
+			memcpy(&file[mesh_table()], records.data(), records.size() * sizeof(MeshRecord));
+		if (!instances.empty())
+			memcpy(&file[instance_table(header)], instances.data(), instances.size() * sizeof(InstanceRecord));
+		if (!m_lights.empty())
+			memcpy(&file[light_table(header)], m_lights.data(), m_lights.size() * sizeof(LightRecord));
+
+		for (size_t i = 0; i < m_meshes.size(); ++i) {
+			const MeshData& data = m_meshes[i];
+			const MeshRecord& record = records[i];
+			memcpy(&file[record.vertexOffset], data.vertices.data(), data.vertices.size() * sizeof(geometry::PackedVertex));
+			memcpy(&file[record.indexOffset], data.indices.data(), data.indices.size());
+			if (!data.positions.empty()) {
+				memcpy(&file[record.positionOffset], data.positions.data(), data.positions.size() * sizeof(geometry::PackedPosition));
+				memcpy(&file[record.shadowIndexOffset], data.shadowIndices.data(), data.shadowIndices.size());
+			}
+		}
+
+		FILE* out = fopen(path.c_str(), "wb");
+		if (!out) {
+			printf("ERROR: Couldn't write scene '%s'\n", path.c_str());
+			return false;
+		}
+		bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+		written = fclose(out) == 0 && written;
+		if (!written)
+			printf("ERROR: Couldn't write scene '%s'\n", path.c_str());
+
+		return written;
+	}
+}
@@ -9,6 +9,15 @@
 #include <unordered_map>
 #include <map>
 #include <utility>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -18,6 +27,12 @@
 
 #include "ShaderProgram.hpp"
 #include "OpenGL.hpp"
+#include "GLState.hpp"
+
+// GL 4.3 (newer than gl3w's headers); only loaded where it's supported
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
 
 namespace ShaderUtils
 {
@@ -51,13 +66,18 @@ namespace ShaderUtils
 		return std::string(strInfoLog.get());
 	}
 
-	Status CompileShader(GLuint shader, const std::string &shaderText)
+	// Only starts compiling, see CheckShader()
+	void CompileShader(GLuint shader, const std::string &shaderText)
 	{
 		const char *strFileData = shaderText.c_str();
 		glShaderSource(shader, 1, &strFileData, NULL);
 
 		glCompileShader(shader);
+	}
 
+	// Waits for the shader to be compiled
+	Status CheckShader(GLuint shader)
+	{
 		GLint compileStatus;
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
 
@@ -74,6 +94,185 @@ namespace ShaderUtils
 		return status;
 	}
 
+	// GL_KHR_parallel_shader_compile (or the ARB-version)
+	const GLenum GL_COMPLETION_STATUS_KHR = 0x91B1;
+	typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+	static bool s_parallelChecked = false;
+	static bool s_parallelCompile = false;
+
+	// Lets the driver compile on as many threads as it likes, if it supports it
+	void EnableParallelCompile()
+	{
+		if (s_parallelChecked)
+			return;
+		s_parallelChecked = true;
+
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; ++i)
+		{
+			std::string name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (name == "GL_KHR_parallel_shader_compile" || name == "GL_ARB_parallel_shader_compile")
+			{
+				const char* function = (name[3] == 'K') ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB";
+				PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)gl3wGetProcAddress(function);
+				if (maxThreads)
+					maxThreads(0xFFFFFFFF);
+				s_parallelCompile = true;
+				break;
+			}
+		}
+	}
+
+	// Whether compiling and linking program is done. Without the extension there's no
+	// way to ask, so it's always considered done (and querying its status waits for it).
+	bool IsCompletionDone(GLuint program)
+	{
+		if (!s_parallelCompile)
+			return true;
+
+		GLint done = GL_FALSE;
+		glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+		return done == GL_TRUE;
+	}
+}
+
+// On-disk cache of linked programs (glGetProgramBinary/glProgramBinary).
+// There's one file per combination of shader-files, which is overwritten when its key
+// (the sources and the driver) no longer matches, so stale binaries don't pile up.
+namespace BinaryCache
+{
+	static std::string s_dir;
+
+	const uint32_t MAGIC   = 0x42505347; // "GSPB"
+	const uint32_t VERSION = 1;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	// FNV-1a, as it must give the same hash in every run (which std::hash needn't)
+	uint64_t Hash(const std::string& str, uint64_t hash = 14695981039346656037ULL)
+	{
+		for (size_t i = 0; i < str.size(); ++i)
+		{
+			hash ^= (unsigned char)str[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	bool IsEnabled()
+	{
+		if (s_dir.empty())
+			return false;
+
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	std::string FileName(const ShaderInfo& shaderInfo, const std::string& includeDir)
+	{
+		uint64_t hash = Hash(shaderInfo.vsFile + "\n" + shaderInfo.gsFile + "\n" + shaderInfo.fsFile + "\n" + shaderInfo.csFile + "\n" + includeDir);
+
+		char name[32];
+		sprintf(name, "%016llx.bin", (unsigned long long)hash);
+		return s_dir + "/" + name;
+	}
+
+	// Binaries are only valid for the driver that made them
+	uint64_t Key(const std::vector<std::pair<GLenum, std::string> >& sources)
+	{
+		const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+
+		uint64_t hash = Hash("");
+		for (GLenum s : strings)
+		{
+			const char* str = (const char*)glGetString(s);
+			hash = Hash(str ? str : "", hash);
+		}
+
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			hash = Hash(std::to_string(sources[i].first), hash);
+			hash = Hash(sources[i].second, hash);
+		}
+		return hash;
+	}
+
+	// Whether program was linked from the cached binary
+	bool Load(GLuint program, const std::string& file, uint64_t key)
+	{
+		FILE* fp = fopen(file.c_str(), "rb");
+		if (!fp)
+			return false;
+
+		Header header;
+		std::vector<char> binary;
+		bool ok = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == MAGIC &&
+			header.version == VERSION && header.key == key && header.length > 0;
+		if (ok)
+		{
+			binary.resize(header.length);
+			ok = fread(&binary[0], 1, binary.size(), fp) == binary.size();
+		}
+		fclose(fp);
+
+		if (!ok)
+			return false; // Missing or stale, it's replaced after compiling
+
+		glProgramBinary(program, header.format, &binary[0], header.length);
+
+		GLint linkStatus;
+		glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+		if (linkStatus == GL_FALSE)
+		{
+			// Rejected (e.g. after a driver-update not changing its version-string)
+			remove(file.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	void Save(GLuint program, const std::string& file, uint64_t key)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		Header header;
+		std::vector<char> binary(length);
+		GLenum format;
+		glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+
+		header.magic   = MAGIC;
+		header.version = VERSION;
+		header.key     = key;
+		header.format  = format;
+		header.length  = (uint32_t)length;
+
+		// Written aside and renamed, so other processes never read half a file
+		std::string tmpFile = file + ".tmp";
+		FILE* fp = fopen(tmpFile.c_str(), "wb");
+		if (!fp)
+			return;
+
+		bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(&binary[0], 1, binary.size(), fp) == binary.size();
+		ok = fclose(fp) == 0 && ok;
+
+		remove(file.c_str()); // rename() won't replace files on Windows
+		if (!ok || rename(tmpFile.c_str(), file.c_str()) != 0)
+			remove(tmpFile.c_str());
+	}
 }
 
 static std::string LoadFile(const std::string& file, const std::string& includeDir)
@@ -101,6 +300,8 @@ static std::string LoadFile(const std::string& file, const std::string& includeD
 			std::string includeFile = includeDir + line.substr(1, line.find_first_of(' '));
 
 			std::ifstream inc(includeFile);
+			if (!inc.is_open())
+				inc.open("../src/" + includeFile);
 
 			if (!inc.is_open())
 			{
@@ -129,7 +330,7 @@ static std::string LoadFile(const std::string& file, const std::string& includeD
 
 
 ShaderProgram::ShaderProgram()
-: m_programId(0), m_loadedFromFile(false)
+: m_loadedFromFile(false), m_binaryKey(0)
 {
 
 }
@@ -141,10 +342,15 @@ ShaderProgram::~ShaderProgram()
 
 int ShaderProgram::GetProgram() const
 {
-	return m_programId;
+	return m_program.Get();
 }
 
 bool ShaderProgram::Reload()
+{
+	return ReloadAsync() && Finish();
+}
+
+bool ShaderProgram::ReloadAsync()
 {
 	if (!IsLoaded())
 	{
@@ -154,22 +360,29 @@ bool ShaderProgram::Reload()
 
 	if (m_loadedFromFile)
 	{
-		// Reload from files
-		Load(m_shaderInfo, m_includeDir);
-
-		// Invalidate uniform-location cache
-		m_uniformLocations.clear();
+		// Reload from files, into a new program which replaces this one once it's linked
+		// (Uniform-handles are resolved again then)
+		LoadAsync(m_shaderInfo, m_includeDir);
 	}
 
 	return true;
 }
 
 bool ShaderProgram::Load(const ShaderInfo& shaderInfo, const std::string& includeDir)
+{
+	LoadAsync(shaderInfo, includeDir);
+	return Finish();
+}
+
+void ShaderProgram::LoadAsync(const ShaderInfo& shaderInfo, const std::string& includeDir)
 {
 	m_shaderInfo = shaderInfo;
 	m_loadedFromFile = true;
 	m_includeDir = includeDir;
 
+	// A previous load still pending is waited for, as its shaders are attached
+	Finish();
+
 	struct Shader
 	{
 		Shader() : handle(0), type(0) {};
@@ -204,75 +417,141 @@ bool ShaderProgram::Load(const ShaderInfo& shaderInfo, const std::string& includ
 		shaders.push_back(s);
 	}
 
-	if (!IsLoaded())
+	if (shaderInfo.csFile != "")
 	{
-		// Create program if necessary
-		m_programId = glCreateProgram();
+		Shader s;
+		s.source = LoadFile(shaderInfo.csFile, includeDir);
+		s.type = GL_COMPUTE_SHADER;
+		shaders.push_back(s);
 	}
 
-	// Create, attach, and compile
-	bool success = true;
-	std::string error;
+	// Linked aside, so the current program (if any) can still be drawn with meanwhile
+	m_pendingProgram.Reset(glCreateProgram());
+
+	// Try the binary-cache first
+	m_binaryFile.clear();
+	if (BinaryCache::IsEnabled())
+	{
+		std::vector<std::pair<GLenum, std::string> > sources;
+		for (const Shader& s : shaders)
+			sources.push_back(std::make_pair(s.type, s.source));
+
+		m_binaryFile = BinaryCache::FileName(shaderInfo, includeDir);
+		m_binaryKey = BinaryCache::Key(sources);
+		if (BinaryCache::Load(m_pendingProgram.Get(), m_binaryFile, m_binaryKey))
+		{
+			m_binaryFile.clear();
+			m_program = std::move(m_pendingProgram);
+			reflect();
+			return;
+		}
+
+		glProgramParameteri(m_pendingProgram.Get(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	ShaderUtils::EnableParallelCompile();
+
+	// Create, attach, compile and link without waiting for any of it (see Finish())
 	for (Shader& s : shaders)
 	{
 		s.handle = glCreateShader(s.type);
-		glAttachShader(m_programId, s.handle);
+		glAttachShader(m_pendingProgram.Get(), s.handle);
+		ShaderUtils::CompileShader(s.handle, s.source);
+		m_pendingShaders.push_back(s.handle);
+	}
+
+	glLinkProgram(m_pendingProgram.Get());
+}
+
+bool ShaderProgram::IsReady()
+{
+	if (IsPending() && ShaderUtils::IsCompletionDone(m_pendingProgram.Get()))
+		Finish();
+
+	return IsLoaded();
+}
 
-		ShaderUtils::Status status = ShaderUtils::CompileShader(s.handle, s.source);
+bool ShaderProgram::IsPending() const
+{
+	return m_pendingProgram.Get() != 0;
+}
+
+ShaderProgram& ShaderProgram::ReadyOr(ShaderProgram& fallback)
+{
+	return IsReady() ? *this : fallback;
+}
+
+bool ShaderProgram::Finish()
+{
+	if (!IsPending())
+		return IsLoaded();
+
+	// Report compile-errors for all shaders
+	bool success = true;
+	std::string error;
+	for (GLuint shader : m_pendingShaders)
+	{
+		ShaderUtils::Status status = ShaderUtils::CheckShader(shader);
 		if (status.success == false)
 		{
-			// Continue so it reports compile-errors for all shaders
 			success = false;
 			error += status.error;
-			continue;
 		}
 	}
 
-	// Mark shaders for deletion (done on detach)
-	for (Shader& s : shaders)
+	// Detach and delete all shaders
+	for (GLuint shader : m_pendingShaders)
 	{
-		glDeleteShader(s.handle);
+		glDetachShader(m_pendingProgram.Get(), shader);
+		glDeleteShader(shader);
 	}
+	m_pendingShaders.clear();
 
-	// Compilation failure
+	// Compilation failure (a previous program is kept)
 	if (!success)
 	{
-		// Detach shaders
-		for (Shader& s : shaders)
-		{
-			glDetachShader(m_programId, s.handle);
-		}
-
 		std::cerr << error << std::endl;
+		m_pendingProgram.Reset();
 		return false;
 	}
 
-	// Link
-	glLinkProgram(m_programId);
-
-	// Detach all shaders
-	for (Shader& s : shaders)
-	{
-		glDetachShader(m_programId, s.handle);
-	}
-
 	// Check link-status
 	GLint linkStatus;
-	glGetProgramiv(m_programId, GL_LINK_STATUS, &linkStatus);
+	glGetProgramiv(m_pendingProgram.Get(), GL_LINK_STATUS, &linkStatus);
 
 	if (linkStatus == GL_FALSE)
 	{
-		const std::string& strInfoLog = ShaderUtils::InfoLogHelper(glGetProgramiv, glGetProgramInfoLog, m_programId);
+		const std::string& strInfoLog = ShaderUtils::InfoLogHelper(glGetProgramiv, glGetProgramInfoLog, m_pendingProgram.Get());
 		std::cerr << strInfoLog << std::endl;
+		m_pendingProgram.Reset();
 		return false;
 	}
 
+	if (!m_binaryFile.empty())
+		BinaryCache::Save(m_pendingProgram.Get(), m_binaryFile, m_binaryKey);
+
+	m_program = std::move(m_pendingProgram);
+	reflect();
 	return true;
 }
 
+void ShaderProgram::SetBinaryCacheDir(const std::string& dir)
+{
+	BinaryCache::s_dir = dir;
+	if (dir.empty())
+		return;
+
+	// Fails harmlessly if it exists
+#ifdef _WIN32
+	_mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0755);
+#endif
+}
+
 bool ShaderProgram::IsLoaded() const
 {
-	return m_programId != 0;
+	return m_program.Get() != 0;
 }
 
 bool ShaderProgram::UpdateUniform(int programId, int location, float f)
@@ -281,41 +560,29 @@ bool ShaderProgram::UpdateUniform(int programId, int location, float f)
 	return location > -1;
 }
 
-bool ShaderProgram::UpdateUniform(int programId, int location, const glm::mat4& m)
+bool ShaderProgram::UpdateUniform(int programId, int location, const float* f, int count)
 {
-	if (location == -1) return false;
-	glProgramUniformMatrix4fv(programId, location, 1, GL_FALSE, glm::value_ptr(m));
+	glProgramUniform1fv(programId, location, count, f);
 	return location > -1;
 }
 
-bool ShaderProgram::UpdateUniform(const std::string& name, const glm::mat4& m)
+bool ShaderProgram::UpdateUniformi(int programId, int location, int i)
 {
-	GLint location = GetUniformLocation(name);
-	if (location == -1) return false;
-	return UpdateUniform(m_programId, location, m);
-}
-
-bool ShaderProgram::UpdateUniform(const std::string& name, const glm::vec2& v)
-{
-	GLint location = GetUniformLocation(name);
-	if (location == -1) return false;
-	glProgramUniform2fv(m_programId, location, 1, glm::value_ptr(v));
+	glProgramUniform1i(programId, location, i);
 	return location > -1;
 }
 
-bool ShaderProgram::UpdateUniform(const std::string& name, const glm::vec3& v)
+bool ShaderProgram::UpdateUniform(int programId, int location, const glm::mat4& m)
 {
-	GLint location = GetUniformLocation(name);
 	if (location == -1) return false;
-	glProgramUniform3fv(m_programId, location, 1, glm::value_ptr(v));
+	glProgramUniformMatrix4fv(programId, location, 1, GL_FALSE, glm::value_ptr(m));
 	return location > -1;
 }
 
-bool ShaderProgram::UpdateUniform(const std::string& name, const glm::vec4& v)
+bool ShaderProgram::UpdateUniform(int programId, int location, const glm::mat4* m, int count)
 {
-	GLint location = GetUniformLocation(name);
-	if (location > -1)
-		glProgramUniform4fv(m_programId, location, 1, glm::value_ptr(v));
+	if (location == -1) return false;
+	glProgramUniformMatrix4fv(programId, location, count, GL_FALSE, glm::value_ptr(m[0]));
 	return location > -1;
 }
 
@@ -331,30 +598,100 @@ bool ShaderProgram::UpdateUniform(int programId, int location, const glm::vec3&
 	return location > -1;
 }
 
-bool ShaderProgram::UpdateUniform(const std::string& name, float f)
+bool ShaderProgram::UpdateUniform(int programId, int location, const glm::vec2& v)
 {
-	GLint location = GetUniformLocation(name);
-	if (location == -1) return false;
-	glProgramUniform1f(m_programId, location, f);
+	glProgramUniform2fv(programId, location, 1, glm::value_ptr(v));
 	return location > -1;
 }
 
-bool ShaderProgram::UpdateUniformi(const std::string& name, int i)
+bool ShaderProgram::UpdateUniform(UniformName name, const glm::mat4& m)
 {
-	GLint location = GetUniformLocation(name);
-	if (location == -1) return false;
-	glProgramUniform1i(m_programId, location, i);
-	return location > -1;
+	return UpdateUniform(m_program.Get(), GetUniformLocation(name), m);
+}
+
+bool ShaderProgram::UpdateUniform(UniformName name, const glm::mat4* m, int count)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(name), m, count);
+}
+
+bool ShaderProgram::UpdateUniform(UniformName name, const glm::vec2& v)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(name), v);
+}
+
+bool ShaderProgram::UpdateUniform(UniformName name, const glm::vec3& v)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(name), v);
+}
+
+bool ShaderProgram::UpdateUniform(UniformName name, const glm::vec4& v)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(name), v);
+}
+
+bool ShaderProgram::UpdateUniform(UniformName name, float f)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(name), f);
+}
+
+bool ShaderProgram::UpdateUniform(UniformName name, const float* f, int count)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(name), f, count);
+}
+
+bool ShaderProgram::UpdateUniformi(UniformName name, int i)
+{
+	return UpdateUniformi(m_program.Get(), GetUniformLocation(name), i);
+}
+
+bool ShaderProgram::UpdateUniform(Uniform uniform, const glm::mat4& m)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(uniform), m);
+}
+
+bool ShaderProgram::UpdateUniform(Uniform uniform, const glm::mat4* m, int count)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(uniform), m, count);
+}
+
+bool ShaderProgram::UpdateUniform(Uniform uniform, const glm::vec2& v)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(uniform), v);
+}
+
+bool ShaderProgram::UpdateUniform(Uniform uniform, const glm::vec3& v)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(uniform), v);
+}
+
+bool ShaderProgram::UpdateUniform(Uniform uniform, const glm::vec4& v)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(uniform), v);
+}
+
+bool ShaderProgram::UpdateUniform(Uniform uniform, float f)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(uniform), f);
+}
+
+bool ShaderProgram::UpdateUniform(Uniform uniform, const float* f, int count)
+{
+	return UpdateUniform(m_program.Get(), GetUniformLocation(uniform), f, count);
+}
+
+bool ShaderProgram::UpdateUniformi(Uniform uniform, int i)
+{
+	return UpdateUniformi(m_program.Get(), GetUniformLocation(uniform), i);
 }
 
 void ShaderProgram::UseProgram() const
 {
-	glUseProgram(m_programId);
+	glstate::UseProgram(m_program.Get());
 }
 
 int ShaderProgram::GetAttribLocation(const std::string &name)
 {
-	GLint location = glGetAttribLocation(m_programId, name.c_str());
+	GLint location = glGetAttribLocation(m_program.Get(), name.c_str());
 	return location;
 }
 
@@ -363,25 +700,189 @@ int ShaderProgram::GetUniformLocation(GLuint program, const std::string& name)
 	return glGetUniformLocation(program, name.c_str());
 }
 
-int ShaderProgram::GetUniformLocation(const std::string& name)
+namespace
 {
-	const auto& f = m_uniformLocations.find(name);
-	if (f != m_uniformLocations.end())
+	// Binary search of a table sorted by hash
+	template<typename T>
+	const T* FindHash(const std::vector<T>& table, uint32_t hash)
 	{
-		return f->second;
+		auto it = std::lower_bound(table.begin(), table.end(), hash,
+			[](const T& entry, uint32_t h) { return entry.hash < h; });
+
+		return it != table.end() && it->hash == hash ? &*it : nullptr;
 	}
 
-	GLint location = glGetUniformLocation(m_programId, name.c_str());
-	m_uniformLocations[name] = location;
+	template<typename T>
+	bool LessHash(const T& a, const T& b)
+	{
+		return a.hash < b.hash;
+	}
 
-	return location;
+	// Two names of a program with the same hash can't be told apart
+	template<typename T>
+	void CheckCollisions(const std::vector<T>& table)
+	{
+		for (size_t i = 1; i < table.size(); ++i)
+		{
+			if (table[i].hash == table[i - 1].hash)
+				printf("Uniform names '%s' and '%s' have the same hash\n", table[i - 1].name.c_str(), table[i].name.c_str());
+		}
+	}
+}
+
+int ShaderProgram::GetUniformLocation(UniformName name) const
+{
+	const UniformInfo* uniform = FindHash(m_uniforms, name.hash);
+	return uniform ? uniform->location : -1;
+}
+
+ShaderProgram::Uniform ShaderProgram::GetUniform(UniformName name)
+{
+	Uniform uniform;
+	for (uniform.slot = 0; uniform.slot < (int)m_slots.size(); ++uniform.slot)
+	{
+		if (m_slots[uniform.slot].hash == name.hash)
+			return uniform;
+	}
+
+	Slot slot;
+	slot.hash = name.hash;
+	slot.location = GetUniformLocation(name);
+	m_slots.push_back(slot);
+
+	return uniform;
 }
 
+int ShaderProgram::GetUniformLocation(Uniform uniform) const
+{
+	return m_slots[uniform.slot].location;
+}
+
+GLuint ShaderProgram::GetUniformBlockIndex(UniformName name) const
+{
+	const BlockInfo* block = FindHash(m_blocks, name.hash);
+	return block ? block->index : GL_INVALID_INDEX;
+}
+
+GLint ShaderProgram::GetUniformBlockSize(UniformName name) const
+{
+	const BlockInfo* block = FindHash(m_blocks, name.hash);
+	return block ? block->size : 0;
+}
+
+bool ShaderProgram::BindUniformBlock(UniformName name, GLuint binding)
+{
+	// Remembered, since linking resets the bindings
+	BlockBinding* found = nullptr;
+	for (BlockBinding& b : m_blockBindings)
+	{
+		if (b.hash == name.hash)
+			found = &b;
+	}
+
+	if (!found)
+	{
+		BlockBinding b = { name.hash, binding };
+		m_blockBindings.push_back(b);
+	}
+	else if (found->binding == binding)
+	{
+		return GetUniformBlockIndex(name) != GL_INVALID_INDEX; // Already set
+	}
+	else
+	{
+		found->binding = binding;
+	}
+
+	GLuint index = GetUniformBlockIndex(name);
+	if (index == GL_INVALID_INDEX)
+		return false;
+
+	glUniformBlockBinding(m_program.Get(), index, binding);
+	return true;
+}
+
+void ShaderProgram::reflect()
+{
+	m_uniforms.clear();
+	m_blocks.clear();
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(m_program.Get(), GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_program.Get(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<GLchar> name(std::max(maxLength, 1));
+	for (GLint i = 0; i < count; ++i)
+	{
+		UniformInfo uniform;
+		GLsizei length = 0;
+		glGetActiveUniform(m_program.Get(), i, (GLsizei)name.size(), &length, &uniform.size, &uniform.type, &name[0]);
+
+		// Members of uniform-blocks have no location
+		uniform.location = glGetUniformLocation(m_program.Get(), &name[0]);
+		if (uniform.location == -1)
+			continue;
+
+		// Arrays are named "name[0]", but set by "name"
+		uniform.name.assign(&name[0], length);
+		if (uniform.name.size() > 3 && uniform.name.compare(uniform.name.size() - 3, 3, "[0]") == 0)
+			uniform.name.resize(uniform.name.size() - 3);
+
+		uniform.hash = UniformName::Hash(uniform.name.c_str());
+		m_uniforms.push_back(uniform);
+	}
+
+	glGetProgramiv(m_program.Get(), GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		GLint length = 0;
+		glGetActiveUniformBlockiv(m_program.Get(), i, GL_UNIFORM_BLOCK_NAME_LENGTH, &length);
+		name.resize(std::max(length, 1));
+		glGetActiveUniformBlockName(m_program.Get(), i, (GLsizei)name.size(), &length, &name[0]);
+
+		BlockInfo block;
+		block.name.assign(&name[0], length);
+		block.hash = UniformName::Hash(block.name.c_str());
+		block.index = i;
+		glGetActiveUniformBlockiv(m_program.Get(), i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.size);
+		m_blocks.push_back(block);
+	}
+
+	std::sort(m_uniforms.begin(), m_uniforms.end(), LessHash<UniformInfo>);
+	std::sort(m_blocks.begin(), m_blocks.end(), LessHash<BlockInfo>);
+	CheckCollisions(m_uniforms);
+	CheckCollisions(m_blocks);
+
+	// Handles given out before stay valid, with the locations in this program
+	for (Slot& slot : m_slots)
+	{
+		const UniformInfo* uniform = FindHash(m_uniforms, slot.hash);
+		slot.location = uniform ? uniform->location : -1;
+	}
+
+	for (const BlockBinding& b : m_blockBindings)
+	{
+		const BlockInfo* block = FindHash(m_blocks, b.hash);
+		if (block)
+			glUniformBlockBinding(m_program.Get(), block->index, b.binding);
+	}
+}
 void ShaderProgram::DeleteProgram()
 {
+	for (GLuint shader : m_pendingShaders)
+	{
+		glDeleteShader(shader);
+	}
+	m_pendingShaders.clear();
+	m_pendingProgram.Reset();
+
 	if (IsLoaded())
 	{
-		glDeleteProgram(m_programId);
-		m_programId = 0;
+		m_program.Reset();
 	}
+
+	m_uniforms.clear();
+	m_blocks.clear();
+	for (Slot& slot : m_slots)
+		slot.location = -1;
 }
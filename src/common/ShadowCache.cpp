@@ -0,0 +1,144 @@
+#include <cstdio>
+#include <utility>
+
+#include "ShadowCache.hpp"
+#include "Common.hpp"
+#include "OpenGL.hpp"
+#include "GLState.hpp"
+
+namespace shadowcache
+{
+	Tracker::Tracker()
+		: m_valid(false)
+	{
+	}
+
+	void Tracker::Begin(const glm::mat4& lightMatrix)
+	{
+		m_current.light = lightMatrix;
+		m_current.statics.clear();
+		m_current.dynamics.clear();
+	}
+
+	void Tracker::AddCaster(int id, const glm::mat4& model, bool isStatic)
+	{
+		Caster caster = { id, model };
+		if (isStatic)
+			m_current.statics.push_back(caster);
+		else
+			m_current.dynamics.push_back(caster);
+	}
+
+	Update Tracker::End()
+	{
+		Update update = NONE;
+		if (!m_valid || m_current.light != m_last.light || !same(m_current.statics, m_last.statics))
+			update = ALL;
+		else if (!same(m_current.dynamics, m_last.dynamics))
+			update = DYNAMIC;
+
+		// Swapped rather than copied, so the vectors keep their memory
+		std::swap(m_current, m_last);
+		m_valid = true;
+		return update;
+	}
+
+	void Tracker::Invalidate()
+	{
+		m_valid = false;
+	}
+
+	bool Tracker::HasDynamic() const
+	{
+		return !m_last.dynamics.empty();
+	}
+
+	// Exact comparison, as any change must redraw
+	bool Tracker::same(const std::vector<Caster>& a, const std::vector<Caster>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (size_t i = 0; i < a.size(); ++i) {
+			if (a[i].id != b[i].id || a[i].model != b[i].model)
+				return false;
+		}
+		return true;
+	}
+
+	StaticBase::StaticBase()
+		: m_width(0), m_height(0), m_depthFormat(0), m_colorFormat(0)
+	{
+	}
+
+	StaticBase::~StaticBase()
+	{
+	}
+
+	bool StaticBase::Load(GLsizei width, GLsizei height, GLint depthFormat, GLint colorFormat)
+	{
+		m_width = width;
+		m_height = height;
+		m_depthFormat = depthFormat;
+		m_colorFormat = colorFormat;
+
+		m_depthTex.Reset(texture::Create2D(depthFormat, width, height, GL_DEPTH_COMPONENT, GL_FLOAT));
+		if (colorFormat) {
+			m_colorTex.Reset(texture::Create2D(colorFormat, width, height, GL_RG, GL_FLOAT));
+			m_fbo.Reset(texture::Framebuffer(m_colorTex.Get(), m_depthTex.Get()));
+			return true;
+		}
+
+		m_fbo = resource::GenFramebuffer();
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, m_fbo.Get());
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTex.Get(), 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		GLenum result = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (GL_FRAMEBUFFER_COMPLETE != result) {
+			printf("ERROR: Static shadow-base framebuffer not complete.\n");
+			return false;
+		}
+
+		return true;
+	}
+
+	void StaticBase::Delete()
+	{
+		m_depthTex.Reset();
+		m_colorTex.Reset();
+		m_fbo.Reset();
+	}
+
+	void StaticBase::Store(GLuint fbo)
+	{
+		blit(fbo, m_fbo.Get());
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
+
+	void StaticBase::Restore(GLuint fbo)
+	{
+		blit(m_fbo.Get(), fbo);
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
+
+	size_t StaticBase::MemorySize() const
+	{
+		size_t bytes = texture::MemorySize(m_depthFormat, m_width, m_height);
+		if (m_colorFormat)
+			bytes += texture::MemorySize(m_colorFormat, m_width, m_height);
+		return bytes;
+	}
+
+	void StaticBase::blit(GLuint from, GLuint to)
+	{
+		GLbitfield mask = GL_DEPTH_BUFFER_BIT;
+		if (m_colorFormat)
+			mask |= GL_COLOR_BUFFER_BIT;
+
+		glstate::BindFramebuffer(GL_READ_FRAMEBUFFER, from);
+		glstate::BindFramebuffer(GL_DRAW_FRAMEBUFFER, to);
+		glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, mask, GL_NEAREST);
+	}
+}
@@ -0,0 +1,95 @@
+#include <cstdio>
+
+#include "UniformBlocks.hpp"
+#include "OpenGL.hpp"
+
+namespace blocks
+{
+	namespace
+	{
+		// A member of a block, where its struct has it
+		struct Member
+		{
+			const char* name;
+			size_t      offset;
+		};
+
+		const Member frameMembers[] = {
+			{ "view",         offsetof(FrameData, view) },
+			{ "proj",         offsetof(FrameData, proj) },
+			{ "shadowMatrix", offsetof(FrameData, shadowMatrix) },
+			{ "lightPos",     offsetof(FrameData, lightPos) },
+			{ "lightDir",     offsetof(FrameData, lightDir) },
+		};
+	}
+
+	// The block is read from the struct's bytes of the buffer, so it mustn't be larger. It may be
+	// smaller (without padding after its last member, which is up to the driver); its members'
+	// offsets are checked one by one.
+	static bool bind(ShaderProgram& program, const char* name, GLuint binding, GLint size, const Member* members, int memberCount)
+	{
+		if (!program.BindUniformBlock(name, binding))
+			return true; // Not used by program
+
+		GLint blockSize = program.GetUniformBlockSize(name);
+		if (blockSize > size) {
+			printf("ERROR: %s-block is %d bytes, but its struct (and buffer) only %d bytes\n", name, blockSize, size);
+			return false;
+		}
+
+		for (int i = 0; i < memberCount; ++i) {
+			GLuint index = GL_INVALID_INDEX;
+			glGetUniformIndices(program.GetProgram(), 1, &members[i].name, &index);
+			if (index == GL_INVALID_INDEX)
+				continue; // Not active
+
+			GLint offset = -1;
+			glGetActiveUniformsiv(program.GetProgram(), 1, &index, GL_UNIFORM_OFFSET, &offset);
+			if (offset != (GLint) members[i].offset) {
+				printf("ERROR: %s.%s is at byte %d of the block, but at %d of its struct\n",
+					name, members[i].name, offset, (int) members[i].offset);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool SetBindings(ShaderProgram& program)
+	{
+		return bind(program, "Frame", FRAME_BINDING, sizeof(FrameData), frameMembers, sizeof(frameMembers) / sizeof(frameMembers[0]));
+	}
+
+	FrameUniforms::FrameUniforms()
+	{
+	}
+
+	FrameUniforms::~FrameUniforms()
+	{
+	}
+
+	bool FrameUniforms::Load()
+	{
+		m_ubo = resource::GenBuffer();
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo.Get());
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		// Bound once, for all programs
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, m_ubo.Get());
+
+		return true;
+	}
+
+	void FrameUniforms::Delete()
+	{
+		m_ubo.Reset();
+	}
+
+	void FrameUniforms::Update(const FrameData& data)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo.Get());
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+}
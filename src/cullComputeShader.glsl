@@ -0,0 +1,75 @@
+#version 430
+
+// Culls the objects of an IndirectCuller (see GpuCulling.hpp): one invocation per object tests its
+// bounds against every view, and sets the instance-count of its draw-command in each view's region
+// of the commands (1 if the view sees it, 0 if not), and in the region of any view
+layout(local_size_x = 64) in;
+
+// instancing::Instance, 18 floats each: model (column-major), doTexture, faces
+layout(std430, binding = 0) buffer Instances
+{
+	float instances[];
+};
+
+// Local-space center and extents of each object
+layout(std430, binding = 1) readonly buffer Bounds
+{
+	vec4 bounds[];
+};
+
+// gpuculling::DrawCommand, 5 uints each (the instance-count second); maxObjects per region
+layout(std430, binding = 2) buffer Commands
+{
+	uint commands[];
+};
+
+#define MAX_VIEWS 16
+uniform vec4 planes[MAX_VIEWS * 6]; // Of each view's frustum (see culling::ExtractFrustum())
+uniform int  viewCount;
+uniform int  objectCount;
+uniform int  maxObjects;
+uniform int  writeFaces; // Nonzero sets the instances' faces to the views that see them
+
+const int INSTANCE_FLOATS = 18;
+const int FACES_FLOAT     = 17;
+const int COMMAND_UINTS   = 5;
+
+void set_instance_count(int region, int object, bool visible)
+{
+	commands[(region * maxObjects + object) * COMMAND_UINTS + 1] = visible ? 1u : 0u;
+}
+
+void main()
+{
+	int object = int(gl_GlobalInvocationID.x);
+	if (object >= objectCount)
+		return;
+
+	int base = object * INSTANCE_FLOATS;
+	mat4 model;
+	for (int c = 0; c < 4; ++c)
+		model[c] = vec4(instances[base + 4 * c], instances[base + 4 * c + 1], instances[base + 4 * c + 2], instances[base + 4 * c + 3]);
+
+	// World-space box around the transformed local box (as culling::BoundingBoxes::Set())
+	vec3 center  = (model * vec4(bounds[2 * object].xyz, 1.0)).xyz;
+	vec3 local   = bounds[2 * object + 1].xyz;
+	vec3 extents = abs(model[0].xyz) * local.x + abs(model[1].xyz) * local.y + abs(model[2].xyz) * local.z;
+
+	uint views = 0u;
+	for (int v = 0; v < viewCount; ++v) {
+		// Outside if the box' corner farthest along a plane's normal is behind it
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; ++p) {
+			vec4 plane = planes[v * 6 + p];
+			inside = dot(plane.xyz, center) + plane.w + dot(abs(plane.xyz), extents) >= 0.0;
+		}
+
+		if (inside)
+			views |= 1u << v;
+		set_instance_count(v, object, inside);
+	}
+	set_instance_count(viewCount, object, views != 0u);
+
+	if (writeFaces != 0)
+		instances[base + FACES_FLOAT] = float(views);
+}
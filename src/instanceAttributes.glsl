@@ -0,0 +1,6 @@
+// The per-instance attributes of vertex shaders, included with @instanceAttributes.glsl
+// (mirrored by instancing::Instance in Instancing.hpp)
+
+layout(location = 4) in mat4 model;
+layout(location = 8) in float instanceDoTexture; // Nonzero textures the object with the shadow-map
+layout(location = 9) in float instanceFaces;     // Bit f set if cube-face f sees the object
@@ -0,0 +1,146 @@
+#version 330
+
+in vec4 vpeye;
+in vec4 vneye;
+in vec4 vpworld;
+in vec2 Texcoord;
+flat in float doTexture;
+
+out vec4 outColor;
+
+// Both samplers are to the shadow-atlas (unit 0), holding the shadow-maps of all lights
+uniform sampler2D shadowMap;
+uniform sampler2DShadow shadowMapS;
+
+#define MAX_LIGHTS 8
+#define POINT_LIGHT 1
+
+struct Light
+{
+	vec4 position;    // world-space, w = type (0 = spot, 1 = point)
+	vec4 color;       // w = range
+	vec4 direction;   // world-space (spot-lights), w = cos(half the cone-angle)
+	vec4 rects[6];    // Atlas-rect of each face (x, y, width, height); width 0 = not shadowed
+	mat4 matrices[6]; // World to the texture-coordinates (and depth) of each face's rect
+};
+
+// Filled by atlas::ShadowAtlas::Pack()
+layout(std140) uniform Lights
+{
+	ivec4 lightCount;
+	Light lights[MAX_LIGHTS];
+};
+
+uniform float atlasTexelSize;
+
+@uniformBlocks.glsl
+
+// If 1, outputs just the shadow-factor of the first light
+uniform int showShadowFactor = 0;
+
+// 0 = MANUAL
+// 1 = SM_HW_PCF
+// 2 = SM_PCF
+// 3 = SM_PCF2
+uniform int samplingType = 0;
+
+// Face of a point-light seeing dir (+X, -X, +Y, -Y, +Z, -Z)
+int cube_face(vec3 dir)
+{
+	vec3 a = abs(dir);
+	if (a.x >= a.y && a.x >= a.z)
+		return dir.x > 0 ? 0 : 1;
+	if (a.y >= a.z)
+		return dir.y > 0 ? 2 : 3;
+	return dir.z > 0 ? 4 : 5;
+}
+
+float shadow_factor(int i, vec3 world)
+{
+	bool isPoint = lights[i].position.w == POINT_LIGHT;
+	int face = isPoint ? cube_face(world - lights[i].position.xyz) : 0;
+
+	vec4 rect = lights[i].rects[face];
+	if (rect.z == 0.0)
+		return 1.0;
+
+	vec4 sc = lights[i].matrices[face] * vec4(world, 1.0);
+	if (sc.w <= 0.0)
+		return 1.0;
+	vec3 p = sc.xyz / sc.w;
+
+	// Outside a spot-light's frustum: no shadow (the faces of point-lights cover everything)
+	if (!isPoint && (any(lessThan(p.xy, rect.xy)) || any(greaterThanEqual(p.xy, rect.xy + rect.zw))))
+		return 1.0;
+
+	// Filtering mustn't reach into the neighbouring shadow-maps
+	vec2 lo = rect.xy + 0.5 * atlasTexelSize;
+	vec2 hi = rect.xy + rect.zw - 0.5 * atlasTexelSize;
+
+	if (samplingType == 0) {
+		// Standard shadow mapping, done manually
+		float shadow = texture(shadowMap, clamp(p.xy, lo, hi)).x;
+		float epsilon = 0.00001;
+		return (shadow + epsilon < p.z) ? 0.0 : 1.0;
+	}
+	if (samplingType == 1) {
+		// Free filtering through the shadow-sampler (with GL_LINEAR)
+		return texture(shadowMapS, vec3(clamp(p.xy, lo, hi), p.z));
+	}
+
+	// Manual 4x PCF (2) or 25x PCF (3)
+	float startstop = (samplingType == 2) ? 1.0 : 2.0;
+	float stepSize  = (samplingType == 2) ? 2.0 : 1.0;
+
+	float sum = 0, count = 0;
+	for (float y = -startstop; y <= startstop; y += stepSize)
+	for (float x = -startstop; x <= startstop; x += stepSize) {
+		vec2 uv = clamp(p.xy + vec2(x, y) * atlasTexelSize, lo, hi);
+		sum += texture(shadowMapS, vec3(uv, p.z));
+		count++;
+	}
+
+	return sum / count;
+}
+
+void main() {
+
+	vec3 fragment = vec3(vpeye);
+	vec3 normal   = vec3(normalize(vneye));
+	vec3 world    = vec3(vpworld);
+
+	vec4 diffColor = vec4(1,1,1,1);
+	if(doTexture != 0) // Textures the cube with the whole atlas
+		diffColor = texture(shadowMap, vec2(Texcoord.x, 1-Texcoord.y));
+
+	vec4 total_lighting = vec4(0.1, 0.1, 0.1, 1.0) * diffColor; // Ambient
+	float firstShadowFactor = 1.0;
+
+	for (int i = 0; i < lightCount.x; ++i) {
+		// Per-fragment diffuse lighting (in eye-space)
+		vec3 positionToLight = vec3(view * vec4(lights[i].position.xyz, 1.0)) - fragment;
+		vec3 lightDir = normalize(positionToLight);
+		float cosAngIncidence = clamp(dot(lightDir, normal), 0, 1);
+
+		// Fades out toward the light's range, and the edge of a spot-light's cone
+		float range = lights[i].color.w;
+		float attenuation = clamp(1.0 - length(positionToLight) / range, 0, 1);
+		attenuation *= attenuation;
+		if (lights[i].position.w != POINT_LIGHT) {
+			float cosAngle = dot(normalize(world - lights[i].position.xyz), lights[i].direction.xyz);
+			attenuation *= smoothstep(lights[i].direction.w, lights[i].direction.w + 0.05, cosAngle);
+		}
+
+		float shadowFactor = 1.0;
+		if (cosAngIncidence * attenuation > 0.0)
+			shadowFactor = shadow_factor(i, world);
+		if (i == 0)
+			firstShadowFactor = shadowFactor;
+
+		total_lighting += diffColor * vec4(lights[i].color.rgb, 1.0) * cosAngIncidence * attenuation * shadowFactor;
+	}
+
+	outColor = vec4(vec3(total_lighting), 1.0);
+	if (showShadowFactor != 0)
+		outColor = vec4(vec3(firstShadowFactor), 1.0);
+}
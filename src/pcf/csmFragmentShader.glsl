@@ -0,0 +1,89 @@
+#version 330
+
+in vec4 vpeye;
+in vec4 vneye;
+in vec4 vpworld;
+in vec2 Texcoord;
+flat in float doTexture;
+
+out vec4 outColor;
+
+// Both samplers are to the same depth-texture array (unit 0), one layer per cascade
+uniform sampler2DArray shadowMap;
+uniform sampler2DArrayShadow shadowMapS;
+
+#define MAX_CASCADES 4
+uniform int cascadeCount;
+uniform float cascadeSplits[MAX_CASCADES]; // Far distance of each cascade
+uniform mat4 cascadeMatrices[MAX_CASCADES];
+
+@uniformBlocks.glsl
+
+// 0 = MANUAL
+// 1 = SM_HW_PCF
+// 2 = SM_PCF
+// 3 = SM_PCF2
+uniform int samplingType = 0;
+
+void main() {
+
+	vec3 fragment = vec3(vpeye);
+	vec3 normal   = vec3(normalize(vneye));
+
+	/* Shadows */
+	float shadowFactor = 1.0;
+
+	// Pick the first cascade reaching past the fragment
+	int cascade = 0;
+	while (cascade < cascadeCount && -fragment.z > cascadeSplits[cascade])
+		cascade++;
+
+	if (cascade < cascadeCount) {
+		// Orthographic, so no divide by w
+		vec3 sc = vec3(cascadeMatrices[cascade] * vpworld) * 0.5 + 0.5;
+		float layer = float(cascade);
+
+		if(samplingType == 0) {
+			// Standard shadow mapping, done manually
+			float shadow = texture(shadowMap, vec3(sc.xy, layer)).x;
+			float epsilon = 0.00001;
+			if (shadow + epsilon < sc.z) shadowFactor = 0.0;
+		}
+		else if(samplingType == 1) {
+			// Free filtering through the shadow-sampler (with GL_LINEAR)
+			shadowFactor = texture(shadowMapS, vec4(sc.xy, layer, sc.z));
+		}
+		else {
+			// Manual 4x PCF (2) or 25x PCF (3)
+			vec2 texmapscale = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+			float startstop = (samplingType == 2) ? 1.0 : 2.0;
+			float stepSize  = (samplingType == 2) ? 2.0 : 1.0;
+
+			float sum = 0, count = 0;
+			for (float y = -startstop; y <= startstop; y += stepSize)
+			for (float x = -startstop; x <= startstop; x += stepSize) {
+				vec2 offset = vec2(x, y) * texmapscale;
+				sum += texture(shadowMapS, vec4(sc.xy + offset, layer, sc.z));
+				count++;
+			}
+
+			shadowFactor = sum / count;
+		}
+	}
+
+	/* Per-fragment diffuse lighting (directional) */
+	vec4 diffColor = vec4(1,1,1,1);
+	if(doTexture != 0) // Textures the cube with the first cascade
+		diffColor = texture(shadowMap, vec3(Texcoord.x, 1-Texcoord.y, 0));
+
+	vec3 lightDirEye = normalize(vec3(view * vec4(-lightDir, 0.0)));
+	float cosAngIncidence = clamp(dot(lightDirEye, normal), 0, 1);
+
+	vec4 diffuse = diffColor * cosAngIncidence;
+
+	vec4 total_lighting = vec4(0.0);
+	total_lighting += vec4(0.1, 0.1, 0.1, 1.0) * diffColor; // Ambient
+	total_lighting += diffuse * shadowFactor; // Diffuse
+
+	outColor = vec4(vec3(total_lighting), 1.0);
+}
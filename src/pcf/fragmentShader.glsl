@@ -3,6 +3,7 @@
 in vec4 vpeye;
 in vec4 vneye;
 in vec2 Texcoord;
+flat in float doTexture;
 in vec4 sc;
 
 out vec4 outColor;
@@ -11,9 +12,10 @@ out vec4 outColor;
 uniform sampler2D shadowMap;
 uniform sampler2DShadow shadowMapS;
 
-uniform mat4 view;
-uniform vec3 lightPos;
-uniform float doTexture;
+@uniformBlocks.glsl
+
+// If 1, outputs just the shadow-factor (to compare against the CPU-reference)
+uniform int showShadowFactor = 0;
 
 // 0 = MANUAL
 // 1 = SM_HW_PCF
@@ -110,9 +112,11 @@ void main() {
 	attenuation = 1.0 / (light0.constantAttenuation + light0.linearAttenuation * length(positionToLight) + light0.quadraticAttenuation * pow(length(positionToLight),2));
 	vec4 diffuse  = diffColor * light0.diffuse  * cosAngIncidence * attenuation;
 
-	vec4 total_lighting;
+	vec4 total_lighting = vec4(0.0);
 	total_lighting += vec4(0.1, 0.1, 0.1, 1.0) * diffColor; // Ambient
 	total_lighting += diffuse * shadowFactor; // Diffuse
 
    outColor = vec4(vec3(total_lighting), 1.0);
+   if (showShadowFactor != 0)
+   	outColor = vec4(vec3(shadowFactor), 1.0);
 }
\ No newline at end of file
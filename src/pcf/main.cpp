@@ -1,11 +1,33 @@
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include "Common.hpp"
 #include "OpenGL.hpp"
 #include "ShaderProgram.hpp"
+#include "Cascades.hpp"
+#include "Atlas.hpp"
+#include "ShadowCache.hpp"
+#include "UniformBlocks.hpp"
+#include "Instancing.hpp"
+#include "Culling.hpp"
+#include "GLState.hpp"
+#include "Resources.hpp"
+#include "RenderGraph.hpp"
 
-#define SHADOWMAP_SIZE 512
+// Shadow-map resolution (--shadowmap-size overrides it)
+static GLuint SHADOWMAP_SIZE = 512;
+
+// If 1, uses cascaded shadow maps for a directional light (shining from lightPos toward cubePos)
+#define CASCADED_SHADOWS 0
+
+// If 1, adds more spot- and point-lights, all shadowed through one shadow-atlas (see Atlas.hpp).
+// SHADOWMAP_SIZE is then the largest resolution a light gets, in an atlas four times as wide.
+#define SHADOW_ATLAS 0
+
+// If 1, the cube bobs up and down: a dynamic caster drawn over the cached shadow of the plane
+#define ANIMATE_CUBE 0
 
 // Window-size
 static const int WIDTH  = 1280;
@@ -20,125 +42,425 @@ static glm::vec3 planeScale(7,1,7); // It's a scaled cube
 // Resources
 static ShaderProgram program, shadowProgram;
 static Mesh cubeMesh, quadMesh;
-static GLuint shadowMapFBO, shadowMapTex, shadowMapTexDepth;
+
+// Shadow-map or cascades, and their FBOs (deleted at once before the context, see Resources.hpp)
+static struct Targets
+{
+	resource::Texture     shadowMapTex;
+	resource::Framebuffer shadowMapFBO;
+#if CASCADED_SHADOWS
+	resource::Texture     cascadeTex;
+	resource::Framebuffer cascadeFBOs[cascades::MAX_CASCADES];
+#endif
+} targets;
+
+// The passes of a frame and what they read and write (see RenderGraph.hpp)
+static rendergraph::Graph frameGraph;
+
+// Camera and light, shared by both programs (see UniformBlocks.hpp)
+static blocks::FrameUniforms frameUniforms;
+
+// Objects, drawn instanced from their transforms (see Instancing.hpp).
+// The casters come first, so all of them are one range.
+static instancing::InstanceBuffer instances;
+enum { CUBE_OBJECT, PLANE_OBJECT, LIGHT_OBJECTS }; // One light-box per light
+static const int MAX_OBJECTS = LIGHT_OBJECTS + atlas::MAX_LIGHTS;
+
+static constexpr UniformName cameraToShadowProjectorUniform("cameraToShadowProjector");
+
+// Re-renders the shadow-map only when something in it moved (--no-shadow-cache turns it off)
+static shadowcache::Tracker shadowTracker;
+static shadowcache::StaticBase shadowBase;
+static bool shadowCache = true;
+#if CASCADED_SHADOWS
+static cascades::Cascades shadowCascades;
+
+// Count, split-lambda, shadow-distance, caster-margin, resolution
+static cascades::Settings cascadeSettings = { 4, 0.75f, 30.0f, 20.0f, (GLsizei) SHADOWMAP_SIZE };
+#endif
+#if SHADOW_ATLAS
+static atlas::ShadowAtlas shadowAtlas;
+static std::vector<atlas::Light> lights;
+
+// Atlas-size, smallest and largest resolution of a light
+static atlas::Settings atlasSettings = { 4 * (GLsizei) SHADOWMAP_SIZE, 64, (int) SHADOWMAP_SIZE };
+
+// Bounds of the casters, classified against every shadow-map of the atlas (see Culling.hpp)
+static culling::Culler casterCuller;
+static_assert(atlas::MAX_LIGHTS * 6 <= culling::MAX_VIEWS, "Every shadow-map of the atlas must be a view of the culler");
+#endif
 
 static char* samplingTypeText[] = {"Manual", "Free HW PCF", "Manual 4x PCF", "Manual ?x PCF (see shader)"};
 static GLint samplingType = 0;
+static bool showShadowFactor = false;
 
-static void set_shadow_matrix_uniform(ShaderProgram &prog)
+static glm::mat4 camera_view_matrix()
+{
+	return glm::lookAt(glm::vec3(0,5,0), glm::vec3(0, 0, -5), glm::vec3(0,1,0));
+}
+
+#if SHADOW_ATLAS
+// The demo's light (lightPos, shining on the cube), another spot-light and two point-lights
+static void create_lights()
+{
+	atlas::Light light;
+	light.type     = atlas::SPOT;
+	light.position = lightPos;
+	light.target   = cubePos;
+	light.fovy     = 60.0f;
+	light.range    = 10.0f;
+	light.color    = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.push_back(light);
+
+	light.position = glm::vec3(4.0f, 3.0f, -9.0f);
+	light.color    = glm::vec3(0.3f, 0.3f, 0.8f);
+	lights.push_back(light);
+
+	light.type     = atlas::POINT;
+	light.position = glm::vec3(1.5f, 1.0f, -4.0f);
+	light.range    = 6.0f;
+	light.color    = glm::vec3(0.8f, 0.4f, 0.2f);
+	lights.push_back(light);
+
+	light.position = glm::vec3(-3.0f, 1.0f, -9.0f);
+	light.color    = glm::vec3(0.2f, 0.7f, 0.3f);
+	lights.push_back(light);
+}
+
+// Circles the first point-light around the cube
+static void update_lights()
+{
+	float t = (float) frame_time();
+	lights[2].position = cubePos + glm::vec3(2.0f * std::cos(t), 1.0f, 2.0f * std::sin(t));
+}
+#endif
+
+static glm::mat4 shadow_matrix()
 {
 	glm::mat4 mat;
 	mat *= glm::perspective(60.0f, 1.0f, 1.0f, 10.0f);
 	mat *= glm::lookAt(lightPos, cubePos, glm::vec3(0,1,0)); // Point toward object regardless of position
-	prog.UpdateUniform("cameraToShadowProjector", mat);
+	return mat;
 }
 
-static void draw_cubes(ShaderProgram &program, bool shadowpass)
+#if !CASCADED_SHADOWS && !SHADOW_ATLAS
+// Of the single shadow-map (cascades and atlas-lights set their own)
+static void set_shadow_matrix_uniform(ShaderProgram &prog)
 {
-	glBindVertexArray(cubeMesh.vao);
+	prog.UpdateUniform(cameraToShadowProjectorUniform, shadow_matrix());
+}
+#endif
 
-	glm::mat4 model;
+static glm::mat4 cube_model_matrix()
+{
+#if ANIMATE_CUBE
+	return glm::translate(glm::mat4(), cubePos + glm::vec3(0.0f, 0.5f * (float) std::sin(2.0 * frame_time()), 0.0f));
+#else
+	return glm::translate(glm::mat4(), cubePos);
+#endif
+}
 
-	if(!shadowpass) {
-		// Draw shadowmap-texture on cube
-		program.UpdateUniform("doTexture", 1.0f);
-	}
+static glm::mat4 plane_model_matrix()
+{
+	glm::mat4 model = glm::translate(glm::mat4(), planePos);
+	return glm::scale(model, planeScale);
+}
 
-	// Draw cube
-	model = glm::translate(glm::mat4(), cubePos);
-	program.UpdateUniform("model", model);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
+static glm::mat4 light_box_matrix(const glm::vec3& position)
+{
+	glm::mat4 model = glm::translate(glm::mat4(), position);
+	return glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
+}
 
-	if(!shadowpass) {
-		// Don't texture anything else with the shadowmap
-		program.UpdateUniform("doTexture", 0.0f);
-	}
+// Uploads the camera, the light and all objects' transforms for this frame
+static void update_uniform_blocks()
+{
+#if SHADOW_ATLAS
+	update_lights();
+#endif
+
+	blocks::FrameData frame = blocks::FrameData();
+	frame.view = camera_view_matrix();
+	frame.proj = glm::perspective((float) 45, (float) WIDTH / (float) HEIGHT, 0.1f, 100.0f);
+	frame.shadowMatrix = shadow_matrix();
+	frame.lightPos = lightPos;
+	frame.lightDir = glm::normalize(cubePos - lightPos);
+	frameUniforms.Update(frame);
+
+	// Only the cube is textured with the shadowmap
+	instances.Set(CUBE_OBJECT, cube_model_matrix(), 1.0f);
+	instances.Set(PLANE_OBJECT, plane_model_matrix());
+#if SHADOW_ATLAS
+	casterCuller.SetBounds(CUBE_OBJECT, cube_model_matrix(), cubeMesh.boundsMin, cubeMesh.boundsMax);
+	casterCuller.SetBounds(PLANE_OBJECT, plane_model_matrix(), cubeMesh.boundsMin, cubeMesh.boundsMax);
+	for (size_t i = 0; i < lights.size(); ++i)
+		instances.Set(LIGHT_OBJECTS + (int) i, light_box_matrix(lights[i].position));
+#else
+	instances.Set(LIGHT_OBJECTS, light_box_matrix(lightPos));
+#endif
+	instances.Upload();
+
+#if CASCADED_SHADOWS
+	// Fit the cascades to the camera's view
+	shadowCascades = cascades::Fit(cascadeSettings, camera_view_matrix(), 45.0f, (float) WIDTH / (float) HEIGHT, 0.1f,
+		glm::normalize(cubePos - lightPos));
+#endif
+}
 
-	// Draw plane
-	model = glm::translate(glm::mat4(), planePos);
-	model = glm::scale(model, planeScale);
-	program.UpdateUniform("model", model);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-
-	// Light-box
-	if(!shadowpass) { // Don't want it covering the light (casting shadows everywhere)
-		model = glm::translate(glm::mat4(), lightPos);
-		model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-		program.UpdateUniform("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-	}
+static int light_count()
+{
+#if SHADOW_ATLAS
+	return (int) lights.size();
+#else
+	return 1;
+#endif
+}
 
-	glBindVertexArray(0);
+static void draw_cubes(bool shadowpass)
+{
+	// Cube and plane
+	instances.Draw(cubeMesh, CUBE_OBJECT, LIGHT_OBJECTS, shadowpass);
+
+	// Light-boxes
+	if(!shadowpass) // Don't want them covering the lights (casting shadows everywhere)
+		instances.Draw(cubeMesh, LIGHT_OBJECTS, light_count());
 }
 
 static void draw_normal_pass()
 {
-	glBindFramebuffer (GL_FRAMEBUFFER, 0);
 	program.UseProgram();
-
-	glViewport(0, 0, WIDTH,HEIGHT);
-	glCullFace(GL_BACK);
+	glstate::CullFace(GL_BACK);
 
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glm::mat4 proj = glm::perspective((float) 45, (float) WIDTH / (float) HEIGHT, 0.1f, 100.0f);
-	glm::mat4 view = glm::lookAt(glm::vec3(0,5,0), glm::vec3(0, 0, -5), glm::vec3(0,1,0));
-
-	// Upload model and view
-	program.UpdateUniform("view", view);
-	program.UpdateUniform("proj", proj);
-	program.UpdateUniform("lightPos", lightPos);
+	// Camera and light are in the Frame-block
 	program.UpdateUniformi("samplingType", samplingType);
+	program.UpdateUniformi("showShadowFactor", showShadowFactor ? 1 : 0);
+
+#if CASCADED_SHADOWS
+	cascades::SetUniforms(program, shadowCascades);
+	glstate::BindTexture(GL_TEXTURE_2D_ARRAY, targets.cascadeTex.Get());
+#elif SHADOW_ATLAS
+	shadowAtlas.SetUniforms(program);
+	glstate::BindTexture(GL_TEXTURE_2D, shadowAtlas.GetTexture());
+#else
+	glstate::BindTexture(GL_TEXTURE_2D, targets.shadowMapTex.Get());
+#endif
+	draw_cubes(false /*not shadowpass*/);
+}
+
+#if CASCADED_SHADOWS
+// Draws a cascade (to its layer, bound)
+static void draw_shadow_pass(int cascade)
+{
+	glstate::CullFace(GL_FRONT);
+	shadowProgram.UseProgram();
 
-	set_shadow_matrix_uniform(program);
-	draw_cubes(program, false /*not shadowpass*/);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	shadowProgram.UpdateUniform(cameraToShadowProjectorUniform, shadowCascades.matrices[cascade]);
+	draw_cubes(true /*shadowpass*/);
 }
 
+static bool build_frame_graph()
+{
+	rendergraph::Resource screen = frameGraph.Import("screen", 0, 0, screen_framebuffer(), WIDTH, HEIGHT);
+	rendergraph::Resource layers[cascades::MAX_CASCADES];
+
+	for (int i = 0; i < cascadeSettings.count; ++i) {
+		layers[i] = frameGraph.Import("cascade", 0, targets.cascadeTex.Get(), targets.cascadeFBOs[i].Get(), SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+		frameGraph.AddPass("shadow", [i](const rendergraph::Context&) { draw_shadow_pass(i); }).RenderTo(layers[i]);
+	}
+
+	rendergraph::Pass& normal = frameGraph.AddPass("normal", [](const rendergraph::Context&) { draw_normal_pass(); });
+	normal.RenderTo(screen);
+	for (int i = 0; i < cascadeSettings.count; ++i)
+		normal.Read(layers[i]);
+
+	return frameGraph.Compile();
+}
+#elif SHADOW_ATLAS
+// Draws the shadow-maps of all lights (to the atlas, bound)
 static void draw_shadow_pass()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+	// Resolutions follow the lights' sizes on screen, so they're repacked every frame
+	// (after update_uniform_blocks() moved them)
+	shadowAtlas.Pack(lights, camera_view_matrix(), 45.0f);
 
-	glCullFace(GL_FRONT);
-	glViewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+	// One clear for all lights, then a viewport per shadow-map
 	glClear(GL_DEPTH_BUFFER_BIT);
 
+	glstate::CullFace(GL_FRONT);
+	shadowProgram.UseProgram();
+
+	// Each shadow-map draws only the casters it sees (a point-light's faces each see a part)
+	const std::vector<atlas::Face>& faces = shadowAtlas.GetFaces();
+	std::vector<glm::mat4> matrices;
+	for (size_t i = 0; i < faces.size(); ++i)
+		matrices.push_back(faces[i].matrix);
+	casterCuller.Cull(matrices.data(), (int) matrices.size());
+
+	for (size_t i = 0; i < faces.size(); ++i) {
+		const std::vector<int>& casters = casterCuller.GetDrawList((int) i);
+		if (casters.empty())
+			continue; // Left as cleared
+
+		glstate::Viewport(faces[i].rect.x, faces[i].rect.y, faces[i].rect.size, faces[i].rect.size);
+		shadowProgram.UpdateUniform(cameraToShadowProjectorUniform, faces[i].matrix);
+		instances.DrawList(cubeMesh, casters.data(), (int) casters.size(), true /*shadowpass*/);
+	}
+}
+
+static bool build_frame_graph()
+{
+	rendergraph::Resource screen = frameGraph.Import("screen", 0, 0, screen_framebuffer(), WIDTH, HEIGHT);
+	rendergraph::Resource atlas = frameGraph.Import("shadow-atlas", 0, shadowAtlas.GetTexture(), shadowAtlas.GetFramebuffer(),
+		atlasSettings.size, atlasSettings.size);
+
+	frameGraph.AddPass("shadow", [](const rendergraph::Context&) { draw_shadow_pass(); }).RenderTo(atlas);
+	frameGraph.AddPass("normal", [](const rendergraph::Context&) { draw_normal_pass(); }).Read(atlas).RenderTo(screen);
+	return frameGraph.Compile();
+}
+#else
+// The casters of the shadow-map: the plane is static, and so is the cube unless ANIMATE_CUBE
+static const bool cubeIsStatic = !ANIMATE_CUBE;
+
+static void draw_casters(bool statics)
+{
+	// The cube and then the plane, so either is a range with the other
+	int first = (cubeIsStatic == statics) ? CUBE_OBJECT : PLANE_OBJECT;
+	int last  = statics ? PLANE_OBJECT : CUBE_OBJECT;
+	instances.Draw(cubeMesh, first, last - first + 1, true /*shadowpass*/);
+}
+
+static void draw_shadow_pass()
+{
+	shadowTracker.Begin(shadow_matrix());
+	shadowTracker.AddCaster(0, cube_model_matrix(), cubeIsStatic);
+	shadowTracker.AddCaster(1, plane_model_matrix(), true);
+	if (!shadowCache)
+		shadowTracker.Invalidate();
+
+	shadowcache::Update update = shadowTracker.End();
+	if (update == shadowcache::NONE)
+		return; // Last frame's shadow-map is still valid
+
+	glstate::CullFace(GL_FRONT);
+	glstate::Viewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+
 	shadowProgram.UseProgram();
 	set_shadow_matrix_uniform(shadowProgram);
 
-	draw_cubes(shadowProgram, true /*shadowpass*/);
+	if (update == shadowcache::ALL) {
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, targets.shadowMapFBO.Get());
+		glClear(GL_DEPTH_BUFFER_BIT);
+		draw_casters(true /*statics*/);
+
+		if (shadowTracker.HasDynamic())
+			shadowBase.Store(targets.shadowMapFBO.Get());
+	}
+	else {
+		shadowBase.Restore(targets.shadowMapFBO.Get());
+	}
+
+	if (shadowTracker.HasDynamic())
+		draw_casters(false /*dynamics*/);
 }
 
-int main()
+// The shadow-map is kept, as the shadow-cache re-renders it only when something moved
+static bool build_frame_graph()
+{
+	rendergraph::Resource screen = frameGraph.Import("screen", 0, 0, screen_framebuffer(), WIDTH, HEIGHT);
+	rendergraph::Resource shadowMap = frameGraph.Import("shadow-map", 0, targets.shadowMapTex.Get(), targets.shadowMapFBO.Get(),
+		SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+
+	frameGraph.AddPass("shadow", [](const rendergraph::Context&) { draw_shadow_pass(); }).Write(shadowMap);
+	frameGraph.AddPass("normal", [](const rendergraph::Context&) { draw_normal_pass(); }).Read(shadowMap).RenderTo(screen);
+	return frameGraph.Compile();
+}
+#endif
+
+int main(int argc, char* argv[])
 {
 	GLFWwindow* window = nullptr;
+	Options options = parse_options(argc, argv);
 
 	// Set up OpenGL-context
-	if (!init_opengl(WIDTH, HEIGHT, &window)){
+	if (!init_opengl(WIDTH, HEIGHT, &window, options)){
 		std::cout << "Error setting up OpenGL-context.\n";
 		return -1;
 	}
 
-	// Create programs
-	if (!program.Load(ShaderInfo::VSFS("pcf/vertexShader.glsl", "pcf/fragmentShader.glsl")))
-		return false;
-	if (!shadowProgram.Load(ShaderInfo::VSFS("pcf/shadowVertexShader.glsl", "pcf/shadowFragmentShader.glsl")))
+	// Settings from the command-line
+	if (options.shadowMapSize > 0)
+		SHADOWMAP_SIZE = options.shadowMapSize;
+	if (options.samplingType >= 0)
+		samplingType = options.samplingType % 4;
+	shadowCache = options.shadowCache;
+#if CASCADED_SHADOWS
+	cascadeSettings.resolution = SHADOWMAP_SIZE;
+#endif
+#if SHADOW_ATLAS
+	atlasSettings.size = 4 * SHADOWMAP_SIZE;
+	atlasSettings.maxResolution = SHADOWMAP_SIZE;
+#endif
+	printf("Using sampling type: %d (%s)\n", samplingType, samplingTypeText[samplingType]);
+
+	// Create programs (all started before waiting for any, so they're compiled in parallel)
+#if CASCADED_SHADOWS
+	program.LoadAsync(ShaderInfo::VSFS("pcf/csmVertexShader.glsl", "pcf/csmFragmentShader.glsl"));
+#elif SHADOW_ATLAS
+	program.LoadAsync(ShaderInfo::VSFS("pcf/csmVertexShader.glsl", "pcf/atlasFragmentShader.glsl"));
+#else
+	program.LoadAsync(ShaderInfo::VSFS("pcf/vertexShader.glsl", "pcf/fragmentShader.glsl"));
+#endif
+	shadowProgram.LoadAsync(ShaderInfo::VSFS("pcf/shadowVertexShader.glsl", "pcf/shadowFragmentShader.glsl"));
+	if (!program.Finish() || !shadowProgram.Finish())
 		return false;
+	showShadowFactor = options.shadowFactor;
+
+	// Uniform-buffers
+	if (!blocks::SetBindings(program) || !blocks::SetBindings(shadowProgram))
+		return -1;
+	frameUniforms.Load();
+	instances.Load(MAX_OBJECTS);
 
 	// Geometry
 	cubeMesh = create_cube();
+	instances.Attach(cubeMesh);
+
+#if CASCADED_SHADOWS
+	// Cascades (one layer each) and an FBO per cascade
+	targets.cascadeTex.Reset(texture::Create2DArray(GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE, cascadeSettings.count, GL_DEPTH_COMPONENT, GL_FLOAT));
+	texture::SetDepthCompare(GL_TEXTURE_2D_ARRAY, targets.cascadeTex.Get());
 
+	for (int i = 0; i < cascadeSettings.count; ++i)
+		targets.cascadeFBOs[i].Reset(texture::FramebufferLayer(-1, targets.cascadeTex.Get(), i));
+
+	print_shadow_memory(texture::MemorySize(GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE, cascadeSettings.count));
+#elif SHADOW_ATLAS
+	// One texture and FBO for all lights
+	if (!shadowAtlas.Load(atlasSettings))
+		return -1;
+	create_lights();
+	casterCuller.Resize(LIGHT_OBJECTS);
+
+	print_shadow_memory(shadowAtlas.MemorySize());
+#else
 	// ShadowMap-texture
-	shadowMapTex = texture::Create2D(GL_DEPTH_COMPONENT, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_DEPTH_COMPONENT, GL_FLOAT);
+	targets.shadowMapTex.Reset(texture::Create2D(GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_DEPTH_COMPONENT, GL_FLOAT));
+	GLuint shadowMapTex = targets.shadowMapTex.Get();
 	texture::SetFiltering2D(shadowMapTex, texture::Filtering::LINEAR);
 	texture::SetWrapMode2D(shadowMapTex, texture::WrapMode::ClampBorder, 1.0f);
 
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	texture::SetDepthCompare(GL_TEXTURE_2D, shadowMapTex);
 
 	// ShadowMap-FBO
+	GLuint shadowMapFBO;
 	glGenFramebuffers(1, &shadowMapFBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+	targets.shadowMapFBO.Reset(shadowMapFBO);
+	glstate::BindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowMapTex, 0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
@@ -147,26 +469,44 @@ int main()
 		 printf ("ERROR: Framebuffer not complete.\n");
 		 return -1;	
 	}
-	glBindFramebuffer (GL_FRAMEBUFFER, 0);
+	glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// Copy of the shadow-map with just the static casters, for when only dynamic ones move
+	size_t shadowMemory = texture::MemorySize(GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+	if (!cubeIsStatic) {
+		if (!shadowBase.Load(SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_DEPTH_COMPONENT24))
+			return -1;
+		shadowMemory += shadowBase.MemorySize();
+	}
+
+	print_shadow_memory(shadowMemory);
+#endif
 
-	glEnable(GL_DEPTH_TEST);
+	if (!build_frame_graph())
+		return -1;
+	frameGraph.Print();
+
+	glstate::Enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	glstate::Enable(GL_CULL_FACE);
+	glstate::CullFace(GL_BACK);
 	glFrontFace(GL_CW);
 
-	printf("Press space to switch sampling-mode.\n");
+	printf("Press space to switch sampling-mode, R to reload the shaders.\n");
 
-	while (!glfwWindowShouldClose(window))
+	while (begin_frame(window))
 	{
-		draw_shadow_pass();
-		draw_normal_pass();
+		// Reloaded programs replace the current ones once they're linked, which draw until then
+		program.IsReady();
+		shadowProgram.IsReady();
+
+		update_uniform_blocks();
+		frameGraph.Execute();
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		end_frame(window);
 
-		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-			break;
+		if (!window)
+			continue; // No keyboard when headless
 
 		// Switches between sampling modes
 		static bool lastState = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
@@ -176,19 +516,32 @@ int main()
 			printf("Using sampling type: %d (%s)\n", samplingType, samplingTypeText[samplingType]);
 		}
 		lastState = thisState;
+
+		static bool lastReload = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+		bool thisReload = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+		if (lastReload != thisReload && thisReload) {
+			program.ReloadAsync();
+			shadowProgram.ReloadAsync();
+		}
+		lastReload = thisReload;
 	}
 
 	program.DeleteProgram();
 	shadowProgram.DeleteProgram();
+	frameUniforms.Delete();
+	instances.Delete();
 
 	delete_mesh(cubeMesh);
 	delete_mesh(quadMesh);
 
-	glDeleteFramebuffers(1, &shadowMapFBO);
-	glDeleteTextures(1, &shadowMapTex);
-	glDeleteTextures(1, &shadowMapTexDepth);
+	targets = Targets();
+#if SHADOW_ATLAS
+	shadowAtlas.Delete();
+#elif !CASCADED_SHADOWS
+	shadowBase.Delete();
+#endif
 
-	glfwTerminate();
+	shutdown_opengl();
 
 	return 0;
 }
\ No newline at end of file
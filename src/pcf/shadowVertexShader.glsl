@@ -2,8 +2,10 @@
 
 layout(location = 0) in vec3 position;
 
+@uniformBlocks.glsl
+@instanceAttributes.glsl
+
 uniform mat4 cameraToShadowProjector;
-uniform mat4 model;
 
 void main() {
 	gl_Position = cameraToShadowProjector * model * vec4(position, 1.0);
@@ -8,9 +8,10 @@ out vec4 vneye;
 out vec4 vpeye;
 out vec4 sc;
 out vec2 Texcoord;
+flat out float doTexture;
 
-uniform mat4 cameraToShadowProjector;
-uniform mat4 model, view, proj;
+@uniformBlocks.glsl
+@instanceAttributes.glsl
 
 const mat4 bias = mat4(	0.5, 0.0, 0.0, 0.0,
 						0.0, 0.5, 0.0, 0.0,
@@ -19,8 +20,9 @@ const mat4 bias = mat4(	0.5, 0.0, 0.0, 0.0,
 
 void main() {
 	Texcoord = texcoord;
+	doTexture = instanceDoTexture;
 	gl_Position = proj * view * model * vec4(position, 1.0f);
 	vneye = view * model * vec4(normal,   0.0f);
 	vpeye = view * model * vec4(position, 1.0);
-	sc = bias * cameraToShadowProjector * model * vec4(position, 1.0f);
+	sc = bias * shadowMatrix * model * vec4(position, 1.0f);
 }
\ No newline at end of file
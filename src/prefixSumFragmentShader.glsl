@@ -0,0 +1,22 @@
+#version 330
+
+// One step of an inclusive prefix sum along Axis (0 = x, 1 = y).
+// Run with Step = 1, 2, 4, ... while Step < size.
+uniform sampler2D textureSource;
+uniform int Axis;
+uniform int Step;
+uniform vec4 Bias; // Subtracted in the first step
+
+out vec4 outColor;
+
+void main()
+{
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	ivec2 q = p;
+	q[Axis] -= Step;
+
+	vec4 sum = texelFetch( textureSource, p, 0 ) - Bias;
+	if (q[Axis] >= 0)
+		sum += texelFetch( textureSource, q, 0 ) - Bias;
+	outColor = sum;
+};
@@ -0,0 +1,124 @@
+// Renders the shadow-factor of a demo's scene on the CPU (see Reference.hpp), and compares it
+// against what the demo renders with --shadow-factor. No GPU (or GL-context) is needed here,
+// so it also runs where the demos themselves only run on a software-rasterizer. E.g.:
+//
+//   "Normal with PCF" --headless --frames 1 --shadow-factor --sampling 1 --dump pcf.ppm
+//   Reference --technique pcf --sampling 1 --compare pcf.ppm
+//
+// The scenes are in ReferenceScenes.hpp (src/referencetest checks them against ray-traced shadows).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Blur.hpp"
+#include "Reference.hpp"
+#include "ReferenceScenes.hpp"
+
+using namespace reference;
+
+struct Settings
+{
+	SceneSettings scene;
+	std::string   outFile;
+	std::string   compareFile;
+	float         tolerance;
+	float         maxMismatch; // Percent of the compared pixels
+};
+
+static double ms_since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void usage()
+{
+	printf("Usage: Reference [options]\n"
+		"  --technique pcf|vsm|vsmcube\n"
+		"  --width N, --height N   size of the image (default 1280x720, as the demos)\n"
+		"  --shadowmap-size N      (default 512)\n"
+		"  --sampling N            PCF-filter (0-3)\n"
+		"  --blur-radius N         VSM-blur radius (default 6 for vsm, 3 for vsmcube)\n"
+		"  --frame N               frame of a headless run (the light moves in vsmcube)\n"
+		"  --out file.pgm          writes the shadow-factors\n"
+		"  --compare file.ppm      compares against a demo's --shadow-factor --dump\n"
+		"  --tolerance T           largest difference of a matching pixel (default 0.1)\n"
+		"  --max-mismatch P        percent of pixels allowed not to match (default 1)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	Settings settings;
+	settings.tolerance     = 0.1f;
+	settings.maxMismatch   = 1.0f;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--technique" && hasValue)
+			settings.scene.technique = argv[++i];
+		else if (arg == "--width" && hasValue)
+			settings.scene.width = atoi(argv[++i]);
+		else if (arg == "--height" && hasValue)
+			settings.scene.height = atoi(argv[++i]);
+		else if (arg == "--shadowmap-size" && hasValue)
+			settings.scene.shadowMapSize = atoi(argv[++i]);
+		else if (arg == "--sampling" && hasValue)
+			settings.scene.samplingType = atoi(argv[++i]) % 4;
+		else if (arg == "--blur-radius" && hasValue)
+			settings.scene.blurRadius = std::min(atoi(argv[++i]), blur::MAX_RADIUS);
+		else if (arg == "--frame" && hasValue)
+			settings.scene.frame = atoi(argv[++i]);
+		else if (arg == "--out" && hasValue)
+			settings.outFile = argv[++i];
+		else if (arg == "--compare" && hasValue)
+			settings.compareFile = argv[++i];
+		else if (arg == "--tolerance" && hasValue)
+			settings.tolerance = (float)atof(argv[++i]);
+		else if (arg == "--max-mismatch" && hasValue)
+			settings.maxMismatch = (float)atof(argv[++i]);
+		else {
+			usage();
+			return arg == "--help" ? 0 : -1;
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	Image factors;
+	if (!RenderScene(settings.scene, factors)) {
+		usage();
+		return -1;
+	}
+
+	printf("Rendered %s (%dx%d, shadowmap %d) in %.1f ms\n", settings.scene.technique.c_str(),
+		settings.scene.width, settings.scene.height, settings.scene.shadowMapSize, ms_since(start));
+
+	if (!settings.outFile.empty() && WritePGM(settings.outFile, factors))
+		printf("Wrote %s\n", settings.outFile.c_str());
+
+	if (settings.compareFile.empty())
+		return 0;
+
+	Image image;
+	if (!ReadPNM(settings.compareFile, image))
+		return -1;
+	if (image.width != factors.width || image.height != factors.height) {
+		fprintf(stderr, "'%s' is %dx%d, expected %dx%d\n", settings.compareFile.c_str(),
+			image.width, image.height, factors.width, factors.height);
+		return -1;
+	}
+
+	Difference diff = Compare(factors, image, settings.tolerance);
+	double mismatchPercent = diff.pixels ? 100.0 * diff.mismatches / diff.pixels : 0.0;
+	bool ok = mismatchPercent <= settings.maxMismatch;
+
+	printf("%d pixels compared, %d (%.3f%%) differ by more than %.3f; max error %.4f, mean error %.5f: %s\n",
+		diff.pixels, diff.mismatches, mismatchPercent, settings.tolerance, diff.maxError, diff.meanError,
+		ok ? "OK" : "MISMATCH");
+
+	return ok ? 0 : 1;
+}
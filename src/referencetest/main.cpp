@@ -0,0 +1,130 @@
+// Test of the CPU-reference (see ReferenceScenes.hpp), which needs no GPU: each demo's scene is
+// rendered at 1024x1024 and compared with its shadows ray-traced toward the light. Exits with 1
+// if any case differs by more than its tolerance, so it can run as a test, e.g. after building:
+//
+//   ReferenceTest
+//
+// Where a demo runs, the Reference tool compares it with the CPU-reference in turn (see src/reference).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Reference.hpp"
+#include "ReferenceScenes.hpp"
+
+using namespace reference;
+
+static const int SIZE = 1024;
+
+struct Case
+{
+	const char* technique;
+	int         samplingType;
+	int         frame;
+	float       maxMismatch; // Percent of the compared pixels
+};
+
+// The shadow-maps' texels and filtering move the shadows' edges a little, and VSM bleeds light near
+// them (most in vsmcube, whose blur is within each face), so some pixels differ from the rays
+static const Case cases[] = {
+	{ "pcf",     0, 0,  0.25f },
+	{ "pcf",     1, 0,  0.25f },
+	{ "pcf",     2, 0,  0.25f },
+	{ "pcf",     3, 0,  0.25f },
+	{ "vsm",     0, 0,  0.25f },
+	{ "vsmcube", 0, 0,  1.5f },
+	{ "vsmcube", 0, 45, 1.5f },
+};
+
+// A shadow-factor (0 or 1) is "the same" if it's off by less than this
+static const float TOLERANCE = 0.5f;
+
+static double ms_since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Whether the segment from a point on a surface to the light crosses a triangle (Moller-Trumbore).
+// The first bit of it is skipped, so the surface doesn't shadow itself.
+static bool blocked(const std::vector<glm::vec3>& triangles, const glm::vec3& from, const glm::vec3& to)
+{
+	glm::vec3 dir = to - from;
+	float start = 1e-4f / glm::length(dir);
+
+	for (size_t i = 0; i < triangles.size(); i += 3) {
+		glm::vec3 e1 = triangles[i + 1] - triangles[i];
+		glm::vec3 e2 = triangles[i + 2] - triangles[i];
+		glm::vec3 p = glm::cross(dir, e2);
+		float det = glm::dot(e1, p);
+		if (std::fabs(det) < 1e-12f)
+			continue;
+
+		glm::vec3 s = from - triangles[i];
+		float u = glm::dot(s, p) / det;
+		if (u < 0.0f || u > 1.0f)
+			continue;
+
+		glm::vec3 q = glm::cross(s, e1);
+		float v = glm::dot(dir, q) / det;
+		if (v < 0.0f || u + v > 1.0f)
+			continue;
+
+		float t = glm::dot(e2, q) / det;
+		if (t > start && t < 1.0f)
+			return true;
+	}
+	return false;
+}
+
+static bool run(const Case& c)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	SceneSettings settings;
+	settings.technique    = c.technique;
+	settings.width        = SIZE;
+	settings.height       = SIZE;
+	settings.samplingType = c.samplingType;
+	settings.frame        = c.frame;
+
+	Scene scene;
+	Image factors;
+	if (!GetScene(settings, scene) || !RenderScene(settings, factors)) {
+		printf("ERROR: Unknown technique '%s'\n", c.technique);
+		return false;
+	}
+
+	Image expected = CameraPass(SIZE, SIZE, scene.visible, scene.viewProj, [&](const glm::vec3& world) {
+		return blocked(scene.casters, world, scene.lightPos) ? 0.0f : 1.0f;
+	});
+
+	Difference diff = Compare(expected, factors, TOLERANCE);
+	double mismatchPercent = diff.pixels ? 100.0 * diff.mismatches / diff.pixels : 0.0;
+	bool ok = diff.pixels > 0 && mismatchPercent <= c.maxMismatch;
+
+	printf("%-8s sampling %d, frame %2d: %.3f%% of %d pixels differ (at most %.2f%%), mean error %.4f in %.0f ms: %s\n",
+		c.technique, c.samplingType, c.frame, mismatchPercent, diff.pixels, c.maxMismatch, diff.meanError,
+		ms_since(start), ok ? "OK" : "FAILED");
+	return ok;
+}
+
+int main()
+{
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		if (!run(cases[i]))
+			++failed;
+	}
+
+	if (failed > 0) {
+		printf("%d of %d cases FAILED\n", failed, (int) (sizeof(cases) / sizeof(cases[0])));
+		return 1;
+	}
+
+	printf("All cases passed\n");
+	return 0;
+}
@@ -0,0 +1,313 @@
+// Converts OBJ-files to a scene-file (see Scene.hpp), which the demos map and upload as it is.
+// Every object/group of the inputs becomes a mesh with one instance, e.g.:
+//
+//   SceneConverter --light 0 2 -7 --shadowmap-size 1024 room.obj props.obj room.scene
+//   "Cubemapped VSM" --scene room.scene
+//
+// The meshes are indexed, optimized and packed here (see Geometry.hpp), so loading does none of it.
+// With --verify the written file is read back: its indices are checked against its vertices, and its
+// positions compared with the OBJ's.
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "Scene.hpp"
+
+struct Settings
+{
+	std::vector<std::string> inputs;
+	std::string              output;
+	bool                     positionStream;
+	bool                     keepWinding;
+	bool                     verify;
+	float                    scale;
+	scene::Settings          sceneSettings;
+	std::vector<scene::LightRecord> lights;
+};
+
+static double ms_since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// OBJ-indices are 1-based, or negative from the end
+static int resolve(int index, size_t count)
+{
+	return index < 0 ? (int) count + index : index - 1;
+}
+
+// Adds the triangles of one OBJ-file to writer, a mesh per object/group. With sources, also
+// the positions of each mesh as converted (for verify()).
+static bool convert_obj(const std::string& file, const Settings& settings, scene::Writer& writer,
+	std::vector<std::vector<glm::vec3> >* sources)
+{
+	std::ifstream in(file);
+	if (!in.is_open()) {
+		fprintf(stderr, "Couldn't open '%s'\n", file.c_str());
+		return false;
+	}
+
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> texcoords;
+	std::vector<geometry::Vertex> triangles;
+
+	// Ends the current mesh
+	auto flush = [&]() {
+		if (triangles.empty())
+			return;
+		int mesh = writer.AddMesh(triangles, settings.positionStream);
+		writer.AddInstance(mesh, glm::mat4(1.0f));
+		if (sources) {
+			sources->push_back(std::vector<glm::vec3>());
+			for (size_t i = 0; i < triangles.size(); ++i)
+				sources->back().push_back(triangles[i].position);
+		}
+		triangles.clear();
+	};
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(in, line)) {
+		++lineNumber;
+		std::istringstream tokens(line);
+		std::string type;
+		tokens >> type;
+
+		if (type == "v") {
+			glm::vec3 p;
+			tokens >> p.x >> p.y >> p.z;
+			positions.push_back(p * settings.scale);
+		}
+		else if (type == "vt") {
+			glm::vec2 t;
+			tokens >> t.x >> t.y;
+			texcoords.push_back(t);
+		}
+		else if (type == "vn") {
+			glm::vec3 n;
+			tokens >> n.x >> n.y >> n.z;
+			normals.push_back(n);
+		}
+		else if (type == "o" || type == "g") {
+			flush();
+		}
+		else if (type == "f") {
+			// v, v/t, v//n or v/t/n per corner
+			std::vector<geometry::Vertex> corners;
+			std::vector<bool> hasNormal;
+			std::string corner;
+			while (tokens >> corner) {
+				int v = 0, t = 0, n = 0;
+				if (sscanf(corner.c_str(), "%d/%d/%d", &v, &t, &n) != 3 && sscanf(corner.c_str(), "%d//%d", &v, &n) != 2)
+					sscanf(corner.c_str(), "%d/%d", &v, &t);
+
+				int vi = resolve(v, positions.size());
+				int ti = t ? resolve(t, texcoords.size()) : -1;
+				int ni = n ? resolve(n, normals.size()) : -1;
+				if (vi < 0 || vi >= (int) positions.size() || ti >= (int) texcoords.size() || ni >= (int) normals.size()) {
+					fprintf(stderr, "%s:%d: face refers to a missing vertex\n", file.c_str(), lineNumber);
+					return false;
+				}
+
+				geometry::Vertex vertex;
+				vertex.position = positions[vi];
+				vertex.texcoord = ti >= 0 ? texcoords[ti] : glm::vec2(0.0f);
+				vertex.normal   = ni >= 0 ? normals[ni] : glm::vec3(0.0f);
+				corners.push_back(vertex);
+				hasNormal.push_back(ni >= 0);
+			}
+
+			// Polygons as fans
+			for (size_t i = 2; i < corners.size(); ++i) {
+				geometry::Vertex tri[3] = { corners[0], corners[i - 1], corners[i] };
+				bool flat = !hasNormal[0] || !hasNormal[i - 1] || !hasNormal[i];
+				if (flat) {
+					glm::vec3 n = glm::cross(tri[1].position - tri[0].position, tri[2].position - tri[0].position);
+					n = glm::length(n) > 0.0f ? glm::normalize(n) : glm::vec3(0, 1, 0);
+					for (int k = 0; k < 3; ++k)
+						tri[k].normal = n;
+				}
+
+				// OBJ is counter-clockwise; the demos' front-faces are clockwise
+				if (!settings.keepWinding)
+					std::swap(tri[1], tri[2]);
+
+				triangles.insert(triangles.end(), tri, tri + 3);
+			}
+		}
+		// Materials, smoothing-groups etc. aren't used
+	}
+
+	flush();
+	return true;
+}
+
+static bool less_x(const glm::vec3& a, const glm::vec3& b)
+{
+	return a.x < b.x;
+}
+
+// Distance (largest along an axis) from p to the nearest of points (sorted by x), if within tolerance
+static float nearest(const std::vector<glm::vec3>& points, const glm::vec3& p, float tolerance)
+{
+	float best = FLT_MAX;
+	std::vector<glm::vec3>::const_iterator it = std::lower_bound(points.begin(), points.end(), p - glm::vec3(tolerance), less_x);
+	for (; it != points.end() && it->x <= p.x + tolerance; ++it) {
+		glm::vec3 d = glm::abs(*it - p);
+		best = std::min(best, std::max(d.x, std::max(d.y, d.z)));
+	}
+	return best;
+}
+
+// Reads the written scene back: every index must be of a vertex (see scene::File::Open()), every position drawn (of both streams) must be within a quantization
+// step of the OBJ's, and every position of the OBJ must be drawn
+static bool verify(const std::string& path, std::vector<std::vector<glm::vec3> >& sources)
+{
+	scene::File file;
+	if (!file.Open(path, true))
+		return false;
+
+	float largest = 0.0f, largestSteps = 0.0f;
+	for (int i = 0; i < file.GetInstanceCount(); ++i) {
+		int m = (int) file.GetInstance(i).mesh;
+		const scene::MeshRecord& record = file.GetMesh(m);
+		glm::mat4 model = file.GetModelMatrix(i);
+
+		std::vector<glm::vec3> drawn;
+		for (uint32_t v = 0; v < record.vertexCount; ++v)
+			drawn.push_back(glm::vec3(model * glm::vec4(geometry::UnpackPosition(file.GetVertices(m)[v].position), 1.0f)));
+		for (uint32_t v = 0; v < record.positionCount; ++v)
+			drawn.push_back(glm::vec3(model * glm::vec4(geometry::UnpackPosition(file.GetPositions(m)[v].position), 1.0f)));
+
+		// Rounding to 16 bits is within half a step; the rest is the float-math around it
+		std::vector<glm::vec3>& source = sources[m];
+		float step = glm::length(glm::vec3(model[0])) / 32767.0f;
+		float tolerance = step;
+		for (size_t v = 0; v < source.size(); ++v) {
+			glm::vec3 a = glm::abs(source[v]);
+			tolerance = std::max(tolerance, step + 4.0f * FLT_EPSILON * std::max(a.x, std::max(a.y, a.z)));
+		}
+
+		std::sort(source.begin(), source.end(), less_x);
+		std::sort(drawn.begin(), drawn.end(), less_x);
+		for (int pass = 0; pass < 2; ++pass) {
+			const std::vector<glm::vec3>& from = pass == 0 ? drawn : source;
+			const std::vector<glm::vec3>& to   = pass == 0 ? source : drawn;
+			for (size_t v = 0; v < from.size(); ++v) {
+				float error = nearest(to, from[v], tolerance);
+				if (error > tolerance) {
+					fprintf(stderr, "%s: mesh %d %s (%g, %g, %g)\n", path.c_str(), m,
+						pass == 0 ? "draws a position not in its OBJ at" : "doesn't draw its OBJ's position", from[v].x, from[v].y, from[v].z);
+					return false;
+				}
+				largest      = std::max(largest, error);
+				largestSteps = std::max(largestSteps, error / step);
+			}
+		}
+	}
+
+	printf("Verified %s: positions within %g of the OBJ's (%.2f quantization-steps)\n", path.c_str(), largest, largestSteps);
+	return true;
+}
+
+static void usage()
+{
+	printf("Usage: SceneConverter [options] input.obj... output.scene\n"
+		"  --light X Y Z            adds a point-light\n"
+		"  --shadowmap-size N       overrides the demos' shadow-map size\n"
+		"  --blur-radius N          overrides the demos' VSM-blur radius\n"
+		"  --scale S                scales the positions (default 1)\n"
+		"  --keep-winding           keeps OBJ's counter-clockwise front-faces\n"
+		"  --no-position-stream     leaves out the position-only stream of depth-passes\n"
+		"  --verify                 reads the scene back and checks it against the OBJ-files\n");
+}
+
+int main(int argc, char* argv[])
+{
+	Settings settings;
+	settings.positionStream = true;
+	settings.keepWinding    = false;
+	settings.verify         = false;
+	settings.scale          = 1.0f;
+	settings.sceneSettings.shadowMapSize = 0;
+	settings.sceneSettings.blurRadius    = 0;
+
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+
+		if (arg == "--light" && i + 3 < argc) {
+			scene::LightRecord light;
+			memset(&light, 0, sizeof(light));
+			light.type = scene::POINT_LIGHT;
+			for (int k = 0; k < 3; ++k) {
+				light.position[k] = (float)atof(argv[++i]);
+				light.color[k]    = 1.0f;
+			}
+			light.range = 100.0f;
+			settings.lights.push_back(light);
+		}
+		else if (arg == "--shadowmap-size" && i + 1 < argc)
+			settings.sceneSettings.shadowMapSize = atoi(argv[++i]);
+		else if (arg == "--blur-radius" && i + 1 < argc)
+			settings.sceneSettings.blurRadius = atoi(argv[++i]);
+		else if (arg == "--scale" && i + 1 < argc)
+			settings.scale = (float)atof(argv[++i]);
+		else if (arg == "--keep-winding")
+			settings.keepWinding = true;
+		else if (arg == "--no-position-stream")
+			settings.positionStream = false;
+		else if (arg == "--verify")
+			settings.verify = true;
+		else if (arg.size() > 1 && arg[0] == '-') {
+			usage();
+			return arg == "--help" ? 0 : -1;
+		}
+		else
+			files.push_back(arg);
+	}
+
+	if (files.size() < 2) {
+		usage();
+		return -1;
+	}
+	settings.output = files.back();
+	settings.inputs.assign(files.begin(), files.end() - 1);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	scene::Writer writer;
+	std::vector<std::vector<glm::vec3> > sources;
+	writer.SetSettings(settings.sceneSettings);
+	for (size_t i = 0; i < settings.lights.size(); ++i)
+		writer.AddLight(settings.lights[i]);
+
+	for (size_t i = 0; i < settings.inputs.size(); ++i) {
+		const std::string& input = settings.inputs[i];
+		if (input.size() < 4 || input.compare(input.size() - 4, 4, ".obj") != 0) {
+			fprintf(stderr, "'%s': only OBJ-files are supported\n", input.c_str());
+			return -1;
+		}
+		if (!convert_obj(input, settings, writer, settings.verify ? &sources : nullptr))
+			return -1;
+	}
+
+	if (!writer.Save(settings.output))
+		return -1;
+
+	printf("Wrote %s (%d meshes) in %.1f ms\n", settings.output.c_str(), writer.GetMeshCount(), ms_since(start));
+
+	if (settings.verify && !verify(settings.output, sources))
+		return -1;
+	return 0;
+}
@@ -0,0 +1,12 @@
+// The uniform-blocks shared by all programs, included with @uniformBlocks.glsl
+// (mirrored by blocks::FrameData in UniformBlocks.hpp)
+
+// Camera and light, uploaded once per frame
+layout(std140) uniform Frame
+{
+	mat4 view;
+	mat4 proj;
+	mat4 shadowMatrix; // World to the light's clip-space, of demos with a single shadow-map
+	vec3 lightPos;     // world-space
+	vec3 lightDir;     // world-space, pointing away from the light (directional lights)
+};
@@ -0,0 +1,73 @@
+#version 330
+
+in vec4 vpeye;
+in vec4 vneye;
+in vec4 vpworld;
+in vec2 Texcoord;
+flat in float doTexture;
+
+out vec4 outColor;
+
+// Moments, one layer per cascade
+uniform sampler2DArray shadowMap;
+
+#define MAX_CASCADES 4
+uniform int cascadeCount;
+uniform float cascadeSplits[MAX_CASCADES]; // Far distance of each cascade
+uniform mat4 cascadeMatrices[MAX_CASCADES];
+
+@uniformBlocks.glsl
+
+float chebyshevUpperBound(float distance, vec3 coord)
+{
+	vec2 moments = texture(shadowMap, coord).rg;
+
+	// Surface is fully lit. as the current fragment is before the light occluder
+	if (distance <= moments.x)
+		return 1.0;
+
+	// The fragment is either in shadow or penumbra. We now use chebyshev's upperBound to check
+	// How likely this pixel is to be lit (p_max)
+	float variance = moments.y - (moments.x*moments.x);
+	variance = max(variance, 0.00002);
+
+	float d = distance - moments.x;
+	float p_max = variance / (variance + d*d);
+
+	return p_max;
+}
+
+void main()
+{
+	vec3 fragment = vec3(vpeye);
+	vec3 normal   = vec3(normalize(vneye));
+
+	/* Shadows */
+	float shadowFactor = 1.0; // Not in shadow
+
+	// Pick the first cascade reaching past the fragment
+	int cascade = 0;
+	while (cascade < cascadeCount && -fragment.z > cascadeSplits[cascade])
+		cascade++;
+
+	if (cascade < cascadeCount) {
+		// Orthographic, so no divide by w
+		vec3 sc = vec3(cascadeMatrices[cascade] * vpworld) * 0.5 + 0.5;
+		shadowFactor = chebyshevUpperBound(sc.z, vec3(sc.xy, float(cascade)));
+	}
+
+	/* Lighting (directional) */
+	vec4 diffColor = vec4(1,1,1,1);
+	if(doTexture != 0) diffColor = texture(shadowMap, vec3(Texcoord.x, 1-Texcoord.y, 0));
+
+	vec3 lightDirEye = normalize(vec3(view * vec4(-lightDir, 0.0)));
+	float cosAngIncidence = clamp(dot(lightDirEye, normal), 0, 1);
+
+	vec4 diffuse = diffColor * cosAngIncidence;
+
+	vec4 total_lighting = vec4(0.0);
+	total_lighting += vec4(0.1, 0.1, 0.1, 1.0) * diffColor; // Ambient
+	total_lighting += diffuse * shadowFactor; // Diffuse
+
+	outColor = vec4(vec3(total_lighting), 1.0);
+};
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -5,6 +7,14 @@
 #include "OpenGL.hpp"
 #include "ShaderProgram.hpp"
 #include "Common.hpp"
+#include "Blur.hpp"
+#include "Cascades.hpp"
+#include "ShadowCache.hpp"
+#include "UniformBlocks.hpp"
+#include "Instancing.hpp"
+#include "GLState.hpp"
+#include "Resources.hpp"
+#include "RenderGraph.hpp"
 
 // Window size
 static const int WIDTH = 1280;
@@ -20,218 +30,413 @@ static glm::vec3 cameraPos(0, 4, 0);
 // Resources
 static ShaderProgram program, shadowProgram, blurProgram;
 static Mesh cubeMesh, quadMesh;
-static GLuint shadowMapFBO, shadowMapTex, shadowMapTexDepth;
-static GLuint blurFBO, blurTex;
+static blur::SeparableBlur shadowMapBlur;
 
-// Shadow-map resolution
+// Camera and light, shared by the programs (see UniformBlocks.hpp)
+static blocks::FrameUniforms frameUniforms;
+
+// Objects, drawn instanced from their transforms (see Instancing.hpp).
+// The casters come first, so all of them are one range.
+static instancing::InstanceBuffer instances;
+enum { CUBE_OBJECT, GROUND_OBJECT, LIGHT_OBJECT, MAX_OBJECTS };
+
+static constexpr UniformName cameraToShadowProjectorUniform("cameraToShadowProjector");
+
+// Re-renders and re-blurs the shadow-map only when something in it moved (--no-shadow-cache turns it off)
+static shadowcache::Tracker shadowTracker;
+static shadowcache::StaticBase shadowBase;
+static bool shadowCache = true;
+
+// Shadow-map resolution (--shadowmap-size overrides it)
 //static GLuint SHADOWMAP_SIZE = 256;
 static GLuint SHADOWMAP_SIZE = 512;
 //static GLuint SHADOWMAP_SIZE = 1024;
 //static GLuint SHADOWMAP_SIZE = 2048;
 
-// Amount of blurring
-static const float BLUR_SCALE = 2.0;
+// Amount of blurring (radius in texels; --blur-radius overrides it), and how it's done:
+// blur::GAUSSIAN, or blur::RUNNING_SUM which costs the same for any radius
+static int BLUR_RADIUS = 6;
+#define BLUR_MODE blur::GAUSSIAN
+
+// Format of the moments (--vsm-format overrides it)
+static GLint VSM_FORMAT = GL_RG32F;
 
 // If defined 1, draws the VSM-shadowmap-texture to screen
 #define DISPLAY_VSM_TEXTURE 0
 
-static void set_shadow_matrix_uniform(ShaderProgram &program)
+// If 1, uses cascaded shadow maps for a directional light (shining from lightPos toward cubePos)
+#define CASCADED_SHADOWS 0
+
+// If 1, the cube bobs up and down: a dynamic caster drawn over the cached shadow of the ground
+#define ANIMATE_CUBE 0
+
+#if CASCADED_SHADOWS
+static cascades::Cascades shadowCascades;
+
+// Count, split-lambda, shadow-distance, caster-margin, resolution
+static cascades::Settings cascadeSettings = { 4, 0.75f, 30.0f, 20.0f, (GLsizei) SHADOWMAP_SIZE };
+#endif
+
+// Shadow-map or cascades, and their FBOs (deleted at once before the context, see Resources.hpp)
+static struct Targets
+{
+#if CASCADED_SHADOWS
+	// Moments of each cascade (one layer each), blurred into from a transient of the frame's graph
+	resource::Texture     cascadeTex;
+	resource::Framebuffer cascadeFBOs[cascades::MAX_CASCADES];
+#else
+	resource::Texture     shadowMapTex, shadowMapTexDepth;
+	resource::Framebuffer shadowMapFBO;
+#endif
+} targets;
+
+// The passes of a frame and what they read and write (see RenderGraph.hpp)
+static rendergraph::Graph frameGraph;
+
+static glm::mat4 camera_view_matrix()
+{
+	return glm::lookAt(cameraPos, glm::vec3(0, 0, -5), glm::vec3(0, 1, 0));
+}
+
+static glm::mat4 shadow_matrix()
 {
 	glm::mat4 mat;
 	mat *= glm::perspective(45.0f, 1.0f, 2.0f, 100.0f);
 	mat *= glm::lookAt(lightPos, cubePos, glm::vec3(0, 1, 0)); // Point toward object regardless of position
-	program.UpdateUniform("cameraToShadowProjector", mat);
+	return mat;
 }
 
-static void draw_cubes(ShaderProgram &program, bool shadowpass)
+#if !CASCADED_SHADOWS
+// Of the single shadow-map (the cascades set their own)
+static void set_shadow_matrix_uniform(ShaderProgram &program)
 {
-	glBindVertexArray(cubeMesh.vao);
-
-	if (!shadowpass) {
-		// Draw shadowmap-texture on cube
-		program.UpdateUniform("doTexture", 1.0f);
-	}
-
-	// Draw cube
-	program.UpdateUniform("model", glm::translate(glm::mat4(), cubePos));
-	glDrawArrays(GL_TRIANGLES, 0, 36);
+	program.UpdateUniform(cameraToShadowProjectorUniform, shadow_matrix());
+}
+#endif
 
-	if (!shadowpass) {
-		// Don't texture anything else with the shadowmap
-		program.UpdateUniform("doTexture", 0.0f);
-	}
+static glm::mat4 cube_model_matrix()
+{
+#if ANIMATE_CUBE
+	return glm::translate(glm::mat4(), cubePos + glm::vec3(0.0f, 0.5f * (float)std::sin(2.0 * frame_time()), 0.0f));
+#else
+	return glm::translate(glm::mat4(), cubePos);
+#endif
+}
 
-	// Draw ground
+static glm::mat4 ground_model_matrix()
+{
 	glm::mat4 model = glm::translate(glm::mat4(), groundPos);
-	model = glm::scale(model, groundScale);
-	program.UpdateUniform("model", model);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-
-	// Light-box
-	if (!shadowpass) { // Don't want it covering the light (casting shadows everywhere)
-		model = glm::translate(glm::mat4(), lightPos);
-		model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-		program.UpdateUniform("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-	}
+	return glm::scale(model, groundScale);
+}
 
-	glBindVertexArray(0);
+// Uploads the camera, the light and all objects' transforms for this frame
+static void update_uniform_blocks()
+{
+	blocks::FrameData frame = blocks::FrameData();
+	frame.view = camera_view_matrix();
+	frame.proj = glm::perspective((float)45, (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
+	frame.shadowMatrix = shadow_matrix();
+	frame.lightPos = lightPos;
+	frame.lightDir = glm::normalize(cubePos - lightPos);
+	frameUniforms.Update(frame);
+
+	// Only the cube is textured with the shadowmap
+	glm::mat4 lightBox = glm::translate(glm::mat4(), lightPos);
+	lightBox = glm::scale(lightBox, glm::vec3(0.1, 0.1, 0.1));
+	instances.Set(CUBE_OBJECT, cube_model_matrix(), 1.0f);
+	instances.Set(GROUND_OBJECT, ground_model_matrix());
+	instances.Set(LIGHT_OBJECT, lightBox);
+	instances.Upload();
+
+#if CASCADED_SHADOWS
+	// Fit the cascades to the camera's view
+	shadowCascades = cascades::Fit(cascadeSettings, camera_view_matrix(), 45.0f, (float)WIDTH / (float)HEIGHT, 0.1f,
+		glm::normalize(cubePos - lightPos));
+#endif
+}
+
+static void draw_cubes(bool shadowpass)
+{
+	// Cube and ground, and the light-box unless it's the shadowpass
+	// (don't want it covering the light, casting shadows everywhere)
+	instances.Draw(cubeMesh, CUBE_OBJECT, shadowpass ? LIGHT_OBJECT : MAX_OBJECTS, shadowpass);
 }
 
 static void normal_pass()
 {
 	program.UseProgram();
-
-	glViewport(0, 0, WIDTH, HEIGHT);
-	glCullFace(GL_BACK);
+	glstate::CullFace(GL_BACK);
 
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// Upload uniforms
-	glm::mat4 proj = glm::perspective((float)45, (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
-	glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0, 0, -5), glm::vec3(0, 1, 0));
-	program.UpdateUniform("view", view);
-	program.UpdateUniform("proj", proj);
-	program.UpdateUniform("lightPos", lightPos);
-
-	set_shadow_matrix_uniform(program);
-	glBindTexture(GL_TEXTURE_2D, shadowMapTex);
-	draw_cubes(program, false /*not shadowpass*/);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// Camera and light are in the Frame-block
+#if CASCADED_SHADOWS
+	cascades::SetUniforms(program, shadowCascades);
+	glstate::BindTexture(GL_TEXTURE_2D_ARRAY, targets.cascadeTex.Get());
+	draw_cubes(false /*not shadowpass*/);
+	glstate::BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+#else
+	glstate::BindTexture(GL_TEXTURE_2D, targets.shadowMapTex.Get());
+	draw_cubes(false /*not shadowpass*/);
+	glstate::BindTexture(GL_TEXTURE_2D, 0);
+#endif
 }
 
+#if DISPLAY_VSM_TEXTURE
 static void draw_fullscreen_quad()
 {
-	glBindVertexArray(quadMesh.vao);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(0);
+	draw_mesh(quadMesh);
 }
 
-static void blur_shadowmap()
+// Draws the moments unblurred over the screen
+static void display_pass(GLuint momentsTex)
 {
-	glDisable(GL_DEPTH_TEST);
-	blurProgram.UseProgram();
-
-	// Blur shadowMapTex (horizontally) to blurTex
-	glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
-	glBindTexture(GL_TEXTURE_2D, shadowMapTex); //Input-texture
-	blurProgram.UpdateUniform("ScaleU", glm::vec2(1.0 / SHADOWMAP_SIZE * BLUR_SCALE, 0));
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	blurProgram.UseProgram(); // Since it draws fullscreen quad ...
+	blurProgram.UpdateUniform("ScaleU", glm::vec2(0, 0)); // ... but make sure we don't actually blur
+	glstate::BindTexture(GL_TEXTURE_2D, momentsTex);
 	draw_fullscreen_quad();
+	glstate::BindTexture(GL_TEXTURE_2D, 0);
+}
+#endif
 
-	// Blur blurTex vertically and write to shadowMapTex
-	glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-	glBindTexture(GL_TEXTURE_2D, blurTex);
-	blurProgram.UpdateUniform("ScaleU", glm::vec2(0, 1.0 / SHADOWMAP_SIZE*BLUR_SCALE));
+#if CASCADED_SHADOWS
+// Draws the moments of a cascade (to the target bound)
+static void shadow_pass(int cascade)
+{
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	draw_fullscreen_quad();
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glEnable(GL_DEPTH_TEST);
+	shadowProgram.UseProgram();
+	shadowProgram.UpdateUniform(cameraToShadowProjectorUniform, shadowCascades.matrices[cascade]);
+	draw_cubes(true /*shadowpass*/);
 }
 
-static void blur_map()
+// Each cascade is drawn to a transient and blurred into its layer. The transients' lifetimes don't
+// overlap, so they're all the same target.
+static bool build_frame_graph()
 {
-	blurProgram.UseProgram();
-	glViewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+	rendergraph::Resource screen = frameGraph.Import("screen", 0, 0, screen_framebuffer(), WIDTH, HEIGHT);
+	rendergraph::Resource layers[cascades::MAX_CASCADES];
+	rendergraph::Resource moments = -1;
+
+	for (int i = 0; i < cascadeSettings.count; ++i) {
+		moments = frameGraph.Create("moments", rendertarget::Desc::ColorDepth(VSM_FORMAT, GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE));
+		layers[i] = frameGraph.Import("cascade", targets.cascadeTex.Get(), 0, targets.cascadeFBOs[i].Get(), SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+
+		frameGraph.AddPass("shadow", [i](const rendergraph::Context&) { shadow_pass(i); }).RenderTo(moments);
+		frameGraph.AddPass("blur", [moments, layers, i](const rendergraph::Context& context) {
+			shadowMapBlur.Apply(context.GetTexture(moments), context.GetFramebuffer(layers[i]));
+		}).Read(moments).Write(layers[i]);
+	}
+
+	rendergraph::Pass& normal = frameGraph.AddPass("normal", [](const rendergraph::Context&) { normal_pass(); });
+	normal.RenderTo(screen);
+	for (int i = 0; i < cascadeSettings.count; ++i)
+		normal.Read(layers[i]);
+
+#if DISPLAY_VSM_TEXTURE
+	// The last cascade's (keeping its transient until then)
+	frameGraph.AddPass("display", [moments](const rendergraph::Context& context) {
+		display_pass(context.GetTexture(moments));
+	}).Read(moments).RenderTo(screen);
+#endif
+
+	return frameGraph.Compile();
+}
+#else
+// The casters of the shadow-map: the ground is static, and so is the cube unless ANIMATE_CUBE
+static const bool cubeIsStatic = !ANIMATE_CUBE;
 
-	// Blur shadowMapTex
-	blur_shadowmap();
+static void draw_casters(bool statics)
+{
+	// The cube and then the ground, so either is a range with the other
+	int first = (cubeIsStatic == statics) ? CUBE_OBJECT : GROUND_OBJECT;
+	int last  = statics ? GROUND_OBJECT : CUBE_OBJECT;
+	instances.Draw(cubeMesh, first, last - first + 1, true /*shadowpass*/);
 }
 
+// What the shadow-pass re-rendered this frame, and the blur-pass blurs again
+static shadowcache::Update shadowUpdate = shadowcache::ALL;
+
 static void shadow_pass()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-	glViewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+	shadowTracker.Begin(shadow_matrix());
+	shadowTracker.AddCaster(0, cube_model_matrix(), cubeIsStatic);
+	shadowTracker.AddCaster(1, ground_model_matrix(), true);
+	if (!shadowCache)
+		shadowTracker.Invalidate();
 
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	shadowcache::Update update = shadowUpdate = shadowTracker.End();
+	if (update == shadowcache::NONE)
+		return; // Last frame's (blurred) shadow-map is still valid
+
+	glstate::Viewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
 
 	shadowProgram.UseProgram();
 	set_shadow_matrix_uniform(shadowProgram);
-	draw_cubes(shadowProgram, true /*shadowpass*/);
+
+	// The static base is taken before blurring, as the blur writes back into shadowMapTex
+	if (update == shadowcache::ALL) {
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, targets.shadowMapFBO.Get());
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		draw_casters(true /*statics*/);
+
+		if (shadowTracker.HasDynamic())
+			shadowBase.Store(targets.shadowMapFBO.Get());
+	}
+	else {
+		shadowBase.Restore(targets.shadowMapFBO.Get());
+	}
+
+	if (shadowTracker.HasDynamic())
+		draw_casters(false /*dynamics*/);
 
 	// Reset
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
+	glstate::BindTexture(GL_TEXTURE_2D, 0);
+}
 
-	blur_map();
+static void blur_pass()
+{
+	if (shadowUpdate == shadowcache::NONE)
+		return; // Still blurred
+
+	// Blur shadowMapTex horizontally, then vertically back into shadowMapTex
+	glstate::Viewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+	shadowMapBlur.Apply(targets.shadowMapTex.Get(), targets.shadowMapFBO.Get());
 }
 
-int main()
+// The shadow-map is kept (and blurred in place), as the shadow-cache re-renders it only when something moved
+static bool build_frame_graph()
+{
+	rendergraph::Resource screen = frameGraph.Import("screen", 0, 0, screen_framebuffer(), WIDTH, HEIGHT);
+	rendergraph::Resource shadowMap = frameGraph.Import("shadow-map", targets.shadowMapTex.Get(), targets.shadowMapTexDepth.Get(),
+		targets.shadowMapFBO.Get(), SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+
+	frameGraph.AddPass("shadow", [](const rendergraph::Context&) { shadow_pass(); }).Write(shadowMap);
+	frameGraph.AddPass("blur", [](const rendergraph::Context&) { blur_pass(); }).Read(shadowMap).Write(shadowMap);
+	frameGraph.AddPass("normal", [](const rendergraph::Context&) { normal_pass(); }).Read(shadowMap).RenderTo(screen);
+#if DISPLAY_VSM_TEXTURE
+	frameGraph.AddPass("display", [](const rendergraph::Context&) { display_pass(targets.shadowMapTex.Get()); }).Read(shadowMap).RenderTo(screen);
+#endif
+
+	return frameGraph.Compile();
+}
+#endif
+
+int main(int argc, char* argv[])
 {
 	GLFWwindow* window = nullptr;
+	Options options = parse_options(argc, argv);
 
 	// Set up OpenGL-context
-	if (!init_opengl(WIDTH, HEIGHT, &window)){
+	if (!init_opengl(WIDTH, HEIGHT, &window, options)){
 		std::cout << "Error setting up OpenGL-context.\n";
 		return -1;
 	}
 
-	// Create programs
-	if (!program.Load(ShaderInfo::VSFS("vsm/vertexShader.glsl", "vsm/fragmentShader.glsl")))
-		return false;
-	if (!shadowProgram.Load(ShaderInfo::VSFS("vsm/shadowVertexShader.glsl", "vsm/shadowFragmentShader.glsl")))
+	// Settings from the command-line
+	if (options.shadowMapSize > 0)
+		SHADOWMAP_SIZE = options.shadowMapSize;
+	if (options.vsmFormat)
+		VSM_FORMAT = options.vsmFormat;
+	if (options.blurRadius >= 0)
+		BLUR_RADIUS = std::min(options.blurRadius, blur::MAX_RADIUS);
+	shadowCache = options.shadowCache;
+#if CASCADED_SHADOWS
+	cascadeSettings.resolution = SHADOWMAP_SIZE;
+#endif
+
+	// Create programs (all started before waiting for any, so they're compiled in parallel)
+#if CASCADED_SHADOWS
+	program.LoadAsync(ShaderInfo::VSFS("vsm/csmVertexShader.glsl", "vsm/csmFragmentShader.glsl"));
+#else
+	program.LoadAsync(ShaderInfo::VSFS("vsm/vertexShader.glsl", "vsm/fragmentShader.glsl"));
+#endif
+	shadowProgram.LoadAsync(ShaderInfo::VSFS("vsm/shadowVertexShader.glsl", "vsm/shadowFragmentShader.glsl"));
+	blurProgram.LoadAsync(ShaderInfo::VSFS("blurVertexShader.glsl", "blurFragmentShader.glsl"));
+	if (!program.Finish() || !shadowProgram.Finish() || !blurProgram.Finish())
 		return false;
-	if (!blurProgram.Load(ShaderInfo::VSFS("blurVertexShader.glsl", "blurFragmentShader.glsl")))
+	program.UpdateUniformi("showShadowFactor", options.shadowFactor ? 1 : 0);
+	blur::SetKernel(blurProgram, blur::GaussianKernel(0)); // Only used to display the shadowmap
+
+	// Uniform-buffers
+	if (!blocks::SetBindings(program) || !blocks::SetBindings(shadowProgram))
 		return false;
+	frameUniforms.Load();
+	instances.Load(MAX_OBJECTS);
 
 	// Create geometry
 	cubeMesh = create_cube();
+	instances.Attach(cubeMesh);
 	quadMesh = create_quad();
 
+#if CASCADED_SHADOWS
+	targets.cascadeTex.Reset(texture::Create2DArray(VSM_FORMAT, SHADOWMAP_SIZE, SHADOWMAP_SIZE, cascadeSettings.count, GL_RG, GL_FLOAT));
+	for (int i = 0; i < cascadeSettings.count; ++i)
+		targets.cascadeFBOs[i].Reset(texture::FramebufferLayer(targets.cascadeTex.Get(), -1, i));
+#else
 	// ShadowMap-textures and FBO
-	shadowMapTexDepth = texture::Create2D(GL_DEPTH_COMPONENT, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_DEPTH_COMPONENT, GL_FLOAT);
-	shadowMapTex = texture::Create2D(GL_RG32F, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_RG, GL_FLOAT);
-	shadowMapFBO = texture::Framebuffer(shadowMapTex, shadowMapTexDepth);
+	targets.shadowMapTexDepth.Reset(texture::Create2D(GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_DEPTH_COMPONENT, GL_FLOAT));
+	targets.shadowMapTex.Reset(texture::Create2D(VSM_FORMAT, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_RG, GL_FLOAT));
+	targets.shadowMapFBO.Reset(texture::Framebuffer(targets.shadowMapTex.Get(), targets.shadowMapTexDepth.Get()));
+#endif
 
-	// Textures and FBO to perform blurring
-	blurTex = texture::Create2D(GL_RG32F, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_RG, GL_FLOAT);
-	blurFBO = texture::Framebuffer(blurTex, -1);
+	// Blur (through scratch-targets)
+	if (!shadowMapBlur.Load(BLUR_MODE, BLUR_RADIUS, SHADOWMAP_SIZE, SHADOWMAP_SIZE, VSM_FORMAT))
+		return false;
 
-	glEnable(GL_DEPTH_TEST);
+	if (!build_frame_graph())
+		return false;
+	frameGraph.Print();
+
+	size_t shadowMemory = frameGraph.AliasedMemorySize() + shadowMapBlur.MemorySize();
+#if CASCADED_SHADOWS
+	shadowMemory += texture::MemorySize(VSM_FORMAT, SHADOWMAP_SIZE, SHADOWMAP_SIZE, cascadeSettings.count);
+#else
+	shadowMemory += texture::MemorySize(GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE) +
+		texture::MemorySize(VSM_FORMAT, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+
+	// Copy of the (unblurred) shadow-map with just the static casters, for when only dynamic ones move
+	if (!cubeIsStatic) {
+		if (!shadowBase.Load(SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_DEPTH_COMPONENT24, VSM_FORMAT))
+			return false;
+		shadowMemory += shadowBase.MemorySize();
+	}
+#endif
+	print_shadow_memory(shadowMemory);
+
+	glstate::Enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	glstate::Enable(GL_CULL_FACE);
+	glstate::CullFace(GL_BACK);
 	glFrontFace(GL_CW);
 
-	while (!glfwWindowShouldClose(window))
+	while (begin_frame(window))
 	{
-		shadow_pass();
-		normal_pass();
-
-#if DISPLAY_VSM_TEXTURE
-		// Blur and draw to screen
-		blurProgram.UseProgram(); // Since it draws fullscreen quad ...
-		blurProgram.UpdateUniform("ScaleU", glm::vec2(0, 0)); // ... but make sure we don't actually blur
-		glBindTexture(GL_TEXTURE_2D, shadowMapTex);
-		draw_fullscreen_quad();
-		glBindTexture(GL_TEXTURE_2D, 0);
-#endif
-
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		update_uniform_blocks();
+		frameGraph.Execute();
 
-		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-			break;
+		end_frame(window);
 	}
 
 	program.DeleteProgram();
 	shadowProgram.DeleteProgram();
 	blurProgram.DeleteProgram();
+	frameUniforms.Delete();
+	instances.Delete();
 
-	glDeleteTextures(1, &blurTex);
-	glDeleteFramebuffers(1, &blurFBO);
+	shadowMapBlur.Delete();
 
-	glDeleteTextures(1, &shadowMapTex);
-	glDeleteTextures(1, &shadowMapTexDepth);
-	glDeleteFramebuffers(1, &shadowMapFBO);
+	targets = Targets();
+	shadowBase.Delete();
 
 	delete_mesh(quadMesh);
 	delete_mesh(cubeMesh);
 
-	glfwTerminate();
+	shutdown_opengl();
 
 	return 0;
 }
\ No newline at end of file
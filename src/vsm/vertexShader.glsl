@@ -8,14 +8,16 @@ out vec4 vneye;
 out vec4 vpeye;
 out vec4 sc;
 out vec2 Texcoord;
+flat out float doTexture;
 
-uniform mat4 cameraToShadowProjector;
-uniform mat4 model, view, proj;
+@uniformBlocks.glsl
+@instanceAttributes.glsl
 
 void main() {
 	Texcoord = texcoord;
+	doTexture = instanceDoTexture;
 	gl_Position = proj * view * model * vec4(position, 1.0f);
 	vneye = view * model * vec4(normal,   0.0f);
 	vpeye = view * model * vec4(position, 1.0);
-	sc = cameraToShadowProjector * model * vec4(position, 1.0f);
+	sc = shadowMatrix * model * vec4(position, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#version 330
+flat in int face;
+
+// Blurs every face of a cubemap (the face comes from the geometry shader).
+// Taps are looked up by direction, so taps past the edge of a face are
+// read from the neighbouring face instead of being clamped.
+uniform samplerCube textureSource;
+uniform vec2 ScaleU;
+
+// Kernel from blur::GaussianKernel() (see blurFragmentShader.glsl)
+#define MAX_TAPS 16
+uniform int TapCount;
+uniform float Offsets[MAX_TAPS];
+uniform float Weights[MAX_TAPS];
+
+out vec4 outColor;
+
+// Face-coordinates in [0,1] to a direction (as in the GL cubemap-face layout)
+vec3 face_direction(vec2 uv)
+{
+	vec2 st = uv * 2.0 - 1.0;
+	if (face == 0) return vec3(+1.0, -st.y, -st.x);
+	if (face == 1) return vec3(-1.0, -st.y, +st.x);
+	if (face == 2) return vec3(+st.x, +1.0, +st.y);
+	if (face == 3) return vec3(+st.x, -1.0, -st.y);
+	if (face == 4) return vec3(+st.x, -st.y, +1.0);
+	return vec3(-st.x, -st.y, -1.0);
+}
+
+void main()
+{
+	vec2 uv = gl_FragCoord.xy / vec2(textureSize(textureSource, 0));
+
+	vec4 color = texture( textureSource, face_direction( uv ) ) * Weights[0];
+	for (int i = 1; i < TapCount; ++i) {
+		vec2 offset = Offsets[i] * ScaleU;
+		color += texture( textureSource, face_direction( uv + offset ) ) * Weights[i];
+		color += texture( textureSource, face_direction( uv - offset ) ) * Weights[i];
+	}
+	outColor = vec4(color.xyz, 1.0);
+};
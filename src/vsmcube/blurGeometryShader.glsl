@@ -0,0 +1,24 @@
+#version 330
+
+// Replicates the fullscreen quad to the cube-faces to blur
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 18) out;
+
+uniform int blurFaces; // Bit i set for face i (empty faces are only cleared)
+
+flat out int face;
+
+void main() {
+	for (int i = 0; i < 6; ++i) {
+		if ((blurFaces & (1 << i)) == 0)
+			continue;
+
+		for (int v = 0; v < 3; ++v) {
+			gl_Layer    = i;
+			face        = i;
+			gl_Position = gl_in[v].gl_Position;
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+};
@@ -8,9 +8,10 @@ out vec4 outColor;
 
 uniform samplerCube shadowCube;
 
-uniform mat4 view, model;
-uniform vec3 lightPos;
-uniform float doTexture;
+@uniformBlocks.glsl
+
+// If 1, outputs just the shadow-factor (to compare against the CPU-reference)
+uniform int showShadowFactor = 0;
 
 struct light
 {
@@ -64,7 +65,7 @@ void main()
 
 	/* Shadows */
 	vec4 fragmentToLight_world = inverse(view) * vec4(fragmentToLightDir, 0.0);
-	float shadowFactor = chebyshevUpperBound(length(fragmentToLight), -fragmentToLight_world);
+	float shadowFactor = chebyshevUpperBound(length(fragmentToLight), -fragmentToLight_world.xyz);
 
 	vec4 diffColor = vec4(1,1,1,1);
    //if(doTexture != 0)
@@ -87,9 +88,11 @@ void main()
 		
 	vec4 diffuse  = diffColor * light0.diffuse  * cosAngIncidence * attenuation;
 
-	vec4 total_lighting;
+	vec4 total_lighting = vec4(0.0);
 	total_lighting += vec4(0.1, 0.1, 0.1, 1.0) * diffColor; // Ambient
 	total_lighting += diffuse * shadowFactor; // Diffuse
 
    outColor = vec4(vec3(total_lighting), 1.0);
+   if (showShadowFactor != 0)
+   	outColor = vec4(vec3(shadowFactor), 1.0);
 };
\ No newline at end of file
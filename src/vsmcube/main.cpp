@@ -1,24 +1,47 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 #include <string>
 
 #include "Common.hpp"
+#include "Blur.hpp"
+#include "Profiler.hpp"
 #include "ShaderProgram.hpp"
+#include "UniformBlocks.hpp"
+#include "Instancing.hpp"
+#include "Scene.hpp"
+#include "Culling.hpp"
+#include "GpuCulling.hpp"
+#include "GLState.hpp"
+#include "Resources.hpp"
+#include "RenderTargets.hpp"
+#include "RenderGraph.hpp"
 
 static const int WIDTH = 1280;
 static const int HEIGHT = 720;
 
 #define BLUR_VSM 1
 
-// Size of shadowmap
+// Radius of the blur (in texels; --blur-radius overrides it)
+static int BLUR_RADIUS = 3;
+
+// If 1, draws all six cubemap-faces in one pass (layered rendering through a geometry shader)
+#define LAYERED_RENDERING 1
+
+// If 1, covers the ground with a grid of small cubes: thousands of casters, still one draw-call per pass
+#define CUBE_GRID 0
+static const int GRID_SIZE = 48; // Cubes along each side
+
+// Size of shadowmap (--shadowmap-size overrides it)
 //GLuint SHADOWMAP_SIZE = 128;
 //GLuint SHADOWMAP_SIZE = 256;
 GLuint SHADOWMAP_SIZE = 512;
 //GLuint SHADOWMAP_SIZE = 1024;
 //GLuint SHADOWMAP_SIZE = 2048;
 
-// VSM texture-types
-#define TYPE GL_RG32F
+// VSM texture-types (--vsm-format overrides the internal format)
+static GLint TYPE = GL_RG32F;
 #define TYPE2 GL_RG
 
 // Geomtry
@@ -31,24 +54,79 @@ static glm::vec3 cameraPos(0, 4, 0);
 static glm::vec3 groundScale(17, 1, 17); // It's a scaled cube
 
 // Resources
-static ShaderProgram normalProgram, shadowProgram, blurProgram;
+static ShaderProgram normalProgram, shadowProgram;
 static Mesh cubeMesh, quadMesh;
-static GLuint blurFBO, blurTex;
-static GLuint cubeTex, cubeDepthTex, cubeFBOs[6];
-static GLuint currentSideTex, currentSideDepthTex;
-static GLuint toCurrentSideFBO;
+#if LAYERED_RENDERING
+static ShaderProgram layeredShadowProgram, blurCubeProgram;
+#else
+static blur::SeparableBlur sideBlur;
+static rendertarget::Desc currentSide; // Each face is rendered to (a transient of the frame's graph), then blurred into cubeTex
+#endif
+
+// Cubemaps and their FBOs (deleted at once before the context, see Resources.hpp)
+static struct Targets
+{
+	resource::Texture     cubeTex, cubeDepthTex;
+	resource::Framebuffer cubeFBOs[6]; // Each face of cubeTex
+#if LAYERED_RENDERING
+	resource::Framebuffer layeredFBO; // Every face of a cubemap attached at once
+	resource::Texture     sideCubeTex, sideCubeDepthTex; // Rendered to before blurring
+	resource::Texture     blurCubeTex; // Horizontally blurred faces
+	resource::Framebuffer blurCubeFBO;
+	resource::Framebuffer blurCubeFaceFBOs[6]; // Each face of blurCubeTex
+	resource::Framebuffer cubeBlurTargetFBO; // All faces of cubeTex, without depth
+#endif
+} targets;
+
+// The passes of a frame and what they read and write (see RenderGraph.hpp)
+static rendergraph::Graph frameGraph;
+
+// Camera and light, shared by the programs (see UniformBlocks.hpp)
+static blocks::FrameUniforms frameUniforms;
+
+// Objects, drawn instanced from their transforms (see Instancing.hpp).
+// The casters come first, so all of them are one range.
+static instancing::InstanceBuffer instances;
+static const int GRID_CUBES = CUBE_GRID ? GRID_SIZE * GRID_SIZE : 0;
+enum { CUBE_OBJECTS, GRID_OBJECTS = CUBE_OBJECTS + 3, GROUND_OBJECT = GRID_OBJECTS + GRID_CUBES, LIGHT_OBJECT, MAX_OBJECTS };
+
+// A scene-file (--scene) replaces the cubes and the ground; its first light, the moving light
+static scene::File sceneFile;
+static std::vector<Mesh> sceneMeshes;
+static instancing::InstanceBuffer sceneInstances; // In the file's order, so each mesh's are one range
+static bool sceneLight = false;
+
+// Bounds of the casters (the objects before LIGHT_OBJECT, and the scene's instances), classified
+// against the six cube-faces as the light moves (see Culling.hpp). With layered rendering the
+// geometry shader skips the faces that don't see an object, otherwise each face has its draw-list.
+static culling::Culler casterCuller, sceneCuller;
+
+// Where GL 4.3 is, a compute-shader culls them instead, and each face's casters are drawn with
+// indirect draw-commands it wrote (see GpuCulling.hpp). The CPU still classifies them, but only to
+// know which faces are empty (see occupied_faces()).
+static gpuculling::IndirectCuller gpuCasterCuller, gpuSceneCuller;
+static bool gpuCulling = false;
+
+static constexpr UniformName cameraToShadowProjectorUniform("cameraToShadowProjector");
+#if LAYERED_RENDERING
+static constexpr UniformName blurFacesUniform("blurFaces");
+#endif
+
+// Faces without casters aren't rendered or blurred: they're cleared to fully lit moments when
+// they become empty, and keep that until a caster moves into them
+static unsigned clearedFaces = 0; // Bit per face of cubeTex
 
 static GLuint GenerateDepthCube(GLsizei size)
 {
 	GLuint cube;
 	glGenTextures(1, &cube);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cube);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
+	glstate::BindTexture(GL_TEXTURE_CUBE_MAP, cube);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -57,281 +135,670 @@ static GLuint GenerateDepthCube(GLsizei size)
 	return cube;
 }
 
-static GLuint GenerateCube(GLsizei size)
+static GLuint GenerateCube(GLsizei size, GLint internalformat, GLenum format)
 {
 	GLuint cube;
 	glGenTextures(1, &cube);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cube);
+	glstate::BindTexture(GL_TEXTURE_CUBE_MAP, cube);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGB32F, size, size, 0, GL_RGB, GL_FLOAT, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGB32F, size, size, 0, GL_RGB, GL_FLOAT, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGB32F, size, size, 0, GL_RGB, GL_FLOAT, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGB32F, size, size, 0, GL_RGB, GL_FLOAT, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGB32F, size, size, 0, GL_RGB, GL_FLOAT, 0);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGB32F, size, size, 0, GL_RGB, GL_FLOAT, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, internalformat, size, size, 0, format, GL_FLOAT, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, internalformat, size, size, 0, format, GL_FLOAT, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, internalformat, size, size, 0, format, GL_FLOAT, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, internalformat, size, size, 0, format, GL_FLOAT, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, internalformat, size, size, 0, format, GL_FLOAT, 0);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, internalformat, size, size, 0, format, GL_FLOAT, 0);
 	return cube;
 }
 
-static void FramebufferCube(GLuint *cubeFBOs, GLuint cubeTex, GLuint cubeDepthTex)
+static void FramebufferCube(resource::Framebuffer* cubeFBOs, int cubeTex, int cubeDepthTex)
 {
-	glGenFramebuffers(6, cubeFBOs);
 	for (int i = 0; i < 6; i++) {
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBOs[i]);
+		GLuint fbo;
+		glGenFramebuffers(1, &fbo);
+		cubeFBOs[i].Reset(fbo);
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, fbo);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubeTex, 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubeDepthTex, 0);
+		if (cubeDepthTex != -1)
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubeDepthTex, 0);
 		GLenum result = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 		if (GL_FRAMEBUFFER_COMPLETE != result) {
 			printf("ERROR: Framebuffer is not complete.\n");
 		}
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-static void set_shadow_matrix_uniform(ShaderProgram &program, int dir)
+#if LAYERED_RENDERING
+// Attaches all six faces, so the geometry shader selects the face through gl_Layer
+static GLuint FramebufferCubeLayered(int cubeTex, int cubeDepthTex)
+{
+	GLuint fbo;
+	glGenFramebuffers(1, &fbo);
+	glstate::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, cubeTex, 0);
+	if (cubeDepthTex != -1)
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeDepthTex, 0);
+	GLenum result = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (GL_FRAMEBUFFER_COMPLETE != result) {
+		printf("ERROR: Framebuffer is not complete.\n");
+	}
+	glstate::BindFramebuffer(GL_FRAMEBUFFER, 0);
+	return fbo;
+}
+#endif
+
+static glm::mat4 shadow_view_matrix(int dir)
 {
-	glm::mat4 mat, view, tmp;
-	mat *= glm::perspective(90.0f, 1.0f, 0.5f, 100.0f);
 	switch (dir) {
 	case 0:
 		// +X
-		tmp = glm::lookAt(lightPos, lightPos + glm::vec3(+1, +0, 0), glm::vec3(0, -1, 0));
-		view = tmp;
-		mat *= tmp;
-		break;
+		return glm::lookAt(lightPos, lightPos + glm::vec3(+1, +0, 0), glm::vec3(0, -1, 0));
 	case 1:
 		// -X
-		tmp = glm::lookAt(lightPos, lightPos + glm::vec3(-1, +0, 0), glm::vec3(0, -1, 0));
-		view = tmp;
-		mat *= tmp;
-		break;
+		return glm::lookAt(lightPos, lightPos + glm::vec3(-1, +0, 0), glm::vec3(0, -1, 0));
 	case 2:
 		// +Y
-		tmp = glm::lookAt(lightPos, lightPos + glm::vec3(0, +1, 0), glm::vec3(0, 0, -1));
-		view = tmp;
-		mat *= tmp;
-		break;
+		return glm::lookAt(lightPos, lightPos + glm::vec3(0, +1, 0), glm::vec3(0, 0, -1));
 	case 3:
 		// -Y
-		tmp = glm::lookAt(lightPos, lightPos + glm::vec3(0, -1, 0), glm::vec3(0, 0, -1));
-		view = tmp;
-		mat *= tmp;
-		break;
+		return glm::lookAt(lightPos, lightPos + glm::vec3(0, -1, 0), glm::vec3(0, 0, -1));
 	case 4:
 		// +Z
-		tmp = glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, +1), glm::vec3(0, -1, 0));
-		view = tmp;
-		mat *= tmp;
-		break;
+		return glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, +1), glm::vec3(0, -1, 0));
 	case 5:
 		// -Z
 		// Works
-		tmp = glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, -1), glm::vec3(0, -1, 0));
-		view = tmp;
-		mat *= tmp;
-		break;
+		return glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, -1), glm::vec3(0, -1, 0));
 	default:
 		// Do nothing
-		break;
+		return glm::mat4();
+	}
+}
+
+static glm::mat4 shadow_projector_matrix(int dir)
+{
+	return glm::perspective(90.0f, 1.0f, 0.5f, 100.0f) * shadow_view_matrix(dir);
+}
+
+#if !LAYERED_RENDERING
+static void set_shadow_matrix_uniform(ShaderProgram &program, int dir)
+{
+	program.UpdateUniform("cameraToShadowView", shadow_view_matrix(dir));
+	program.UpdateUniform(cameraToShadowProjectorUniform, shadow_projector_matrix(dir));
+}
+#else
+// Uploads the matrices of all six faces at once (for layered rendering)
+static void set_shadow_matrices_uniform(ShaderProgram &program)
+{
+	glm::mat4 mats[6];
+	for (int i = 0; i < 6; ++i)
+		mats[i] = shadow_projector_matrix(i);
+	program.UpdateUniform(cameraToShadowProjectorUniform, mats, 6);
+}
+#endif
+
+// Sets a caster's transform, and its bounds
+static void set_caster(int index, const glm::mat4& model)
+{
+	instances.Set(index, model);
+	casterCuller.SetBounds(index, model, cubeMesh.boundsMin, cubeMesh.boundsMax);
+}
+
+// Classifies the casters against the cube-faces of this frame's light
+static void cull_casters()
+{
+	profiler::Scope scope("cull");
+
+	glm::mat4 projectors[6];
+	for (int i = 0; i < 6; ++i)
+		projectors[i] = shadow_projector_matrix(i);
+
+	// The scene's instances don't move, so they're culled (and re-uploaded) only when the light did
+	static bool sceneCulled = false;
+	static glm::vec3 sceneCulledFrom;
+	bool cullScene = sceneFile.IsOpen() && (!sceneCulled || sceneCulledFrom != lightPos);
+	if (cullScene) {
+		sceneCulled     = true;
+		sceneCulledFrom = lightPos;
+	}
+
+	if (gpuCulling) {
+		// Writes the faces straight into the uploaded instances
+		gpuCasterCuller.Cull(instances, LIGHT_OBJECT, projectors, LAYERED_RENDERING != 0);
+		if (cullScene)
+			gpuSceneCuller.Cull(sceneInstances, sceneFile.GetInstanceCount(), projectors, LAYERED_RENDERING != 0);
+
+		// While the GPU works on it: the empty faces aren't rendered or blurred, which must be
+		// known before they're drawn
+		if (!sceneFile.IsOpen())
+			casterCuller.Cull(projectors, 6);
+		else if (cullScene)
+			sceneCuller.Cull(projectors, 6);
+		return;
+	}
+
+	casterCuller.Cull(projectors, 6);
+#if LAYERED_RENDERING
+	for (int i = 0; i < casterCuller.GetObjectCount(); ++i)
+		instances.SetFaces(i, (unsigned) casterCuller.GetViews(i));
+#endif
+
+	if (cullScene) {
+		sceneCuller.Cull(projectors, 6);
+#if LAYERED_RENDERING
+		for (int i = 0; i < sceneCuller.GetObjectCount(); ++i)
+			sceneInstances.SetFaces(i, (unsigned) sceneCuller.GetViews(i));
+		sceneInstances.Upload();
+#endif
 	}
-	program.UpdateUniform("cameraToShadowView", view);
-	program.UpdateUniform("cameraToShadowProjector", mat);
 }
 
-static void draw_cubes(ShaderProgram &normalProgram, bool shadowpass)
+// Uploads the camera, the light and all objects' transforms for this frame
+static void update_uniform_blocks()
 {
-	glBindVertexArray(cubeMesh.vao);
+	blocks::FrameData frame = blocks::FrameData();
+	frame.view = glm::lookAt(cameraPos, glm::vec3(0, 0, -5), glm::vec3(0, 1, 0));
+	frame.proj = glm::perspective(45.0f, (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
+	frame.lightPos = lightPos;
+	frameUniforms.Update(frame);
 
-	// Draw cube2
-	normalProgram.UpdateUniform("model", glm::translate(glm::mat4(), cubePos));
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	normalProgram.UpdateUniform("model", glm::translate(glm::mat4(), cubePos2));
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	normalProgram.UpdateUniform("model", glm::translate(glm::mat4(), cubePos3));
-	glDrawArrays(GL_TRIANGLES, 0, 36);
+	set_caster(CUBE_OBJECTS + 0, glm::translate(glm::mat4(), cubePos));
+	set_caster(CUBE_OBJECTS + 1, glm::translate(glm::mat4(), cubePos2));
+	set_caster(CUBE_OBJECTS + 2, glm::translate(glm::mat4(), cubePos3));
 
-	// Draw ground
 	glm::mat4 model = glm::translate(glm::mat4(), groundPos);
 	model = glm::scale(model, groundScale);
-	normalProgram.UpdateUniform("model", model);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-
-	// Light-box
-	if (!shadowpass) { // Don't want it covering the light (casting shadows everywhere)
-		model = glm::translate(glm::mat4(), lightPos);
-		model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-		normalProgram.UpdateUniform("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+	set_caster(GROUND_OBJECT, model);
+
+	model = glm::translate(glm::mat4(), lightPos);
+	model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
+	instances.Set(LIGHT_OBJECT, model);
+
+	if (gpuCulling) {
+		// Culled as uploaded; the grid's were uploaded once, and their faces are the GPU's
+		instances.Upload(CUBE_OBJECTS, GRID_OBJECTS - CUBE_OBJECTS);
+		instances.Upload(GROUND_OBJECT, MAX_OBJECTS - GROUND_OBJECT);
+		cull_casters();
+		return;
+	}
+
+	cull_casters();
+	instances.Upload();
+}
+
+#if CUBE_GRID
+// The grid's cubes don't move, so they're only set once
+static void create_grid()
+{
+	const float size = 0.15f;
+	const float spacing = (groundScale.x - 1.0f) / GRID_SIZE;
+	glm::vec3 corner = groundPos + glm::vec3(-0.5f * spacing * (GRID_SIZE - 1), 0.5f + 0.5f * size, -0.5f * spacing * (GRID_SIZE - 1));
+
+	for (int z = 0; z < GRID_SIZE; ++z) {
+		for (int x = 0; x < GRID_SIZE; ++x) {
+			glm::mat4 model = glm::translate(glm::mat4(), corner + glm::vec3(x * spacing, 0, z * spacing));
+			set_caster(GRID_OBJECTS + z * GRID_SIZE + x, glm::scale(model, glm::vec3(size)));
+		}
+	}
+}
+#endif
+
+// The scene's instances don't move, so they're only uploaded once
+static bool load_scene(const std::string& path, bool validate)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	if (!sceneFile.Open(path, validate))
+		return false;
+
+	sceneInstances.Load(std::max(sceneFile.GetInstanceCount(), 1));
+	sceneCuller.Resize(sceneFile.GetInstanceCount());
+	for (int i = 0; i < sceneFile.GetInstanceCount(); ++i) {
+		const scene::InstanceRecord& instance = sceneFile.GetInstance(i);
+		const scene::MeshRecord& mesh = sceneFile.GetMesh(instance.mesh);
+		bool textured = (instance.flags & scene::TEXTURED) != 0;
+		sceneInstances.Set(i, sceneFile.GetModelMatrix(i), textured ? 1.0f : 0.0f);
+		sceneCuller.SetBounds(i, sceneFile.GetModelMatrix(i), glm::make_vec3(mesh.boundsMin), glm::make_vec3(mesh.boundsMax));
+	}
+	sceneInstances.Upload();
+
+	for (int i = 0; i < sceneFile.GetMeshCount(); ++i) {
+		sceneMeshes.push_back(sceneFile.UploadMesh(i));
+		sceneInstances.Attach(sceneMeshes.back());
+	}
+
+	if (gpuCulling) {
+		if (!gpuSceneCuller.Load(sceneFile.GetInstanceCount(), 6))
+			return false;
+		for (int i = 0; i < sceneFile.GetMeshCount(); ++i) {
+			const scene::MeshRecord& mesh = sceneFile.GetMesh(i);
+			gpuSceneCuller.SetObjects(mesh.firstInstance, mesh.instanceCount, sceneMeshes[i]);
+		}
+	}
+
+	for (int i = 0; i < sceneFile.GetLightCount() && !sceneLight; ++i) {
+		const scene::LightRecord& light = sceneFile.GetLight(i);
+		if (light.type == scene::POINT_LIGHT) {
+			lightPos   = glm::make_vec3(light.position);
+			sceneLight = true;
+		}
 	}
 
-	glBindVertexArray(0);
+	const scene::Settings& settings = sceneFile.GetSettings();
+	if (settings.shadowMapSize > 0)
+		SHADOWMAP_SIZE = settings.shadowMapSize;
+	if (settings.blurRadius > 0)
+		BLUR_RADIUS = std::min((int) settings.blurRadius, blur::MAX_RADIUS);
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("Loaded %s (%d meshes, %d instances) in %.1f ms\n", path.c_str(), sceneFile.GetMeshCount(), sceneFile.GetInstanceCount(), ms);
+
+	return true;
+}
+
+static void draw_cubes()
+{
+	if (sceneFile.IsOpen()) {
+		for (size_t i = 0; i < sceneMeshes.size(); ++i) {
+			const scene::MeshRecord& mesh = sceneFile.GetMesh((int) i);
+			sceneInstances.Draw(sceneMeshes[i], mesh.firstInstance, mesh.instanceCount);
+		}
+
+		instances.Draw(cubeMesh, LIGHT_OBJECT, 1);
+		return;
+	}
+
+	// Cubes, ground and the light-box
+	instances.Draw(cubeMesh, CUBE_OBJECTS, MAX_OBJECTS);
+}
+
+// The casters cube-face face sees, or with face -1 those any face sees (for layered rendering).
+// Not the light-box: don't want it covering the light, casting shadows everywhere.
+static void draw_casters(int face)
+{
+	if (gpuCulling) {
+		// A multi-draw per mesh, of the draw-commands of the face (or of any face)
+		if (sceneFile.IsOpen()) {
+			for (size_t i = 0; i < sceneMeshes.size(); ++i) {
+				const scene::MeshRecord& mesh = sceneFile.GetMesh((int) i);
+				gpuSceneCuller.Draw(sceneInstances, sceneMeshes[i], mesh.firstInstance, mesh.instanceCount, face);
+			}
+		}
+		else
+			gpuCasterCuller.Draw(instances, cubeMesh, CUBE_OBJECTS, LIGHT_OBJECT - CUBE_OBJECTS, face);
+		return;
+	}
+
+	if (sceneFile.IsOpen()) {
+		const std::vector<int>& list = face < 0 ? sceneCuller.GetVisible() : sceneCuller.GetDrawList(face);
+
+		// The instances are sorted by mesh, so each mesh's part of the list is a range
+		size_t begin = 0;
+		for (size_t i = 0; i < sceneMeshes.size(); ++i) {
+			const scene::MeshRecord& mesh = sceneFile.GetMesh((int) i);
+			size_t end = std::lower_bound(list.begin() + begin, list.end(), (int) (mesh.firstInstance + mesh.instanceCount)) - list.begin();
+			sceneInstances.DrawList(sceneMeshes[i], list.data() + begin, (int) (end - begin), true /*shadowpass*/);
+			begin = end;
+		}
+		return;
+	}
+
+	const std::vector<int>& list = face < 0 ? casterCuller.GetVisible() : casterCuller.GetDrawList(face);
+	instances.DrawList(cubeMesh, list.data(), (int) list.size(), true /*shadowpass*/);
 }
 
 static void draw_normal_pass()
 {
 	normalProgram.UseProgram();
-
-	glViewport(0, 0, WIDTH, HEIGHT);
-	glCullFace(GL_BACK);
+	glstate::CullFace(GL_BACK);
 
 	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// Upload uniforms
-	glm::mat4 proj = glm::perspective(45.0f, (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
-	glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0, 0, -5), glm::vec3(0, 1, 0));
-	normalProgram.UpdateUniform("view", view);
-	normalProgram.UpdateUniform("proj", proj);
-	normalProgram.UpdateUniform("lightPos", lightPos);
-
-	set_shadow_matrix_uniform(normalProgram, -1);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTex);
-	draw_cubes(normalProgram, false /*not shadowpass*/);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	// Camera and light are in the Frame-block
+	glstate::BindTexture(GL_TEXTURE_CUBE_MAP, targets.cubeTex.Get());
+	draw_cubes();
+	glstate::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
 }
 
+#if LAYERED_RENDERING && BLUR_VSM
 static void draw_fullscreen_quad()
 {
-	glBindVertexArray(quadMesh.vao);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(0);
+	draw_mesh(quadMesh);
 }
+#endif
 
+// Faces that see at least one caster
+static unsigned occupied_faces()
+{
+	const culling::Culler& culler = sceneFile.IsOpen() ? sceneCuller : casterCuller;
+
+	unsigned faces = 0;
+	for (int i = 0; i < 6; ++i) {
+		if (!culler.GetDrawList(i).empty())
+			faces |= 1u << i;
+	}
+	return faces;
+}
+
+// Clears the faces that just became empty (with the clear-color set)
+static void clear_empty_faces(unsigned occupied)
+{
+	unsigned empty = instancing::ALL_FACES & ~occupied;
+	for (int i = 0; i < 6; ++i) {
+		if (!(empty & ~clearedFaces & (1u << i)))
+			continue;
+
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, targets.cubeFBOs[i].Get());
+		glClear(GL_COLOR_BUFFER_BIT);
+#if LAYERED_RENDERING && BLUR_VSM
+		// The neighbouring faces' blur reads across the edges
+		glstate::BindFramebuffer(GL_FRAMEBUFFER, targets.blurCubeFaceFBOs[i].Get());
+		glClear(GL_COLOR_BUFFER_BIT);
+#endif
+	}
+	clearedFaces = empty;
+}
+
+// What the clear-pass found occupied this frame, and the shadow- and blur-passes render
+static unsigned shadowFaces = 0;
+
+static void draw_clear_pass()
+{
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+
+	shadowFaces = occupied_faces();
+	clear_empty_faces(shadowFaces);
+}
+
+#if LAYERED_RENDERING
+// Draws all sides of the cubemap with a single submission (to the layered FBO, bound)
 static void draw_shadow_pass()
 {
-	glViewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+	if (shadowFaces == 0)
+		return;
 
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	shadowProgram.UseProgram();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	layeredShadowProgram.UseProgram();
+	set_shadow_matrices_uniform(layeredShadowProgram);
+	draw_casters(-1 /* any face */);
+}
 
-	// For each side of cubemap
-	for (int i = 0; i < 6; ++i) {
 #if BLUR_VSM
-		// Draw to temp. storage
-		shadowProgram.UseProgram();
-		glBindFramebuffer(GL_FRAMEBUFFER, toCurrentSideFBO);
+// Blurs the occupied sides in two passes (the geometry shader spreads the quad over them)
+static void draw_blur_pass()
+{
+	if (shadowFaces == 0)
+		return;
+
+	glstate::Viewport(0, 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+	glstate::Disable(GL_DEPTH_TEST);
+	blurCubeProgram.UseProgram();
+	blurCubeProgram.UpdateUniformi(blurFacesUniform, (int) shadowFaces);
+
+	// Horizontally to blurCubeTex
+	blurCubeProgram.UpdateUniform("ScaleU", glm::vec2(1.0 / SHADOWMAP_SIZE, 0));
+	glstate::BindFramebuffer(GL_FRAMEBUFFER, targets.blurCubeFBO.Get());
+	glstate::BindTexture(GL_TEXTURE_CUBE_MAP, targets.sideCubeTex.Get());
+	draw_fullscreen_quad();
+
+	// Vertically to actual cubemap
+	blurCubeProgram.UpdateUniform("ScaleU", glm::vec2(0, 1.0 / SHADOWMAP_SIZE));
+	glstate::BindFramebuffer(GL_FRAMEBUFFER, targets.cubeBlurTargetFBO.Get());
+	glstate::BindTexture(GL_TEXTURE_CUBE_MAP, targets.blurCubeTex.Get());
+	draw_fullscreen_quad();
+
+	glstate::Enable(GL_DEPTH_TEST);
+	glstate::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+#endif
 
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		set_shadow_matrix_uniform(shadowProgram, i);
-		draw_cubes(shadowProgram, true /* is shadowpass */);
+// The cubemaps in between are imported, as the scratch-targets aren't cubemaps
+static bool build_frame_graph()
+{
+	rendergraph::Resource screen = frameGraph.Import("screen", 0, 0, screen_framebuffer(), WIDTH, HEIGHT);
+	rendergraph::Resource cube = frameGraph.Import("cube", targets.cubeTex.Get(), targets.cubeDepthTex.Get(), 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
 
-		// Blur horizontally to blurTex
-		glDisable(GL_DEPTH_TEST);
+#if BLUR_VSM
+	rendergraph::Resource side = frameGraph.Import("side-cube", targets.sideCubeTex.Get(), targets.sideCubeDepthTex.Get(),
+		targets.layeredFBO.Get(), SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+	rendergraph::Resource blurred = frameGraph.Import("blur-cube", targets.blurCubeTex.Get(), 0, targets.blurCubeFBO.Get(),
+		SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+
+	frameGraph.AddPass("clear", [](const rendergraph::Context&) { draw_clear_pass(); }).Write(cube).Write(blurred);
+	frameGraph.AddPass("shadow", [](const rendergraph::Context&) { draw_shadow_pass(); }).RenderTo(side);
+	frameGraph.AddPass("blur", [](const rendergraph::Context&) { draw_blur_pass(); }).Read(side).Write(blurred).Write(cube);
+#else
+	rendergraph::Resource layered = frameGraph.Import("cube-layered", targets.cubeTex.Get(), targets.cubeDepthTex.Get(),
+		targets.layeredFBO.Get(), SHADOWMAP_SIZE, SHADOWMAP_SIZE);
 
-		blurProgram.UseProgram();
-		blurProgram.UpdateUniform("ScaleU", glm::vec2(1.0 / SHADOWMAP_SIZE, 0));
+	frameGraph.AddPass("clear", [](const rendergraph::Context&) { draw_clear_pass(); }).Write(cube);
+	frameGraph.AddPass("shadow", [](const rendergraph::Context&) { draw_shadow_pass(); }).RenderTo(layered).Write(cube);
+#endif
 
-		glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
-		glBindTexture(GL_TEXTURE_2D, currentSideTex);
-		glClear(GL_COLOR_BUFFER_BIT);
-		draw_fullscreen_quad();
+	frameGraph.AddPass("normal", [](const rendergraph::Context&) { draw_normal_pass(); }).Read(cube).RenderTo(screen);
+	return frameGraph.Compile();
+}
+#else
+// Draws a side of the cubemap (to the target bound)
+static void draw_shadow_pass(int face)
+{
+	if (!(shadowFaces & (1u << face)))
+		return; // Still cleared
 
-		// Blur vertically to actual cubemap
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBOs[i]);
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glBindTexture(GL_TEXTURE_2D, blurTex);
-		blurProgram.UpdateUniform("ScaleU", glm::vec2(0, 1.0 / SHADOWMAP_SIZE));
+	shadowProgram.UseProgram();
+	set_shadow_matrix_uniform(shadowProgram, face);
+	draw_casters(face);
+}
 
-		draw_fullscreen_quad();
+#if BLUR_VSM
+// Each side is drawn to a transient and blurred into its face of cubeTex. The transients' lifetimes
+// don't overlap, so they're all the same target.
+static bool build_frame_graph()
+{
+	rendergraph::Resource screen = frameGraph.Import("screen", 0, 0, screen_framebuffer(), WIDTH, HEIGHT);
+	rendergraph::Resource cube = frameGraph.Import("cube", targets.cubeTex.Get(), targets.cubeDepthTex.Get(), 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+
+	frameGraph.AddPass("clear", [](const rendergraph::Context&) { draw_clear_pass(); }).Write(cube);
+	for (int i = 0; i < 6; ++i) {
+		rendergraph::Resource side = frameGraph.Create("side", currentSide);
 
-		glEnable(GL_DEPTH_TEST);
+		frameGraph.AddPass("shadow", [i](const rendergraph::Context&) { draw_shadow_pass(i); }).RenderTo(side);
+		frameGraph.AddPass("blur", [side, i](const rendergraph::Context& context) {
+			if (shadowFaces & (1u << i))
+				sideBlur.Apply(context.GetTexture(side), targets.cubeFBOs[i].Get());
+		}).Read(side).Write(cube);
+	}
+
+	frameGraph.AddPass("normal", [](const rendergraph::Context&) { draw_normal_pass(); }).Read(cube).RenderTo(screen);
+	return frameGraph.Compile();
+}
 #else
-		// Draw directly to cubemap
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBOs[i]);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		set_shadow_matrix_uniform(shadowProgram, i);
-		draw_cubes(shadowProgram, true /* is shadowpass */);
-#endif
+// Each side is drawn directly to its face of cubeTex
+static bool build_frame_graph()
+{
+	rendergraph::Resource screen = frameGraph.Import("screen", 0, 0, screen_framebuffer(), WIDTH, HEIGHT);
+	rendergraph::Resource cube = frameGraph.Import("cube", targets.cubeTex.Get(), targets.cubeDepthTex.Get(), 0, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+
+	frameGraph.AddPass("clear", [](const rendergraph::Context&) { draw_clear_pass(); }).Write(cube);
+	for (int i = 0; i < 6; ++i) {
+		rendergraph::Resource face = frameGraph.Import("cube-face", targets.cubeTex.Get(), targets.cubeDepthTex.Get(),
+			targets.cubeFBOs[i].Get(), SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+		frameGraph.AddPass("shadow", [i](const rendergraph::Context&) { draw_shadow_pass(i); }).RenderTo(face).Write(cube);
 	}
 
-	// Reset state
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	frameGraph.AddPass("normal", [](const rendergraph::Context&) { draw_normal_pass(); }).Read(cube).RenderTo(screen);
+	return frameGraph.Compile();
 }
+#endif
+#endif
 
-int main()
+int main(int argc, char* argv[])
 {
 	GLFWwindow* window = nullptr;
+	Options options = parse_options(argc, argv);
 
 	// Set up OpenGL-context
-	if (!init_opengl(WIDTH, HEIGHT, &window)){
+	if (!init_opengl(WIDTH, HEIGHT, &window, options)){
 		std::cout << "Error setting up OpenGL-context.\n";
 		return -1;
 	}
+	gpuCulling = options.gpuCulling && gpuculling::IsSupported();
 
-	// Create programs
-	if (!normalProgram.Load(ShaderInfo::VSFS("vsmcube/vertexShader.glsl", "vsmcube/fragmentShader.glsl")))
+	// Settings of the scene, and from the command-line
+	if (!options.sceneFile.empty() && !load_scene(options.sceneFile, options.validateScene))
+		return -1;
+	if (options.shadowMapSize > 0)
+		SHADOWMAP_SIZE = options.shadowMapSize;
+	if (options.vsmFormat)
+		TYPE = options.vsmFormat;
+	if (options.blurRadius >= 0)
+		BLUR_RADIUS = std::min(options.blurRadius, blur::MAX_RADIUS);
+
+	// Create programs (all started before waiting for any, so they're compiled in parallel)
+	normalProgram.LoadAsync(ShaderInfo::VSFS("vsmcube/vertexShader.glsl", "vsmcube/fragmentShader.glsl"));
+	shadowProgram.LoadAsync(ShaderInfo::VSFS("vsmcube/shadowVertexShader.glsl", "vsmcube/shadowFragmentShader.glsl"));
+#if LAYERED_RENDERING
+	ShaderInfo layeredInfo = ShaderInfo::VSFS("vsmcube/shadowLayeredVertexShader.glsl", "vsmcube/shadowFragmentShader.glsl");
+	layeredInfo.setGeometryShaderFile("vsmcube/shadowGeometryShader.glsl");
+	layeredShadowProgram.LoadAsync(layeredInfo);
+	ShaderInfo blurCubeInfo = ShaderInfo::VSFS("blurVertexShader.glsl", "vsmcube/blurCubeFragmentShader.glsl");
+	blurCubeInfo.setGeometryShaderFile("vsmcube/blurGeometryShader.glsl");
+	blurCubeProgram.LoadAsync(blurCubeInfo);
+	if (!layeredShadowProgram.Finish() || !blurCubeProgram.Finish())
 		return false;
-	if (!shadowProgram.Load(ShaderInfo::VSFS("vsmcube/shadowVertexShader.glsl", "vsmcube/shadowFragmentShader.glsl")))
+	blur::SetKernel(blurCubeProgram, blur::GaussianKernel(BLUR_RADIUS));
+#endif
+	if (!normalProgram.Finish() || !shadowProgram.Finish())
+		return false;
+	normalProgram.UpdateUniformi("showShadowFactor", options.shadowFactor ? 1 : 0);
+
+	// Uniform-buffers
+	if (!blocks::SetBindings(normalProgram) || !blocks::SetBindings(shadowProgram))
 		return false;
-	if (!blurProgram.Load(ShaderInfo::VSFS("blurVertexShader.glsl", "blurFragmentShader.glsl")))
+#if LAYERED_RENDERING
+	if (!blocks::SetBindings(layeredShadowProgram))
 		return false;
+#endif
+	frameUniforms.Load();
+	instances.Load(MAX_OBJECTS);
 
 	// Create geometry
 	cubeMesh = create_cube();
+	instances.Attach(cubeMesh);
 	quadMesh = create_quad();
 
+	casterCuller.Resize(LIGHT_OBJECT);
+	if (gpuCulling) {
+		if (!gpuCasterCuller.Load(LIGHT_OBJECT, 6))
+			return -1;
+		gpuCasterCuller.SetObjects(CUBE_OBJECTS, LIGHT_OBJECT - CUBE_OBJECTS, cubeMesh);
+		printf("Culling the casters on the GPU\n");
+	}
+	else
+		printf("Culling the casters with %s\n", culling::InstructionSet());
+#if CUBE_GRID
+	create_grid();
+	instances.Upload();
+#endif
+
 	// Create cubemap
-	cubeTex      = GenerateCube(SHADOWMAP_SIZE);
-	cubeDepthTex = GenerateDepthCube(SHADOWMAP_SIZE);
-	FramebufferCube(cubeFBOs, cubeTex, cubeDepthTex);
-
-	// Textures and FBO to perform blurring
-	blurTex = texture::Create2D(GL_RG32F, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_RG, GL_FLOAT);
-	texture::SetWrapMode2D(blurTex, texture::WrapMode::ClampEdge);
-	blurFBO = texture::Framebuffer(blurTex, -1);
-
-	// Temporary storage
-	currentSideTex = texture::Create2D(TYPE, SHADOWMAP_SIZE, SHADOWMAP_SIZE, TYPE2, GL_FLOAT);
-	texture::SetWrapMode2D(currentSideTex, texture::WrapMode::ClampEdge);
-	currentSideDepthTex = texture::Create2D(GL_DEPTH_COMPONENT, SHADOWMAP_SIZE, SHADOWMAP_SIZE, GL_DEPTH_COMPONENT, GL_FLOAT);
-	toCurrentSideFBO = texture::Framebuffer(currentSideTex, currentSideDepthTex);
-
-	glEnable(GL_DEPTH_TEST);
+	targets.cubeTex.Reset(GenerateCube(SHADOWMAP_SIZE, TYPE, TYPE2));
+	targets.cubeDepthTex.Reset(GenerateDepthCube(SHADOWMAP_SIZE));
+
+	FramebufferCube(targets.cubeFBOs, targets.cubeTex.Get(), targets.cubeDepthTex.Get());
+
+	size_t shadowMemory = 6 * (texture::MemorySize(TYPE, SHADOWMAP_SIZE, SHADOWMAP_SIZE) +
+		texture::MemorySize(GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE));
+
+#if LAYERED_RENDERING
+#if BLUR_VSM
+	// Temporary storage (all sides), blurred into cubeTex
+	targets.sideCubeTex.Reset(GenerateCube(SHADOWMAP_SIZE, TYPE, TYPE2));
+	targets.sideCubeDepthTex.Reset(GenerateDepthCube(SHADOWMAP_SIZE));
+	targets.layeredFBO.Reset(FramebufferCubeLayered(targets.sideCubeTex.Get(), targets.sideCubeDepthTex.Get()));
+
+	// Cubemap and FBOs to perform blurring
+	targets.blurCubeTex.Reset(GenerateCube(SHADOWMAP_SIZE, TYPE, TYPE2));
+	targets.blurCubeFBO.Reset(FramebufferCubeLayered(targets.blurCubeTex.Get(), -1));
+	FramebufferCube(targets.blurCubeFaceFBOs, targets.blurCubeTex.Get(), -1);
+	targets.cubeBlurTargetFBO.Reset(FramebufferCubeLayered(targets.cubeTex.Get(), -1));
+
+	shadowMemory += 6 * (2 * texture::MemorySize(TYPE, SHADOWMAP_SIZE, SHADOWMAP_SIZE) +
+		texture::MemorySize(GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE));
+#else
+	targets.layeredFBO.Reset(FramebufferCubeLayered(targets.cubeTex.Get(), targets.cubeDepthTex.Get()));
+#endif
+#else
+	// Blur (through scratch-targets, as is the face rendered)
+	if (!sideBlur.Load(blur::GAUSSIAN, BLUR_RADIUS, SHADOWMAP_SIZE, SHADOWMAP_SIZE))
+		return false;
+	currentSide = rendertarget::Desc::ColorDepth(TYPE, GL_DEPTH_COMPONENT24, SHADOWMAP_SIZE, SHADOWMAP_SIZE);
+#endif
+
+	if (!build_frame_graph())
+		return -1;
+	frameGraph.Print();
+
+#if !LAYERED_RENDERING
+	shadowMemory += sideBlur.MemorySize() + frameGraph.AliasedMemorySize();
+#endif
+	print_shadow_memory(shadowMemory);
+
+	glstate::Enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	glstate::Enable(GL_CULL_FACE);
+	glstate::CullFace(GL_BACK);
 	glFrontFace(GL_CW);
 
-	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	glstate::Enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
-	while (!glfwWindowShouldClose(window))
+	while (begin_frame(window))
 	{
-		glm::mat4 mat = glm::translate(glm::mat4(1.0f), glm::vec3(0, 2, -5));
-		mat          *= glm::rotate(glm::mat4(), (float) glfwGetTime() * 50.0f, glm::vec3(0, 1, 0));
-		lightPos = glm::vec3(mat * glm::vec4(glm::vec3(2, 0, 0), 1.0));
-
-		draw_shadow_pass();
-		draw_normal_pass();
+		if (!sceneLight) {
+			glm::mat4 mat = glm::translate(glm::mat4(1.0f), glm::vec3(0, 2, -5));
+			mat          *= glm::rotate(glm::mat4(), (float) frame_time() * 50.0f, glm::vec3(0, 1, 0));
+			lightPos = glm::vec3(mat * glm::vec4(glm::vec3(2, 0, 0), 1.0));
+		}
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		update_uniform_blocks();
+		frameGraph.Execute();
 
-		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-			break;
+		end_frame(window);
 	}
 
 	normalProgram.DeleteProgram();
 	shadowProgram.DeleteProgram();
-	blurProgram.DeleteProgram();
+#if LAYERED_RENDERING
+	layeredShadowProgram.DeleteProgram();
+	blurCubeProgram.DeleteProgram();
+#endif
+	frameUniforms.Delete();
+	instances.Delete();
 
 	delete_mesh(quadMesh);
 	delete_mesh(cubeMesh);
+	for (size_t i = 0; i < sceneMeshes.size(); ++i)
+		delete_mesh(sceneMeshes[i]);
+	sceneInstances.Delete();
+	sceneFile.Close();
+	gpuCasterCuller.Delete();
+	gpuSceneCuller.Delete();
+
+	targets = Targets();
+#if !LAYERED_RENDERING
+	sideBlur.Delete();
+#endif
 
-	glDeleteTextures(1, &blurTex);
-	glDeleteFramebuffers(1, &blurFBO);
-
-	glDeleteTextures(1, &cubeDepthTex);
-	glDeleteTextures(1, &cubeTex);
-	glDeleteFramebuffers(6, cubeFBOs);
-
-	glDeleteTextures(1, &currentSideTex);
-	glDeleteTextures(1, &currentSideDepthTex);
-	glDeleteFramebuffers(1, &toCurrentSideFBO);
-
-	glfwTerminate();
+	shutdown_opengl();
 
 	return 0;
 }
\ No newline at end of file
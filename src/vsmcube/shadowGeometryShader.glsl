@@ -0,0 +1,45 @@
+#version 330
+
+// Replicates each triangle to all six cube-faces (one layer each)
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 18) out;
+
+flat in int v_faces[]; // The faces that see the object (culled on the CPU)
+out vec4 v_position;
+
+@uniformBlocks.glsl
+
+uniform mat4 cameraToShadowProjector[6];
+
+// True if all three vertices are on the outside of the same side-plane
+bool outside_face(vec4 a, vec4 b, vec4 c)
+{
+	return (a.x < -a.w && b.x < -b.w && c.x < -c.w)
+		|| (a.x >  a.w && b.x >  b.w && c.x >  c.w)
+		|| (a.y < -a.w && b.y < -b.w && c.y < -c.w)
+		|| (a.y >  a.w && b.y >  b.w && c.y >  c.w);
+}
+
+void main() {
+	for (int face = 0; face < 6; ++face) {
+		if ((v_faces[0] & (1 << face)) == 0)
+			continue;
+
+		vec4 clip[3];
+		for (int i = 0; i < 3; ++i)
+			clip[i] = cameraToShadowProjector[face] * gl_in[i].gl_Position;
+
+		// Don't emit triangles the face can't see
+		if (outside_face(clip[0], clip[1], clip[2]))
+			continue;
+
+		for (int i = 0; i < 3; ++i) {
+			gl_Layer    = face;
+			gl_Position = clip[i];
+			// Only the length is used, which is the same for every face
+			v_position  = vec4(gl_in[i].gl_Position.xyz - lightPos, 1.0);
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+};
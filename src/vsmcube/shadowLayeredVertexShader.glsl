@@ -0,0 +1,14 @@
+#version 330
+
+layout(location = 0) in vec3 position;
+
+flat out int v_faces;
+
+@uniformBlocks.glsl
+@instanceAttributes.glsl
+
+void main() {
+	// World-space; projected per cube-face in the geometry shader
+	gl_Position = model * vec4(position, 1.0);
+	v_faces     = int(instanceFaces);
+};
@@ -9,7 +9,8 @@ out vec4 vpeye;
 out vec4 sc;
 out vec2 Texcoord;
 
-uniform mat4 model, view, proj;
+@uniformBlocks.glsl
+@instanceAttributes.glsl
 
 void main() {
 	Texcoord = texcoord;